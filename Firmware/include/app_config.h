@@ -3,6 +3,11 @@
 
 // IMU Configuration
 #define IMU_SAMPLE_HZ 200  // IMU sampling frequency in Hz
+#define IMU_OVERSAMPLE 1  // 1: run the MPU-6050 at IMU_OVERSAMPLE_HZ (FIFO bursts) and CIC-decimate, 0: direct register reads
+#define IMU_OVERSAMPLE_HZ 1000  // MPU-6050 output rate in oversampling mode
+#define IMU_DECIMATION (IMU_OVERSAMPLE_HZ / IMU_SAMPLE_HZ)  // CIC decimation ratio
+#define IMU_FIFO_BURST_MAX 32  // Max FIFO frames drained per sample tick
+#define IMU_BLOCK_PROCESSING 1  // 1: filters and detector run once per batch of samples, 0: once per sample (compare *_get_cycles_per_sample())
 
 // Display Configuration
 #define OLED_WIDTH 128
@@ -17,6 +22,32 @@
 // Exercise Detection Configuration
 #define CALIBRATION_SAMPLES 100  // Number of samples to collect during calibration
 #define DETECTION_WARMUP_MS 1000  // Warm-up time before detection starts
+#define REP_EARLY_CONFIRM 1  // 1: count a rep once its peak is established (taken back if the whole peak fails), 0: at the threshold down-crossing
+
+// Exercises built into the image (registry: exercises.def); all default to 1
+// #define EX_ENABLE_BENCH_PRESS 0  // 0: leave Bench Press and its tables out
+
+// Calibration persistence (flash page, see calib_store.h)
+#define RESUME_ON_BOOT 1  // 1: power up straight into the last exercise with its stored calibration
+#define GYRO_BIAS_MAX_DPS 10.0f  // Larger mean rates during calibration mean the wrist moved: bias not updated
+
+// Optional int8 MLP rep/exercise classifier (weights from tools/train_rep_classifier.py)
+#define ENABLE_REP_CLASSIFIER 0  // 1: threshold reps also need the classifier's confirmation
+
+// Host protocol on USART2: live parameter tuning (tools/tune_params.py)
+#define ENABLE_HOST_PROTO 1  // 1: framed binary commands on USART2 at 115200 baud
+
+// Rep-to-pixel latency histograms (latency_trace.h), read with tune_params.py latency
+#define ENABLE_LATENCY_TRACE 1  // 1: timestamp peak, confirmation, UI enqueue and display flush of every rep
+
+// Raw IMU trace log in flash (trace_store.h), decoded with tools/trace_decode.py
+#define ENABLE_TRACE_STORE 1  // 1: record the raw samples of every running session, delta + Rice coded
+#define TRACE_ACCEL_DROP_BITS 0  // Accel LSBs dropped before coding (0: lossless; 5: 2 mg steps, below the sensor noise)
+#define TRACE_GYRO_DROP_BITS 0  // Gyro LSBs dropped before coding (0: lossless; 2: 0.03 deg/s steps)
+
+// Black-box recorder (blackbox.h): double press in RUNNING keeps the last seconds, replayed with tools/blackbox_replay.py
+#define ENABLE_BLACKBOX 1  // 1: RAM ring of raw samples and detector snapshots (~7 KB), dumped to flash when triggered
+#define BLACKBOX_AUTO_TRIGGER 1  // 1: an early count taken back at the end of its peak triggers it as well
 
 // Logging Configuration
 #define ENABLE_LOG_UART 0  // Enable/disable UART logging
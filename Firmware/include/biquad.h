@@ -0,0 +1,28 @@
+#ifndef BIQUAD_H
+#define BIQUAD_H
+
+#include <stdint.h>
+
+#define BIQUAD_COEFF_Q 29  // Coefficient format (Q29)
+
+// Direct-Form-I coefficients, feedback terms stored negated:
+// y = b0*x0 + b1*x1 + b2*x2 + na1*y1 + na2*y2
+typedef struct {
+    int32_t b0, b1, b2;
+    int32_t na1, na2;
+} biquad_coeffs_t;
+
+// Per-stage history plus the fractional residue (first-order error feedback)
+typedef struct {
+    int32_t x1, x2;
+    int32_t y1, y2;
+    uint32_t residue;
+} biquad_state_t;
+
+// Function declarations
+void biquad_reset(biquad_state_t *state, uint8_t stages);
+int32_t biquad_cascade(const biquad_coeffs_t *coeffs, biquad_state_t *state, uint8_t stages, int32_t x);
+void biquad_cascade_block(const biquad_coeffs_t *coeffs, biquad_state_t *state, uint8_t stages,
+                          int32_t *buf, uint16_t n);
+
+#endif // BIQUAD_H
@@ -0,0 +1,52 @@
+// Generated by tools/gen_biquad_coeffs.py from include/filter_spec.def and
+// include/exercises.def. Do not edit.
+#ifndef BIQUAD_COEFFS_H
+#define BIQUAD_COEFFS_H
+
+#include "biquad.h"
+#include "exercise_config.h"
+
+#define BIQUAD_SAMPLE_HZ 200
+#define BIQUAD_SMOOTH_STAGES 1
+#define BIQUAD_BANK_MAX_STAGES 2
+
+// 3-axis gyro smoothing
+static const biquad_coeffs_t BIQUAD_SMOOTH_COEFFS[BIQUAD_SMOOTH_STAGES] = {
+    {2975721, 5951442, 2975721, 954894753, -429926724}, // LOWPASS 5.00 Hz Q 0.7071
+};
+
+// Per-exercise rep signal banks (only the built exercises take flash)
+static const biquad_coeffs_t BIQUAD_BANK_COEFFS[EX_COUNT][BIQUAD_BANK_MAX_STAGES] = {
+#if EX_ENABLE_BICEP_CURL
+    [EX_BICEP_CURL] = {
+        {1944374, 3888748, 1944374, 978551123, -449457707}, // LOWPASS 4.00 Hz Q 0.7071
+        {535679597, -1071359194, 535679597, 1071356551, -534490925}, // HIGHPASS 0.10 Hz Q 0.7071
+    },
+#endif
+#if EX_ENABLE_SHOULDER_PRESS
+    [EX_SHOULDER_PRESS] = {
+        {1944374, 3888748, 1944374, 978551123, -449457707}, // LOWPASS 4.00 Hz Q 0.7071
+        {535679597, -1071359194, 535679597, 1071356551, -534490925}, // HIGHPASS 0.10 Hz Q 0.7071
+    },
+#endif
+#if EX_ENABLE_BENCH_PRESS
+    [EX_BENCH_PRESS] = {
+        {1116995, 2233991, 1116995, 1002279561, -469876630}, // LOWPASS 3.00 Hz Q 0.7071
+        {535679597, -1071359194, 535679597, 1071356551, -534490925}, // HIGHPASS 0.10 Hz Q 0.7071
+    },
+#endif
+};
+
+static const uint8_t BIQUAD_BANK_STAGES[EX_COUNT] = {
+#if EX_ENABLE_BICEP_CURL
+    [EX_BICEP_CURL] = 2,
+#endif
+#if EX_ENABLE_SHOULDER_PRESS
+    [EX_SHOULDER_PRESS] = 2,
+#endif
+#if EX_ENABLE_BENCH_PRESS
+    [EX_BENCH_PRESS] = 2,
+#endif
+};
+
+#endif // BIQUAD_COEFFS_H
@@ -0,0 +1,23 @@
+#ifndef CADENCE_H
+#define CADENCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Cadence estimator configuration
+#define CADENCE_HZ               10    // Rep signal decimated to this rate
+#define CADENCE_MIN_LAG          5     // Shortest rep period tracked (0.5 s)
+#define CADENCE_MAX_LAG          40    // Longest rep period tracked (4.0 s)
+#define CADENCE_EMA_SHIFT        6     // Autocorrelation averaging 1/64 (tau ~6.4 s)
+#define CADENCE_MIN_CORR         0.5f  // Normalized autocorrelation needed to trust the period
+#define CADENCE_REFRACTORY_FRAC  0.6f  // Refractory window as a fraction of the period
+#define CADENCE_PEAK_GAP_FRAC    0.3f  // Minimum spacing between peaks as a fraction of the period
+
+// Function declarations
+void cadence_reset(void);
+void cadence_update(float sample);
+bool cadence_get_period_ms(uint16_t *period_ms);
+uint16_t cadence_refractory_ms(uint16_t default_ms);
+uint16_t cadence_min_peak_gap_ms(uint16_t default_ms);
+
+#endif // CADENCE_H
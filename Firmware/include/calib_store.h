@@ -0,0 +1,45 @@
+#ifndef CALIB_STORE_H
+#define CALIB_STORE_H
+
+#include "stm32f1xx_hal.h"
+#include "exercise_config.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Calibration record in the last flash page (FLASH_STORE_CALIB_ADDR)
+#define CALIB_STORE_MAGIC   0x43414C42U  // "CALB"
+#define CALIB_STORE_VERSION 1            // Stored XOR exercise_config_list_hash()
+
+// Stored calibration of one exercise
+typedef struct {
+    float baseline_mu;
+    float baseline_sigma;
+    float gravity_ref[3];   // Resting gravity direction (gravity-relative projections)
+    uint8_t valid;
+    uint8_t reserved[3];
+} calib_store_exercise_t;
+
+// Calibration record (CRC-32 checked by flash_store)
+typedef struct {
+    uint8_t last_exercise;
+    uint8_t reserved[3];
+    float gyro_bias[3];     // deg/s
+    calib_store_exercise_t ex[EX_COUNT];
+} calib_store_t;
+
+/**
+ * @brief Loads the calibration page.
+ * @param store Filled with the stored record, or cleared if the page is invalid.
+ * @retval bool true if the stored record is valid.
+ */
+bool calib_store_load(calib_store_t *store);
+
+/**
+ * @brief Writes the record to the calibration page (erase + program, ~20 ms).
+ *        An unchanged page is not rewritten.
+ * @param store Record to write.
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef calib_store_save(const calib_store_t *store);
+
+#endif // CALIB_STORE_H
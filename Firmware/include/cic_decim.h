@@ -0,0 +1,15 @@
+#ifndef CIC_DECIM_H
+#define CIC_DECIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mpu6050.h"
+
+#define CIC_ORDER 3  // Integrator/comb stages (gain IMU_DECIMATION^3)
+
+// Function declarations
+void cic_decim_reset(void);
+bool cic_decim_push(const MPU6050_RawData_t *in, MPU6050_RawData_t *out);
+uint32_t cic_decim_get_cycles_max(void);
+
+#endif // CIC_DECIM_H
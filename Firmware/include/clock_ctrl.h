@@ -0,0 +1,110 @@
+#ifndef CLOCK_CTRL_H
+#define CLOCK_CTRL_H
+
+#include "stm32f1xx_hal.h"
+#include <stdint.h>
+
+// Clock profiles
+typedef enum {
+    CLOCK_PROFILE_LOW_POWER = 0,  // HSE 8 MHz direct, PLL off
+    CLOCK_PROFILE_FULL_SPEED      // HSE x 9 PLL, 72 MHz
+} clock_profile_t;
+
+// Load evaluation configuration
+#define CLOCK_LOAD_WINDOW_MS      250  // Length of one load measurement window
+#define CLOCK_LOAD_UP_PCT         60   // Switch to full speed above this load (low-power profile)
+#define CLOCK_LOAD_DOWN_PCT       45   // Switch to low power below this projected CPU load
+#define CLOCK_LOAD_DOWN_WINDOWS   4    // Consecutive quiet windows required before slowing down
+
+/**
+ * @brief Applies a clock profile to the RCC only (no peripheral re-timing).
+ *        Used from SystemClock_Config before any peripheral is initialized.
+ * @param profile Clock profile to apply.
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef clock_ctrl_apply_rcc(clock_profile_t profile);
+
+/**
+ * @brief Initializes load measurement. Call once all peripherals are up.
+ */
+void clock_ctrl_init(void);
+
+/**
+ * @brief Switches to a clock profile and re-times I2C, UART, SysTick and the timebase.
+ * @param profile Clock profile to switch to.
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef clock_ctrl_set_profile(clock_profile_t profile);
+
+/**
+ * @brief Gets the active clock profile.
+ * @retval clock_profile_t Active clock profile.
+ */
+clock_profile_t clock_ctrl_get_profile(void);
+
+/**
+ * @brief Gets the clock of the APB1 timers (TIM2-4) for the active profile:
+ *        PCLK1, doubled whenever APB1 is divided. Read it again after a
+ *        profile switch.
+ * @retval uint32_t Timer clock in Hz.
+ */
+uint32_t clock_ctrl_get_apb1_timer_hz(void);
+
+/**
+ * @brief Marks the start of a busy (pipeline) section for load measurement.
+ */
+void clock_ctrl_busy_begin(void);
+
+/**
+ * @brief Marks the end of a busy (pipeline) section for load measurement.
+ */
+void clock_ctrl_busy_end(void);
+
+/**
+ * @brief Marks the start of a blocking I2C or flash wait. Wait time is
+ *        subtracted from the busy time: it does not scale with the clock.
+ */
+void clock_ctrl_wait_begin(void);
+
+/**
+ * @brief Marks the end of a blocking I2C or flash wait.
+ */
+void clock_ctrl_wait_end(void);
+
+/**
+ * @brief Requests full speed immediately (e.g. after a missed sample deadline).
+ */
+void clock_ctrl_request_full_speed(void);
+
+/**
+ * @brief Evaluates the measured load and switches profile if needed.
+ *        Must be called from the main loop, outside of any bus transfer.
+ */
+void clock_ctrl_update(void);
+
+/**
+ * @brief Gets the CPU load measured over the last complete window (busy time
+ *        minus bus and flash waits).
+ * @retval uint8_t Load in percent (0-100).
+ */
+uint8_t clock_ctrl_get_load_pct(void);
+
+/**
+ * @brief Gets the share of the last complete window spent waiting on I2C or flash.
+ * @retval uint8_t Wait time in percent (0-100).
+ */
+uint8_t clock_ctrl_get_wait_pct(void);
+
+/**
+ * @brief Restarts the per-profile residency counters (e.g. when a set starts).
+ */
+void clock_ctrl_reset_residency(void);
+
+/**
+ * @brief Gets the time spent in a profile since the last residency reset.
+ * @param profile Clock profile.
+ * @retval uint32_t Milliseconds.
+ */
+uint32_t clock_ctrl_get_residency_ms(clock_profile_t profile);
+
+#endif // CLOCK_CTRL_H
@@ -0,0 +1,26 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include "stm32f1xx_hal.h"
+#include "exercise_config.h"
+#include <stdbool.h>
+
+// Committed exercise parameters in the config flash page (FLASH_STORE_CONFIG_ADDR)
+#define CONFIG_STORE_MAGIC   0x45584346U  // "EXCF"
+#define CONFIG_STORE_VERSION 1            // Stored XOR exercise_config_list_hash()
+
+/**
+ * @brief Applies the committed parameters over the live table.
+ *        Call after exercise_config_init(); an exercise whose stored values
+ *        fail the range check keeps its defaults.
+ * @retval bool true if a valid page was found.
+ */
+bool config_store_load(void);
+
+/**
+ * @brief Writes every exercise's live parameters to the config page.
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef config_store_commit(void);
+
+#endif // CONFIG_STORE_H
@@ -1,26 +1,92 @@
 #ifndef EXERCISE_CONFIG_H
 #define EXERCISE_CONFIG_H
 
+#include "app_config.h"
 #include <stdint.h>
 #include <stdbool.h>
 
-// Exercise types
+// Exercise types, one EX_<id> per built entry of exercises.def
 typedef enum {
-    EX_BICEP_CURL = 0,
-    EX_SHOULDER_PRESS = 1,
-    EX_BENCH_PRESS = 2,
+#define EXERCISE(id, ...) EX_##id,
+#include "exercises.def"
     EX_COUNT
 } exercise_t;
 
+_Static_assert(EX_COUNT > 0, "exercises.def: every exercise is disabled");
+
+// Dynamic threshold modes
+typedef enum {
+    THRESH_MODE_SIGMA = 0,  // baseline_mu + thresh_k * rolling sigma
+    THRESH_MODE_MAD         // rolling median + thresh_k * 1.4826 * rolling MAD
+} thresh_mode_t;
+
+// Rep signal projection kernels (resolved once when an exercise is selected)
+typedef enum {
+    PROJ_ACCEL_AXES = 0,  // Weighted sum of linear acceleration axes (g)
+    PROJ_GRAVITY_DIR,     // Linear acceleration along the gravity direction captured at calibration
+    PROJ_GYRO_AXES,       // Weighted sum of gyro axes (weights convert deg/s to signal units)
+    PROJ_COUNT
+} projection_t;
+
+// Projection kernels and threshold modes used by the built exercises; the
+// others are compiled out. The host protocol can switch any exercise to any
+// of them, so it keeps all built in.
+#define EX_ALL_MASK(count) ((1UL << (count)) - 1UL)
+enum {
+    EX_PROJ_USED_MASK = 0UL
+#define EXERCISE(id, name, k, prom, refr, warm, win, mode, proj, ...) | (1UL << (proj))
+#include "exercises.def"
+    ,
+    EX_THRESH_MODE_USED_MASK = 0UL
+#define EXERCISE(id, name, k, prom, refr, warm, win, mode, ...) | (1UL << (mode))
+#include "exercises.def"
+};
+#if ENABLE_HOST_PROTO
+#define EX_PROJ_BUILT_MASK        EX_ALL_MASK(PROJ_COUNT)
+#define EX_THRESH_MODE_BUILT_MASK EX_ALL_MASK(THRESH_MODE_MAD + 1)
+#else
+#define EX_PROJ_BUILT_MASK        EX_PROJ_USED_MASK
+#define EX_THRESH_MODE_BUILT_MASK EX_THRESH_MODE_USED_MASK
+#endif
+#define EX_PROJ_IS_BUILT(p)        ((EX_PROJ_BUILT_MASK >> (p)) & 1UL)
+#define EX_THRESH_MODE_IS_BUILT(m) ((EX_THRESH_MODE_BUILT_MASK >> (m)) & 1UL)
+
 // Exercise configuration structure
 typedef struct {
-    const char* name;
     float thresh_k;
     float min_prominence_g;
     uint16_t refractory_ms;
     uint16_t detect_warmup_ms;
+    uint16_t window_len;        // Rolling statistics window length in samples
+    thresh_mode_t thresh_mode;  // Dynamic threshold estimator
+    projection_t projection;    // Rep signal projection kernel
+    float proj_weights[3];      // Kernel weights (x, y, z); PROJ_GRAVITY_DIR uses [0] as gain
+    float template_gate;        // Max DTW template score for a threshold rep to count (0 = score only)
 } exercise_cfg_t;
 
+// Tunable exercise parameters, addressed by id from the host protocol and the
+// config flash page (values travel as float; integer fields are range-checked)
+typedef enum {
+    EX_PARAM_THRESH_K = 0,
+    EX_PARAM_MIN_PROMINENCE_G,
+    EX_PARAM_REFRACTORY_MS,
+    EX_PARAM_DETECT_WARMUP_MS,
+    EX_PARAM_WINDOW_LEN,
+    EX_PARAM_THRESH_MODE,
+    EX_PARAM_PROJECTION,
+    EX_PARAM_PROJ_WEIGHT_X,
+    EX_PARAM_PROJ_WEIGHT_Y,
+    EX_PARAM_PROJ_WEIGHT_Z,
+    EX_PARAM_TEMPLATE_GATE,
+    EX_PARAM_COUNT
+} exercise_param_t;
+
+// Parameters whose change needs re-derived state in the pipeline
+#define EX_PARAM_MASK(id)      (1UL << (id))
+#define EX_PARAM_MASK_DETECTOR (EX_PARAM_MASK(EX_PARAM_WINDOW_LEN) | EX_PARAM_MASK(EX_PARAM_THRESH_MODE))
+#define EX_PARAM_MASK_PROJECTION (EX_PARAM_MASK(EX_PARAM_PROJECTION) | EX_PARAM_MASK(EX_PARAM_PROJ_WEIGHT_X) | \
+                                  EX_PARAM_MASK(EX_PARAM_PROJ_WEIGHT_Y) | EX_PARAM_MASK(EX_PARAM_PROJ_WEIGHT_Z))
+
 // Per-exercise runtime context
 typedef struct {
     float baseline_mu;
@@ -31,14 +97,25 @@ typedef struct {
     bool calibrated;
 } rep_ctx_t;
 
-// Exercise configuration table with sensible defaults
-extern const exercise_cfg_t EX_CFG[EX_COUNT];
+// Built-in defaults (flash) and the live table read by the pipeline (RAM)
+extern const exercise_cfg_t EX_CFG_DEFAULTS[EX_COUNT];
+extern exercise_cfg_t EX_CFG[EX_COUNT];
+
+// Display names
+extern const char *const EX_NAMES[EX_COUNT];
 
 // Runtime context for each exercise
 extern rep_ctx_t REP_CTX[EX_COUNT];
 
-// Exercise selection timing
-#define EXERCISE_SELECT_TIMEOUT_MS 2000  // Auto-advance every 2 seconds
+// Function declarations
+void exercise_config_init(void);
+void exercise_config_restore_defaults(exercise_t ex);
+bool exercise_param_get(exercise_t ex, exercise_param_t id, float *value);
+bool exercise_param_check(exercise_param_t id, float value);
+bool exercise_param_set(exercise_t ex, exercise_param_t id, float value);
+uint16_t exercise_config_list_hash(void);
+
+// Calibration and warm-up timing
 #define CALIBRATION_MS_EX 2000           // Exercise-specific calibration duration
 #define DETECT_WARMUP_MS 1000            // Warm-up window before running
 
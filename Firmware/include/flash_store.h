@@ -0,0 +1,62 @@
+#ifndef FLASH_STORE_H
+#define FLASH_STORE_H
+
+#include "stm32f1xx_hal.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Persistent pages at the top of the 128 KB flash, kept out of the image by
+// board_upload.maximum_size in platformio.ini
+#define FLASH_STORE_CALIB_ADDR  0x0801FC00U  // Last page: calibration (calib_store.h)
+#define FLASH_STORE_CONFIG_ADDR 0x0801F800U  // Tuned exercise parameters (exercise_config.h)
+#define FLASH_STORE_TRACE_ADDR  0x08017800U  // 32 pages below: IMU trace log (trace_store.h)
+#define FLASH_STORE_TRACE_END   FLASH_STORE_CONFIG_ADDR
+#define FLASH_STORE_BLACKBOX_ADDR 0x08015800U  // 8 pages below: black-box dump (blackbox.h)
+#define FLASH_STORE_BLACKBOX_END  FLASH_STORE_TRACE_ADDR
+
+// One record per page: magic, version and length header, the record padded
+// to a word, then a CRC-32 over header and record
+#define FLASH_STORE_MAX_RECORD  (FLASH_PAGE_SIZE - 12U)
+
+/**
+ * @brief Loads a record from a flash page.
+ * @param page_addr Page start address.
+ * @param magic Expected magic (identifies the record type).
+ * @param version Expected layout version.
+ * @param record Filled with the stored record; left untouched if invalid.
+ * @param length Record size in bytes (must match the stored length).
+ * @retval bool true if header and CRC match.
+ */
+bool flash_store_load(uint32_t page_addr, uint32_t magic, uint16_t version, void *record, uint16_t length);
+
+/**
+ * @brief Writes a record to a flash page (erase + program, ~20 ms).
+ *        An identical page is not rewritten.
+ * @param page_addr Page start address.
+ * @param magic Record type magic.
+ * @param version Layout version.
+ * @param record Record to store.
+ * @param length Record size in bytes (at most FLASH_STORE_MAX_RECORD).
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef flash_store_save(uint32_t page_addr, uint32_t magic, uint16_t version, const void *record, uint16_t length);
+
+/**
+ * @brief Erases one page (~20 ms, the CPU stalls while executing from flash).
+ * @param page_addr Page start address.
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef flash_store_erase_page(uint32_t page_addr);
+
+/**
+ * @brief Programs bytes into erased flash, one halfword at a time (an odd
+ *        length is padded with 0xFF, which leaves the byte erased).
+ *        A programmed halfword may only be rewritten with 0x0000.
+ * @param addr Halfword-aligned destination.
+ * @param data Bytes to program.
+ * @param length Byte count.
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef flash_store_program(uint32_t addr, const void *data, uint16_t length);
+
+#endif // FLASH_STORE_H
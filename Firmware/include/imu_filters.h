@@ -4,28 +4,28 @@
 #include "mpu6050.h"
 #include "exercise_config.h"
 
+// Fixed-point gravity estimator configuration
+#define IMU_FUSION_ACCEL_Q      14   // Accel in Q14: 16384 = 1 g
+#define IMU_FUSION_GYRO_Q       16   // Per-sample rotation increment in Q16 radians
+#define IMU_FUSION_STATE_FRAC   8    // Extra fraction bits kept in the gravity state
+#define IMU_FUSION_CORR_SHIFT   8    // Accel correction gain 1/256 (tau ~1.3 s at 200 Hz)
+
+// Samples filtered per pass of imu_filters_process_block() (stack scratch); longer blocks are split
+#define IMU_FILTERS_BLOCK_MAX   8
+
 // Vector type for 3D operations
 typedef struct {
     float x, y, z;
 } vec3_t;
 
-// IMU filter state structure
-typedef struct {
-    float accel_filtered[3];
-    float gyro_filtered[3];
-    float horizontal_ref[3];
-    float curl_axis_scalar;  // Scalar value for curl detection
-    struct {
-        float x, y, z;
-    } horizontal_vector;  // Vector for horizontal reference
-} IMUFilteredData_t;
-
 // Function declarations
 void imu_filters_init(void);
-void imu_filters_process_all(const MPU6050_ScaledData_t *raw_data, 
-                           IMUFilteredData_t *filtered_data, 
-                           float dt, 
-                           exercise_t exercise);
+void imu_filters_select_exercise(exercise_t exercise);
+void imu_filters_process_all(imu_sample_t *sample);
+void imu_filters_process_block(imu_sample_t *samples, uint16_t n);
+void imu_filters_get_gravity(vec3_t *gravity);
 void imu_filters_set_horizontal_reference(const vec3_t *ref);
+uint32_t imu_filters_get_fusion_cycles_max(void);
+uint32_t imu_filters_get_cycles_per_sample(void);
 
 #endif // IMU_FILTERS_H
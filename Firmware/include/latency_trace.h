@@ -0,0 +1,69 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <stdint.h>
+
+// Rep-to-pixel latency histograms (ENABLE_LATENCY_TRACE). Trace points, all on
+// the microsecond timebase:
+//   peak    - sample timestamp of the rep signal maximum (sensor time)
+//   confirm - the detector has accepted the rep
+//   enqueue - the new count is handed to the UI
+//   flush   - the display transfer showing it has completed
+#define LATENCY_TRACE_BINS    24  // Bin 0: < 2 ms, then two per octave from 2 ms; the last is open-ended (>= 4096 ms)
+#define LATENCY_TRACE_PENDING 4   // Reps waiting for their flush
+
+typedef enum {
+    LAT_SPAN_PEAK_TO_CONFIRM = 0,  // Detector: return below threshold, acquisition, processing
+    LAT_SPAN_CONFIRM_TO_ENQUEUE,   // Wait for the next UI tick
+    LAT_SPAN_ENQUEUE_TO_FLUSH,     // Redraw and I2C transfer
+    LAT_SPAN_PEAK_TO_FLUSH,        // End to end
+    LAT_SPAN_COUNT
+} latency_span_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t mean_us;
+    uint16_t bins[LATENCY_TRACE_BINS];  // Saturating counts
+} latency_hist_t;
+
+/**
+ * @brief Clears every histogram and drops the reps in flight.
+ */
+void latency_trace_reset(void);
+
+/**
+ * @brief Drops the reps in flight (new set, state change); histograms are kept.
+ */
+void latency_trace_cancel(void);
+
+/**
+ * @brief Peak and confirm trace points of one accepted rep.
+ * @param peak_us Sample timestamp of the peak maximum.
+ * @param confirm_us Timebase when the detector returned the rep.
+ */
+void latency_trace_confirm(uint32_t peak_us, uint32_t confirm_us);
+
+/**
+ * @brief Drops the latest confirmed rep if it has not been shown yet (taken
+ *        back by the detector); a rep already flushed stays in the histograms.
+ */
+void latency_trace_retract(void);
+
+/**
+ * @brief Enqueue trace point: the reps confirmed so far go to the display.
+ */
+void latency_trace_enqueue(uint32_t now_us);
+
+/**
+ * @brief Flush trace point: closes the enqueued reps and records their spans.
+ */
+void latency_trace_flush(uint32_t now_us);
+
+/**
+ * @brief Copies the histogram of one span.
+ */
+void latency_trace_get(latency_span_t span, latency_hist_t *hist);
+
+#endif // LATENCY_TRACE_H
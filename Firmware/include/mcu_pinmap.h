@@ -2,6 +2,7 @@
 #define MCU_PINMAP_H
 
 #include "stm32f1xx_hal.h"
+#include "app_config.h"
 
 // TODO: Adjust I2C and UART pin assignments if your PCB differs.
 // The following assignments are common for STM32F103CB.
@@ -14,15 +15,20 @@
 
 extern I2C_HandleTypeDef hi2c1;
 
-// Optional UART2 Pins for logging
-#ifdef ENABLE_LOG_UART
+// User push button (SW_Push to GND, internal pull-up, EXTI9_5)
+#define BUTTON_PIN          GPIO_PIN_9
+#define BUTTON_GPIO_PORT    GPIOA
+#define BUTTON_EXTI_IRQn    EXTI9_5_IRQn
+
+// Optional UART2 Pins for logging and the host protocol
+#if ENABLE_LOG_UART || ENABLE_HOST_PROTO
 #define UART2_TX_PIN        GPIO_PIN_2
 #define UART2_TX_GPIO_PORT  GPIOA
 #define UART2_RX_PIN        GPIO_PIN_3
 #define UART2_RX_GPIO_PORT  GPIOA
 
 extern UART_HandleTypeDef huart2;
-#endif /* ENABLE_LOG_UART */
+#endif /* ENABLE_LOG_UART || ENABLE_HOST_PROTO */
 
 #endif // MCU_PINMAP_H
 
@@ -0,0 +1,24 @@
+#ifndef NN_KERNELS_H
+#define NN_KERNELS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Fully connected int8 layer (symmetric quantization, zero point 0).
+// Weights are row-major [out_len][in_len] with in_len a multiple of 4.
+// Each output is requantized as (acc * mult) >> shift, then clamped to int8.
+typedef struct {
+    const int8_t *weights;
+    const int32_t *bias;   // Pre-scaled to the accumulator (s_in * s_w)
+    uint16_t in_len;
+    uint16_t out_len;
+    int32_t mult;          // Requantization multiplier, Q(shift)
+    uint8_t shift;
+    bool relu;
+} nn_dense_t;
+
+// Function declarations
+void nn_dense_s8(const nn_dense_t *layer, const int8_t *in, int8_t *out);
+uint8_t nn_argmax_s8(const int8_t *v, uint8_t n, int16_t *margin);
+
+#endif // NN_KERNELS_H
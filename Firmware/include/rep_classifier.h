@@ -0,0 +1,26 @@
+#ifndef REP_CLASSIFIER_H
+#define REP_CLASSIFIER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mpu6050.h"
+#include "exercise_config.h"
+
+// Latest classification of the six-axis window
+typedef struct {
+    bool is_rep;              // A rep ended within the last 0.5 s of the window
+    int16_t rep_margin;       // Logit lead of the rep decision (int8 units)
+    exercise_t exercise;      // Most likely exercise
+    int16_t exercise_margin;  // Logit lead of the exercise decision
+} rep_class_t;
+
+// Function declarations (ENABLE_REP_CLASSIFIER builds only)
+void rep_classifier_reset(void);
+bool rep_classifier_update(const MPU6050_ScaledData_t *sample);
+bool rep_classifier_get_last(rep_class_t *out);
+void rep_classifier_arm(void);
+void rep_classifier_disarm(void);
+bool rep_classifier_confirm(void);
+uint32_t rep_classifier_get_cycles_max(void);
+
+#endif // REP_CLASSIFIER_H
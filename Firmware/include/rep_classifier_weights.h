@@ -0,0 +1,33 @@
+// Generated by tools/train_rep_classifier.py. Do not edit.
+#ifndef REP_CLASSIFIER_WEIGHTS_H
+#define REP_CLASSIFIER_WEIGHTS_H
+
+#include <stdint.h>
+
+#define REP_CLASSIFIER_TRAINED 0
+#define REP_CLASSIFIER_HZ 20
+#define REP_CLASSIFIER_STEPS 48
+#define REP_CLASSIFIER_IN 288
+#define REP_CLASSIFIER_H1 32
+#define REP_CLASSIFIER_H2 16
+#define REP_CLASSIFIER_OUT 5  // rep head (2) + exercise head
+#define REP_CLASSIFIER_EX_COUNT 3
+#define REP_CLASSIFIER_ACCEL_Q 32.0f  // int8 LSB per g
+#define REP_CLASSIFIER_GYRO_Q 0.5f   // int8 LSB per deg/s
+
+#define REP_CLASSIFIER_L1_MULT 1073741824
+#define REP_CLASSIFIER_L1_SHIFT 30
+static const int8_t REP_CLASSIFIER_W1[9216] = {0};
+static const int32_t REP_CLASSIFIER_B1[32] = {0};
+
+#define REP_CLASSIFIER_L2_MULT 1073741824
+#define REP_CLASSIFIER_L2_SHIFT 30
+static const int8_t REP_CLASSIFIER_W2[512] = {0};
+static const int32_t REP_CLASSIFIER_B2[16] = {0};
+
+#define REP_CLASSIFIER_L3_MULT 1073741824
+#define REP_CLASSIFIER_L3_SHIFT 30
+static const int8_t REP_CLASSIFIER_W3[80] = {0};
+static const int32_t REP_CLASSIFIER_B3[5] = {0};
+
+#endif // REP_CLASSIFIER_WEIGHTS_H
@@ -4,31 +4,46 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "exercise_config.h"
+#include "mpu6050.h"
 
 // Constants
 #define MIN_PEAK_INTERVAL_MS 200  // Minimum time between peaks to count as separate reps
+#define REP_DETECT_ARENA_BYTES 512  // Shared state arena for the selected exercise
+#define REP_SAMPLE_SCALE 4096.0f    // Window samples stored as int16, 1/4096 g per LSB (+/-8 g)
+#define REP_DETECT_BLOCK_MAX 32     // Samples per rep_detect_update_block() call (one result bit each)
+
+#define EARLY_CONFIRM_DROP 0.25f    // REP_EARLY_CONFIRM: fall below the maximum that establishes a peak (fraction of its height)
 
 // Rep detection state structure
 typedef struct {
-    uint32_t last_rep_time_ms;
-    uint32_t last_peak_time_ms;
+    uint32_t last_rep_time_us;   // Sample timestamps (microsecond timebase)
+    uint32_t last_peak_time_us;
     float last_peak_value;
     float threshold;
     float mean;
     float std_dev;
     uint16_t sample_count;
     bool in_peak;
-    uint32_t peak_start_time;
+    uint32_t peak_start_time_us;
+    uint32_t peak_max_time_us;   // Sample time of last_peak_value (maximum of the latest peak)
+    bool early_counted;          // The current peak is already in the count (REP_EARLY_CONFIRM)
+    float early_threshold;       // Threshold when it was counted; its prominence is judged against it
+    uint16_t retracted_count;    // Early counts taken back at the end of their peak
+    bool skip_peak;              // Set restarted mid-peak: no new peak until the signal is below threshold
 } RepDetectState_t;
 
 // Function declarations
 void rep_detect_init(void);
+void rep_detect_select(exercise_t ex);
 void rep_detect_begin_calibration(exercise_t ex);
 void rep_detect_accumulate_calibration(exercise_t ex, float sample);
 void rep_detect_end_calibration(exercise_t ex, float *out_mu, float *out_sigma);
-bool rep_detect_update(exercise_t ex, float sample, uint32_t now_ms);
+void rep_detect_seed(exercise_t ex, float mu, float sigma);
+bool rep_detect_update(exercise_t ex, float sample, uint32_t now_us);
+uint32_t rep_detect_update_block(exercise_t ex, const imu_sample_t *samples, uint16_t n);
 uint16_t rep_detect_get_count(exercise_t ex);
 void rep_detect_reset_count(exercise_t ex);
 void rep_detect_get_state(exercise_t ex, RepDetectState_t *state);
+uint32_t rep_detect_get_cycles_per_sample(void);
 
 #endif // REP_DETECT_H
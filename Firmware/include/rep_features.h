@@ -0,0 +1,29 @@
+#ifndef REP_FEATURES_H
+#define REP_FEATURES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STANDARD_GRAVITY_MPS2 9.80665f
+#define REP_FEATURES_MAX_PHASE_MS 4000  // A phase whose velocity has not crossed zero by then is closed
+
+// Per-rep feature record (fixed size). The phases are split where the
+// velocity integrated from onset crosses zero (interpolated between samples),
+// so the record of a confirmed rep completes at the bottom of its return.
+typedef struct {
+    uint32_t rep_end_us;      // Sample timestamp of the confirmation (microsecond timebase)
+    uint16_t concentric_ms;   // Movement onset to the top of the rep (velocity back to zero)
+    uint16_t eccentric_ms;    // Top of the rep to the bottom (velocity back to zero), 0 if not seen
+    uint16_t peak_accel_ms;   // Movement onset to peak acceleration (peak interpolated between samples)
+    float peak_accel_g;       // Peak rep signal above baseline
+    float peak_velocity_mps;  // Peak integrated velocity along the rep axis
+    float rom_deg;            // Rotation about the dominant gyro axis, onset to top (range-of-motion proxy)
+} rep_record_t;
+
+// Function declarations
+void rep_features_reset(float baseline);
+void rep_features_update(float sample, const float gyro_dps[3], float dt, uint32_t now_us);
+void rep_features_confirm(uint32_t now_us);
+bool rep_features_get_last(rep_record_t *record);
+
+#endif // REP_FEATURES_H
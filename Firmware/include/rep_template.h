@@ -0,0 +1,26 @@
+#ifndef REP_TEMPLATE_H
+#define REP_TEMPLATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "exercise_config.h"
+
+// Template matching configuration
+#define REP_TEMPLATE_HZ          25   // Rep signal decimated to this rate for matching
+#define REP_TEMPLATE_MAX_LEN     64   // Longest template in samples (2.56 s at 25 Hz)
+#define REP_TEMPLATE_MIN_LEN     8    // Shorter segments are not enrolled
+#define REP_TEMPLATE_COUNT       2    // Reference reps recorded per exercise
+#define REP_TEMPLATE_BAND        6    // Sakoe-Chiba half width in samples (240 ms)
+#define REP_TEMPLATE_PREROLL_MS  400  // Signal kept before the threshold crossing
+
+// Function declarations
+void rep_template_reset(exercise_t ex);
+void rep_template_update(float sample);
+void rep_template_arm(void);
+void rep_template_disarm(void);
+bool rep_template_confirm(uint32_t segment_ms, float *out_score);
+float rep_template_get_score(void);
+uint8_t rep_template_get_count(void);
+uint32_t rep_template_get_cycles_max(void);
+
+#endif // REP_TEMPLATE_H
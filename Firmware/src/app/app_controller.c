@@ -6,20 +6,59 @@
 #include "mpu6050.h"
 #include "imu_filters.h"
 #include "rep_detect.h"
+#include "rep_features.h"
+#include "rep_template.h"
+#include "cadence.h"
+#include "rep_classifier.h"
+#include "clock_ctrl.h"
+#include "cic_decim.h"
+#include "calib_store.h"
+#include "button.h"
+#include "config_store.h"
+#include "host_proto.h"
+#include "latency_trace.h"
+#include "trace_store.h"
+#include "blackbox.h"
+#include "timebase.h"
+#include <math.h>
 #include <string.h>
 
 // Static application state
 static AppControllerState_t app_state;
 
-// IMU data structures
-static MPU6050_RawData_t imu_raw_data;
-static MPU6050_ScaledData_t imu_scaled_data;
-static IMUFilteredData_t imu_filtered_data;
+// Acquisition ring: one slot per raw frame of the current tick (one in
+// direct mode, a FIFO burst when oversampling). Decimation, scaling and
+// filtering rewrite the leading slots in place.
+#if IMU_OVERSAMPLE
+#define IMU_RING_SLOTS IMU_FIFO_BURST_MAX
+#else
+#define IMU_RING_SLOTS 1
+#endif
+_Static_assert(IMU_RING_SLOTS <= REP_DETECT_BLOCK_MAX, "IMU ring exceeds the detector's result mask");
+static imu_sample_t imu_ring[IMU_RING_SLOTS];
+static uint16_t imu_frame_count = 0;
+static uint32_t last_sample_us = 0;
+static bool has_last_sample = false;
 
 // Calibration data
 static float calib_rep_signal_sum = 0.0f;
 static float calib_rep_signal_sum_sq = 0.0f;
 static uint16_t calib_sample_count = 0;
+static float calib_gyro_sum[3] = {0.0f, 0.0f, 0.0f};
+
+// Persisted calibration of every exercise (RAM copy of the flash page)
+static calib_store_t calib_store;
+
+#if ENABLE_BLACKBOX
+// A short press in RUNNING waits BLACKBOX_DOUBLE_PRESS_MS for a second one
+// (black box) before it starts the new set
+static bool new_set_pending = false;
+static uint32_t last_short_press_ms = 0;
+#endif
+
+#if RESUME_ON_BOOT
+static bool resume_stored_calibration(void);
+#endif
 
 /**
  * @brief Initializes the application controller.
@@ -28,17 +67,40 @@ void app_controller_init(void)
 {
     // Initialize state
     app_state.current_state = APP_STATE_BOOT;
-    app_state.current_exercise = EX_BICEP_CURL; // Default to bicep curl
+    app_state.current_exercise = (exercise_t)0; // First exercise in exercises.def
     app_state.state_start_time_ms = 0;
     app_state.last_imu_sample_time_ms = 0;
     app_state.last_ui_update_time_ms = 0;
     app_state.rep_count = 0;
     app_state.rep_detected = false;
-    app_state.exercise_select_time_ms = 0;
+    
+    // Live exercise parameters: defaults, then the committed tuning
+    exercise_config_init();
+    config_store_load();
     
     // Initialize subsystems
     imu_filters_init();
     rep_detect_init();
+#if ENABLE_LATENCY_TRACE
+    latency_trace_reset();
+#endif
+#if ENABLE_TRACE_STORE
+    trace_store_init();
+#endif
+#if ENABLE_BLACKBOX
+    blackbox_init();
+#endif
+    
+    // Load stored calibrations; an invalid page leaves every record cleared
+    calib_store_load(&calib_store);
+
+#if RESUME_ON_BOOT
+    // Skip selection and calibration when the last exercise has a stored baseline
+    if (resume_stored_calibration())
+    {
+        return;
+    }
+#endif
     
     // Show splash screen
     ui_show_splash("Gym Rep Tracker");
@@ -47,6 +109,258 @@ void app_controller_init(void)
     app_state.state_start_time_ms = systick_get_uptime_ms();
 }
 
+/**
+ * @brief Raises the clock immediately if an IMU sample deadline was missed.
+ */
+static void check_sample_deadline(uint32_t current_time)
+{
+    if ((current_time - app_state.last_imu_sample_time_ms) > 2 * IMU_SAMPLE_INTERVAL_MS)
+    {
+        clock_ctrl_request_full_speed();
+    }
+}
+
+/**
+ * @brief Fetches the raw frames available for this sample tick.
+ */
+static void fetch_imu_frames(void)
+{
+    imu_frame_count = 0;
+#if IMU_OVERSAMPLE
+    mpu6050_read_fifo(imu_ring, IMU_RING_SLOTS, &imu_frame_count);
+#else
+    if (mpu6050_read_raw(&imu_ring[0].raw) == HAL_OK)
+    {
+        imu_frame_count = 1;
+    }
+#endif
+}
+
+/**
+ * @brief Decimates the fetched frames to IMU_SAMPLE_HZ in place.
+ *        When oversampling, the CIC output k overwrites slot k, which is never
+ *        after the frame being pushed; a burst can yield zero, one or several samples.
+ * @retval uint16_t Number of samples now at the start of the ring.
+ */
+static uint16_t decimate_imu_frames(void)
+{
+#if IMU_OVERSAMPLE
+    uint16_t n = 0;
+    for (uint16_t k = 0; k < imu_frame_count; k++)
+    {
+        if (cic_decim_push(&imu_ring[k].raw, &imu_ring[n].raw))
+        {
+            n++;
+        }
+    }
+    return n;
+#else
+    return imu_frame_count;
+#endif
+}
+
+/**
+ * @brief Gets the real interval to the previous sample from the timestamps.
+ *        Falls back to the nominal interval for the first sample after a
+ *        restart and for implausible gaps.
+ */
+static uint32_t sample_dt(uint32_t timestamp_us)
+{
+    uint32_t delta_us = timestamp_us - last_sample_us;
+    bool valid = has_last_sample && delta_us > 0 && delta_us <= 4000U * IMU_SAMPLE_INTERVAL_MS;
+    
+    last_sample_us = timestamp_us;
+    has_last_sample = true;
+    return valid ? delta_us : 1000U * IMU_SAMPLE_INTERVAL_MS;
+}
+
+/**
+ * @brief Decimates and filters (which scales) the samples of this tick in place.
+ * @retval uint16_t Number of filtered slots at the start of imu_ring.
+ */
+static uint16_t filter_imu_block(void)
+{
+    uint16_t n = decimate_imu_frames();
+    for (uint16_t k = 0; k < n; k++)
+    {
+#if ENABLE_TRACE_STORE
+        // Raw frames are only in the slot until the filters scale it
+        trace_store_append(&imu_ring[k].raw);
+#endif
+#if ENABLE_BLACKBOX
+        blackbox_record(&imu_ring[k].raw);
+#endif
+        imu_ring[k].dt_us = sample_dt(imu_ring[k].raw.timestamp_us);
+    }
+
+#if IMU_BLOCK_PROCESSING
+    imu_filters_process_block(imu_ring, n);
+#else
+    for (uint16_t k = 0; k < n; k++)
+    {
+        imu_filters_process_all(&imu_ring[k]);
+    }
+#endif
+    return n;
+}
+
+/**
+ * @brief Runs the filtered block through the rep detector.
+ * @retval uint32_t Bit k set if slot k ended a rep.
+ */
+static uint32_t detect_rep_block(uint16_t n)
+{
+    exercise_t ex = app_state.current_exercise;
+
+#if IMU_BLOCK_PROCESSING && !ENABLE_REP_CLASSIFIER
+    return rep_detect_update_block(ex, imu_ring, n);
+#else
+    // The classifier has to see each sample before the detector's verdict on it
+    uint32_t rep_mask = 0;
+    for (uint16_t k = 0; k < n; k++)
+    {
+#if ENABLE_REP_CLASSIFIER
+        rep_classifier_update(&imu_ring[k].scaled);
+#endif
+        if (rep_detect_update(ex, imu_ring[k].rep_signal, imu_ring[k].scaled.timestamp_us))
+        {
+            rep_mask |= 1UL << k;
+        }
+    }
+    return rep_mask;
+#endif
+}
+
+/**
+ * @brief Restarts acquisition so the first sample after a pause is fresh.
+ */
+static void restart_imu_acquisition(void)
+{
+    imu_frame_count = 0;
+    has_last_sample = false;
+    
+    // The sample deadline counts from here, not from the last state that sampled
+    app_state.last_imu_sample_time_ms = systick_get_uptime_ms();
+#if IMU_OVERSAMPLE
+    // The FIFO overflowed while nobody was draining it
+    mpu6050_fifo_reset();
+    cic_decim_reset();
+#endif
+}
+
+/**
+ * @brief Resets the rep counter and the per-set trackers for a new set.
+ */
+static void reset_rep_session(void)
+{
+    rep_detect_reset_count(app_state.current_exercise);
+    rep_features_reset(REP_CTX[app_state.current_exercise].baseline_mu);
+    rep_template_reset(app_state.current_exercise);
+    cadence_reset();
+#if ENABLE_REP_CLASSIFIER
+    rep_classifier_reset();
+#endif
+#if ENABLE_LATENCY_TRACE
+    latency_trace_cancel();
+#endif
+    app_state.rep_count = 0;
+}
+
+/**
+ * @brief Enters the RUNNING state with fresh acquisition.
+ */
+static void enter_running_state(void)
+{
+    app_state.current_state = APP_STATE_RUNNING;
+    app_state.state_start_time_ms = systick_get_uptime_ms();
+#if ENABLE_TRACE_STORE
+    // One trace session per running exercise, none while the log waits for a download
+    // (host_proto SESSIONS); a page erase stalls before acquisition restarts
+    trace_store_begin((uint8_t)app_state.current_exercise);
+#endif
+    restart_imu_acquisition();
+    
+    // Profile residency is reported per set (host_proto INFO)
+    clock_ctrl_reset_residency();
+    
+    // Show exercise start message
+    ui_show_exercise_and_count(EX_NAMES[app_state.current_exercise], app_state.rep_count);
+}
+
+#if RESUME_ON_BOOT
+/**
+ * @brief Restores the last exercise's stored calibration and starts counting.
+ * @retval bool false if the stored page has no calibration for that exercise.
+ */
+static bool resume_stored_calibration(void)
+{
+    exercise_t ex = (exercise_t)calib_store.last_exercise;
+    const calib_store_exercise_t *rec = &calib_store.ex[ex];
+    if (!rec->valid)
+    {
+        return false;
+    }
+    
+    app_state.current_exercise = ex;
+    mpu6050_set_gyro_bias(calib_store.gyro_bias);
+    imu_filters_select_exercise(ex);
+    vec3_t horizontal_ref = {rec->gravity_ref[0], rec->gravity_ref[1], rec->gravity_ref[2]};
+    imu_filters_set_horizontal_reference(&horizontal_ref);
+    
+    // Prefilled window: the first sample is already checked against the threshold
+    rep_detect_select(ex);
+    rep_detect_seed(ex, rec->baseline_mu, rec->baseline_sigma);
+    reset_rep_session();
+    enter_running_state();
+    return true;
+}
+#endif
+
+/**
+ * @brief Stores the calibration just taken, with the current gyro bias.
+ */
+static void store_calibration(exercise_t ex, const vec3_t *gravity)
+{
+    calib_store_exercise_t *rec = &calib_store.ex[ex];
+    
+    rec->baseline_mu = REP_CTX[ex].baseline_mu;
+    rec->baseline_sigma = REP_CTX[ex].baseline_sigma;
+    rec->gravity_ref[0] = gravity->x;
+    rec->gravity_ref[1] = gravity->y;
+    rec->gravity_ref[2] = gravity->z;
+    rec->valid = 1;
+    calib_store.last_exercise = (uint8_t)ex;
+    mpu6050_get_gyro_bias(calib_store.gyro_bias);
+    
+    // The erase stalls the CPU for ~20 ms; acquisition restarts after the warm-up anyway
+    calib_store_save(&calib_store);
+}
+
+/**
+ * @brief Folds the mean gyro rate of the (still) calibration window into the bias.
+ */
+static void update_gyro_bias(void)
+{
+    float bias[3];
+    
+    if (calib_sample_count == 0)
+    {
+        return;
+    }
+    
+    mpu6050_get_gyro_bias(bias);
+    for (int i = 0; i < 3; i++)
+    {
+        float mean = calib_gyro_sum[i] / calib_sample_count;
+        if (fabsf(mean) > GYRO_BIAS_MAX_DPS)
+        {
+            return;
+        }
+        bias[i] += mean;
+    }
+    mpu6050_set_gyro_bias(bias);
+}
+
 /**
  * @brief Handles the BOOT state.
  */
@@ -58,48 +372,97 @@ static void handle_boot_state(void)
         // Transition to SELECTING_EXERCISE state
         app_state.current_state = APP_STATE_SELECTING_EXERCISE;
         app_state.state_start_time_ms = systick_get_uptime_ms();
-        app_state.exercise_select_time_ms = systick_get_uptime_ms();
         
         // Show first exercise selection
-        ui_show_select(EX_CFG[app_state.current_exercise].name);
+        ui_show_select(EX_NAMES[app_state.current_exercise]);
     }
 }
 
 /**
- * @brief Handles the SELECTING_EXERCISE state.
+ * @brief Starts calibrating the exercise on screen.
  */
-static void handle_selecting_exercise_state(void)
+static void start_calibration(void)
 {
-    uint32_t current_time = systick_get_uptime_ms();
+    // Transition to CALIBRATING_EXERCISE state
+    app_state.current_state = APP_STATE_CALIBRATING_EXERCISE;
+    app_state.state_start_time_ms = systick_get_uptime_ms();
     
-    // Auto-advance through exercises every 2 seconds
-    if (systick_has_elapsed(app_state.exercise_select_time_ms, EXERCISE_SELECT_TIMEOUT_MS))
-    {
-        // Move to next exercise
-        app_state.current_exercise = (app_state.current_exercise + 1) % EX_COUNT;
-        app_state.exercise_select_time_ms = current_time;
-        
-        // Show new exercise selection
-        ui_show_select(EX_CFG[app_state.current_exercise].name);
-    }
+    // Show calibration message
+    ui_show_calibrating(EX_NAMES[app_state.current_exercise]);
     
-    // After 6 seconds (3 exercises * 2 seconds), proceed to calibration
-    if (systick_has_elapsed(app_state.state_start_time_ms, EX_COUNT * EXERCISE_SELECT_TIMEOUT_MS))
+    // Resolve the projection kernel, allocate detector state and begin calibration
+    imu_filters_select_exercise(app_state.current_exercise);
+    rep_detect_select(app_state.current_exercise);
+    rep_detect_begin_calibration(app_state.current_exercise);
+    restart_imu_acquisition();
+    
+    // Reset calibration accumulators
+    calib_rep_signal_sum = 0.0f;
+    calib_rep_signal_sum_sq = 0.0f;
+    calib_sample_count = 0;
+    calib_gyro_sum[0] = 0.0f;
+    calib_gyro_sum[1] = 0.0f;
+    calib_gyro_sum[2] = 0.0f;
+}
+
+/**
+ * @brief Starts a new set on the current calibration.
+ */
+static void start_new_set(void)
+{
+    reset_rep_session();
+    ui_show_exercise_and_count(EX_NAMES[app_state.current_exercise], app_state.rep_count);
+}
+
+/**
+ * @brief Handles a debounced button event (raised by the EXTI/TIM4 interrupts).
+ *        Selecting: short press shows the next exercise, long press starts
+ *        calibrating it. Running: short press starts a new set (with the
+ *        black box, once no second press followed; a double press only
+ *        freezes the black box), long press goes back to exercise selection.
+ */
+static void handle_button_event(button_event_t event)
+{
+    switch (app_state.current_state)
     {
-        // Transition to CALIBRATING_EXERCISE state
-        app_state.current_state = APP_STATE_CALIBRATING_EXERCISE;
-        app_state.state_start_time_ms = current_time;
-        
-        // Show calibration message
-        ui_show_calibrating(EX_CFG[app_state.current_exercise].name);
+        case APP_STATE_SELECTING_EXERCISE:
+            if (event == BUTTON_EVENT_SHORT)
+            {
+                app_state.current_exercise = (app_state.current_exercise + 1) % EX_COUNT;
+                ui_show_select(EX_NAMES[app_state.current_exercise]);
+            }
+            else
+            {
+                start_calibration();
+            }
+            break;
         
-        // Begin calibration for selected exercise
-        rep_detect_begin_calibration(app_state.current_exercise);
+        case APP_STATE_RUNNING:
+            if (event == BUTTON_EVENT_SHORT)
+            {
+#if ENABLE_BLACKBOX
+                // Second press of a double press: the set goes on, the first press is dropped
+                if (new_set_pending)
+                {
+                    new_set_pending = false;
+                    blackbox_trigger(BLACKBOX_REASON_BUTTON);
+                    break;
+                }
+                new_set_pending = true;
+                last_short_press_ms = systick_get_uptime_ms();
+#else
+                start_new_set();
+#endif
+            }
+            else
+            {
+                app_controller_recalibrate();
+            }
+            break;
         
-        // Reset calibration accumulators
-        calib_rep_signal_sum = 0.0f;
-        calib_rep_signal_sum_sq = 0.0f;
-        calib_sample_count = 0;
+        default:
+            // Boot, calibration and warm-up run to completion
+            break;
     }
 }
 
@@ -113,23 +476,23 @@ static void handle_calibrating_exercise_state(void)
     // IMU sampling at specified rate during calibration
     if (systick_has_elapsed(app_state.last_imu_sample_time_ms, IMU_SAMPLE_INTERVAL_MS))
     {
+        check_sample_deadline(current_time);
         app_state.last_imu_sample_time_ms = current_time;
         
-        // Read IMU data
-        if (mpu6050_read_raw(&imu_raw_data) == HAL_OK)
+        // Read IMU data, then filter it and compute the rep signal
+        fetch_imu_frames();
+        uint16_t n = filter_imu_block();
+        for (uint16_t k = 0; k < n; k++)
         {
-            // Convert to scaled values
-            mpu6050_convert_to_scaled(&imu_raw_data, &imu_scaled_data);
-            
-            // Apply filters and compute rep signal
-            float dt = (float)IMU_SAMPLE_INTERVAL_MS / 1000.0f;
-            imu_filters_process_all(&imu_scaled_data, &imu_filtered_data, dt, app_state.current_exercise);
-            
             // Accumulate calibration data
-            float rep_signal = imu_filtered_data.curl_axis_scalar;
+            const imu_sample_t *sample = &imu_ring[k];
+            float rep_signal = sample->rep_signal;
             calib_rep_signal_sum += rep_signal;
             calib_rep_signal_sum_sq += rep_signal * rep_signal;
             calib_sample_count++;
+            calib_gyro_sum[0] += sample->scaled.gyro_x_deg_s;
+            calib_gyro_sum[1] += sample->scaled.gyro_y_deg_s;
+            calib_gyro_sum[2] += sample->scaled.gyro_z_deg_s;
             
             // Also accumulate in rep detection system
             rep_detect_accumulate_calibration(app_state.current_exercise, rep_signal);
@@ -143,15 +506,16 @@ static void handle_calibrating_exercise_state(void)
         float mu, sigma;
         rep_detect_end_calibration(app_state.current_exercise, &mu, &sigma);
         
-        // For bench press, set horizontal reference vector
-        if (app_state.current_exercise == EX_BENCH_PRESS)
+        // Capture the resting gravity direction for gravity-relative projections
+        vec3_t horizontal_ref;
+        imu_filters_get_gravity(&horizontal_ref);
+        imu_filters_set_horizontal_reference(&horizontal_ref);
+        
+        // Persist baseline, gravity direction and gyro bias for the next power-up
+        update_gyro_bias();
+        if (REP_CTX[app_state.current_exercise].calibrated)
         {
-            vec3_t horizontal_ref = {
-                imu_filtered_data.horizontal_vector.x,
-                imu_filtered_data.horizontal_vector.y,
-                imu_filtered_data.horizontal_vector.z
-            };
-            imu_filters_set_horizontal_reference(&horizontal_ref);
+            store_calibration(app_state.current_exercise, &horizontal_ref);
         }
         
         // Transition to DETECTING state
@@ -161,9 +525,8 @@ static void handle_calibrating_exercise_state(void)
         // Show detecting message
         ui_show_status("Detecting...");
         
-        // Reset rep counter
-        rep_detect_reset_count(app_state.current_exercise);
-        app_state.rep_count = 0;
+        // Reset rep counter, per-rep feature extraction, template enrolment and cadence
+        reset_rep_session();
     }
 }
 
@@ -176,11 +539,7 @@ static void handle_detecting_state(void)
     if (systick_has_elapsed(app_state.state_start_time_ms, DETECT_WARMUP_MS))
     {
         // Transition to RUNNING state
-        app_state.current_state = APP_STATE_RUNNING;
-        app_state.state_start_time_ms = systick_get_uptime_ms();
-        
-        // Show exercise start message
-        ui_show_exercise_and_count(EX_CFG[app_state.current_exercise].name, 0);
+        enter_running_state();
     }
 }
 
@@ -194,29 +553,57 @@ static void handle_running_state(void)
     // IMU sampling at specified rate
     if (systick_has_elapsed(app_state.last_imu_sample_time_ms, IMU_SAMPLE_INTERVAL_MS))
     {
+        check_sample_deadline(current_time);
         app_state.last_imu_sample_time_ms = current_time;
         
-        // Read IMU data
-        if (mpu6050_read_raw(&imu_raw_data) == HAL_OK)
+        // Read IMU data and filter it
+        fetch_imu_frames();
+        uint16_t n = filter_imu_block();
+        uint32_t rep_mask = detect_rep_block(n);
+        
+        // Streaming rep features; a detected rep's record completes at the bottom of its return
+        for (uint16_t k = 0; k < n; k++)
         {
-            // Convert to scaled values
-            mpu6050_convert_to_scaled(&imu_raw_data, &imu_scaled_data);
-            
-            // Apply filters
-            float dt = (float)IMU_SAMPLE_INTERVAL_MS / 1000.0f;
-            imu_filters_process_all(&imu_scaled_data, &imu_filtered_data, dt, app_state.current_exercise);
-            
-            // Update rep detection
-            app_state.rep_detected = rep_detect_update(app_state.current_exercise, 
-                                                     imu_filtered_data.curl_axis_scalar, 
-                                                     current_time);
-            
-            if (app_state.rep_detected)
+            const imu_sample_t *sample = &imu_ring[k];
+            uint32_t timestamp_us = sample->scaled.timestamp_us;
+            rep_features_update(sample->rep_signal, sample->gyro_filtered, sample->dt_us * 1e-6f, timestamp_us);
+            if (rep_mask & (1UL << k))
+            {
+                rep_features_confirm(timestamp_us);
+            }
+        }
+        
+        // The count can change at a peak (early confirmation) as well as at its end
+        uint16_t rep_count = rep_detect_get_count(app_state.current_exercise);
+#if ENABLE_LATENCY_TRACE
+        if (rep_count > app_state.rep_count)
+        {
+            // At most one rep per block (refractory > block length): the state still holds its peak
+            RepDetectState_t det_state;
+            rep_detect_get_state(app_state.current_exercise, &det_state);
+            latency_trace_confirm(det_state.peak_max_time_us, timebase_get_us());
+        }
+        else if (rep_count < app_state.rep_count)
+        {
+            latency_trace_retract();
+        }
+#endif
+#if ENABLE_BLACKBOX
+        if (n > 0)
+        {
+            uint8_t events = 0;
+            if (rep_count > app_state.rep_count) events |= BLACKBOX_EVENT_REP;
+            if (rep_count < app_state.rep_count)
             {
-                app_state.rep_count = rep_detect_get_count(app_state.current_exercise);
-                app_state.rep_detected = false; // Reset flag
+                events |= BLACKBOX_EVENT_RETRACT;
+#if BLACKBOX_AUTO_TRIGGER
+                blackbox_trigger(BLACKBOX_REASON_RETRACT);
+#endif
             }
+            blackbox_snapshot(app_state.current_exercise, imu_ring[n - 1].rep_signal, rep_count, events);
         }
+#endif
+        app_state.rep_count = rep_count;
     }
     
     // UI updates at specified rate
@@ -225,7 +612,13 @@ static void handle_running_state(void)
         app_state.last_ui_update_time_ms = current_time;
         
         // Update display with current rep count
-        ui_show_exercise_and_count(EX_CFG[app_state.current_exercise].name, app_state.rep_count);
+#if ENABLE_LATENCY_TRACE
+        latency_trace_enqueue(timebase_get_us());
+#endif
+        ui_show_exercise_and_count(EX_NAMES[app_state.current_exercise], app_state.rep_count);
+#if ENABLE_LATENCY_TRACE
+        latency_trace_flush(timebase_get_us());
+#endif
     }
 }
 
@@ -234,28 +627,58 @@ static void handle_running_state(void)
  */
 void app_controller_loop(void)
 {
+#if ENABLE_HOST_PROTO
+    // Parameter updates land between pipeline passes
+    host_proto_process();
+#endif
+#if ENABLE_BLACKBOX
+    // A frozen dump goes to flash one page per pass (erase + program, ~50 ms)
+    blackbox_process();
+#endif
+#if ENABLE_TRACE_STORE
+    // The next trace page is erased here rather than in the sample path
+    trace_store_process();
+#endif
+    
+    button_event_t event = button_get_event();
+    if (event != BUTTON_EVENT_NONE)
+    {
+        handle_button_event(event);
+    }
+#if ENABLE_BLACKBOX
+    // No second press followed: the single press starts the new set (dropped if RUNNING was left)
+    if (new_set_pending && systick_has_elapsed(last_short_press_ms, BLACKBOX_DOUBLE_PRESS_MS))
+    {
+        new_set_pending = false;
+        if (app_state.current_state == APP_STATE_RUNNING)
+        {
+            start_new_set();
+        }
+    }
+#endif
+    
     switch (app_state.current_state)
     {
         case APP_STATE_BOOT:
             handle_boot_state();
             break;
-            
+        
         case APP_STATE_SELECTING_EXERCISE:
-            handle_selecting_exercise_state();
+            // Waits for button events (handle_button_event)
             break;
-            
+        
         case APP_STATE_CALIBRATING_EXERCISE:
             handle_calibrating_exercise_state();
             break;
-            
+        
         case APP_STATE_DETECTING:
             handle_detecting_state();
             break;
-            
+        
         case APP_STATE_RUNNING:
             handle_running_state();
             break;
-            
+        
         default:
             // Invalid state, reset to boot
             app_state.current_state = APP_STATE_BOOT;
@@ -280,6 +703,9 @@ void app_controller_get_state(AppControllerState_t *state)
  */
 void app_controller_reset(void)
 {
+#if ENABLE_TRACE_STORE
+    trace_store_end();
+#endif
     app_state.current_state = APP_STATE_BOOT;
     app_state.state_start_time_ms = systick_get_uptime_ms();
     app_state.rep_count = 0;
@@ -292,6 +718,64 @@ void app_controller_reset(void)
     ui_show_splash("Gym Rep Tracker");
 }
 
+/**
+ * @brief Leaves the current set and goes back to exercise selection,
+ *        starting from the current exercise; the next calibration
+ *        overwrites its stored record.
+ */
+void app_controller_recalibrate(void)
+{
+#if ENABLE_TRACE_STORE
+    trace_store_end();
+#endif
+    app_state.current_state = APP_STATE_SELECTING_EXERCISE;
+    app_state.state_start_time_ms = systick_get_uptime_ms();
+    app_state.rep_count = 0;
+    app_state.rep_detected = false;
+    
+    ui_show_select(EX_NAMES[app_state.current_exercise]);
+}
+
+/**
+ * @brief Re-derives pipeline state after exercise parameters were changed.
+ */
+void app_controller_apply_config(exercise_t ex, uint32_t changed)
+{
+    // Other exercises pick their parameters up when they are selected
+    if (ex != app_state.current_exercise) return;
+    
+    switch (app_state.current_state)
+    {
+        case APP_STATE_CALIBRATING_EXERCISE:
+            // The baseline must be measured on the new rep signal
+            if (changed & (EX_PARAM_MASK_PROJECTION | EX_PARAM_MASK_DETECTOR))
+            {
+                start_calibration();
+            }
+            break;
+        
+        case APP_STATE_DETECTING:
+        case APP_STATE_RUNNING:
+            if (changed & EX_PARAM_MASK_PROJECTION)
+            {
+                imu_filters_select_exercise(ex);
+            }
+            if (changed & EX_PARAM_MASK_DETECTOR)
+            {
+                // New window layout: reseed from the calibrated baseline and start a new set,
+                // like a resumed calibration (count, features, template, cadence)
+                rep_detect_select(ex);
+                rep_detect_seed(ex, REP_CTX[ex].baseline_mu, REP_CTX[ex].baseline_sigma);
+                reset_rep_session();
+            }
+            break;
+        
+        default:
+            // Selection and boot read the table when calibration starts
+            break;
+    }
+}
+
 /**
  * @brief Gets the current rep count for the current exercise.
  */
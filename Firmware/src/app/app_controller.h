@@ -19,7 +19,6 @@ typedef struct {
     uint32_t last_ui_update_time_ms;
     uint16_t rep_count;
     bool rep_detected;
-    uint32_t exercise_select_time_ms;
 } AppControllerState_t;
 
 /**
@@ -43,6 +42,20 @@ void app_controller_get_state(AppControllerState_t *state);
  */
 void app_controller_reset(void);
 
+/**
+ * @brief Returns to exercise selection so the current (or another) exercise
+ *        is calibrated again; use after a stored calibration was resumed.
+ */
+void app_controller_recalibrate(void);
+
+/**
+ * @brief Re-derives pipeline state after live exercise parameters changed
+ *        (host protocol). Called between pipeline passes.
+ * @param ex Exercise whose parameters changed.
+ * @param changed EX_PARAM_MASK() bits of the changed parameters.
+ */
+void app_controller_apply_config(exercise_t ex, uint32_t changed);
+
 /**
  * @brief Gets the current rep count for the current exercise.
  * @retval uint16_t Current rep count.
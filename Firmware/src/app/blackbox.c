@@ -0,0 +1,276 @@
+#include "blackbox.h"
+#include "flash_store.h"
+#include "rep_detect.h"
+#include "systick.h"
+#include "app_config.h"
+#include <stddef.h>
+#include <string.h>
+
+#if ENABLE_BLACKBOX
+
+#define DUMP_START FLASH_STORE_BLACKBOX_ADDR
+#define DUMP_END   FLASH_STORE_BLACKBOX_END
+#define SAMPLE_MASK   (BLACKBOX_SAMPLES - 1U)
+#define SNAPSHOT_MASK (BLACKBOX_SNAPSHOTS - 1U)
+#define SAMPLE_BYTES  (6U * sizeof(int16_t))
+
+#define DUMP_MAX_BYTES (sizeof(blackbox_header_t) + BLACKBOX_SAMPLES * SAMPLE_BYTES + \
+                        BLACKBOX_SNAPSHOTS * sizeof(blackbox_snapshot_t))
+
+_Static_assert((BLACKBOX_SAMPLES & SAMPLE_MASK) == 0, "BLACKBOX_SAMPLES must be a power of two");
+_Static_assert((BLACKBOX_SNAPSHOTS & SNAPSHOT_MASK) == 0, "BLACKBOX_SNAPSHOTS must be a power of two");
+_Static_assert(BLACKBOX_POST_SAMPLES < BLACKBOX_SAMPLES, "post-trigger samples must leave history in the ring");
+_Static_assert(DUMP_MAX_BYTES <= DUMP_END - DUMP_START, "black-box dump exceeds its flash pages");
+_Static_assert(DUMP_MAX_BYTES <= UINT16_MAX, "black-box dump exceeds the 16-bit read offsets");
+_Static_assert(sizeof(blackbox_header_t) == 32 && sizeof(blackbox_snapshot_t) == 24, "dump layout changed");
+
+typedef enum {
+    BB_RECORDING = 0,
+    BB_POST_TRIGGER,  // Recording the samples after the trigger
+    BB_WRITING        // Frozen, one page per blackbox_process() call
+} bb_state_t;
+
+static bb_state_t state = BB_RECORDING;
+
+// Rings, indexed by sequence number
+static int16_t samples[BLACKBOX_SAMPLES][6];
+static uint32_t sample_seq = 0;
+static uint32_t valid_seq = 0;     // First sample in the rings since the last dump was written
+static uint32_t last_us = 0;
+static blackbox_snapshot_t snapshots[BLACKBOX_SNAPSHOTS];
+static uint32_t snapshot_seq = 0;
+static uint32_t last_snapshot_at = 0;
+static uint8_t pending_events = 0;
+
+// Trigger and the dump being written
+static uint16_t post_left = 0;
+static uint32_t trigger_seq = 0;
+static bool auto_triggered = false;
+static uint32_t last_auto_ms = 0;
+static blackbox_header_t header;
+static uint32_t first_snapshot;
+static uint32_t dump_bytes;
+static uint32_t write_offset;
+
+/**
+ * @brief Clears the rings and starts recording.
+ */
+void blackbox_init(void)
+{
+    state = BB_RECORDING;
+    sample_seq = 0;
+    valid_seq = 0;
+    snapshot_seq = 0;
+    last_snapshot_at = 0;
+    pending_events = 0;
+    auto_triggered = false;
+}
+
+/**
+ * @brief Freezes the rings: fills in the header of the dump. Samples from
+ *        before the previous dump's write are left out, as the write dropped
+ *        the ones in between.
+ */
+static void freeze(void)
+{
+    uint32_t kept = sample_seq - valid_seq;
+    uint16_t count = (kept < BLACKBOX_SAMPLES) ? (uint16_t)kept : BLACKBOX_SAMPLES;
+    uint32_t first_seq = sample_seq - count;
+    
+    // Snapshots taken within the samples kept
+    uint16_t snaps = 0;
+    while (snaps < BLACKBOX_SNAPSHOTS && snaps < snapshot_seq &&
+           snapshots[(snapshot_seq - snaps - 1U) & SNAPSHOT_MASK].seq >= first_seq)
+    {
+        snaps++;
+    }
+    
+    header.version = BLACKBOX_VERSION;
+    header.snapshot_every = BLACKBOX_SNAPSHOT_EVERY;
+    header.sample_hz = IMU_SAMPLE_HZ;
+    header.sample_count = count;
+    header.snapshot_count = snaps;
+    header.trigger_index = (uint16_t)(trigger_seq - first_seq);
+    header.first_seq = first_seq;
+    header.last_us = last_us;
+    header.uptime_ms = systick_get_uptime_ms();
+    header.reserved = 0xFFFFFFFFU;
+    
+    first_snapshot = snapshot_seq - snaps;
+    dump_bytes = sizeof(header) + (uint32_t)count * SAMPLE_BYTES + (uint32_t)snaps * sizeof(blackbox_snapshot_t);
+    write_offset = 0;
+    state = BB_WRITING;
+}
+
+/**
+ * @brief Appends one raw sample; while a dump is written it is only counted,
+ *        so sequence numbers keep following the sample clock.
+ */
+void blackbox_record(const MPU6050_RawData_t *raw)
+{
+    if (state == BB_WRITING)
+    {
+        last_us = raw->timestamp_us;
+        sample_seq++;
+        return;
+    }
+    
+    int16_t *s = samples[sample_seq & SAMPLE_MASK];
+    s[0] = raw->accel_x;
+    s[1] = raw->accel_y;
+    s[2] = raw->accel_z;
+    s[3] = raw->gyro_x;
+    s[4] = raw->gyro_y;
+    s[5] = raw->gyro_z;
+    last_us = raw->timestamp_us;
+    sample_seq++;
+    
+    if (state == BB_POST_TRIGGER && --post_left == 0)
+    {
+        freeze();
+    }
+}
+
+/**
+ * @brief Notes the detector state after a block of samples.
+ */
+void blackbox_snapshot(exercise_t ex, float rep_signal, uint16_t rep_count, uint8_t events)
+{
+    if (state == BB_WRITING || sample_seq == 0) return;
+    
+    pending_events |= events;
+    if (sample_seq - last_snapshot_at < BLACKBOX_SNAPSHOT_EVERY && (pending_events & BLACKBOX_EVENT_TRIGGER) == 0)
+    {
+        return;
+    }
+    
+    RepDetectState_t det;
+    rep_detect_get_state(ex, &det);
+    
+    blackbox_snapshot_t *snap = &snapshots[snapshot_seq & SNAPSHOT_MASK];
+    snap->seq = sample_seq - 1U;
+    snap->rep_signal = rep_signal;
+    snap->threshold = det.threshold;
+    snap->baseline_mu = REP_CTX[ex].baseline_mu;
+    snap->rolling_sigma = REP_CTX[ex].rolling_sigma;
+    snap->rep_count = rep_count;
+    snap->flags = (det.in_peak ? BLACKBOX_FLAG_IN_PEAK : 0U) | (det.early_counted ? BLACKBOX_FLAG_EARLY : 0U);
+    snap->events = pending_events;
+    
+    header.exercise = (uint8_t)ex;
+    snapshot_seq++;
+    last_snapshot_at = sample_seq;
+    pending_events = 0;
+}
+
+/**
+ * @brief Freezes the rings after BLACKBOX_POST_SAMPLES more samples.
+ */
+bool blackbox_trigger(blackbox_reason_t reason)
+{
+    if (state != BB_RECORDING) return false;
+    
+    if (reason == BLACKBOX_REASON_RETRACT)
+    {
+        if (auto_triggered && !systick_has_elapsed(last_auto_ms, BLACKBOX_AUTO_HOLDOFF_MS)) return false;
+        auto_triggered = true;
+        last_auto_ms = systick_get_uptime_ms();
+    }
+    
+    header.reason = (uint8_t)reason;
+    trigger_seq = sample_seq;
+    post_left = BLACKBOX_POST_SAMPLES;
+    pending_events |= BLACKBOX_EVENT_TRIGGER;
+    state = BB_POST_TRIGGER;
+    return true;
+}
+
+/**
+ * @brief Gets the longest contiguous run of dump bytes at offset in the rings.
+ * @param offset Dump offset past the header.
+ * @param data Set to the bytes.
+ * @retval uint32_t Run length (samples and snapshots are never split).
+ */
+static uint32_t image_span(uint32_t offset, const uint8_t **data)
+{
+    uint32_t sample_end = sizeof(header) + (uint32_t)header.sample_count * SAMPLE_BYTES;
+    
+    if (offset < sample_end)
+    {
+        uint32_t rel = offset - sizeof(header);
+        uint32_t index = (header.first_seq + rel / SAMPLE_BYTES) & SAMPLE_MASK;
+        uint32_t run = (BLACKBOX_SAMPLES - index) * SAMPLE_BYTES - rel % SAMPLE_BYTES;
+        *data = (const uint8_t *)samples[index] + rel % SAMPLE_BYTES;
+        return (run < sample_end - offset) ? run : sample_end - offset;
+    }
+    
+    uint32_t rel = offset - sample_end;
+    uint32_t index = (first_snapshot + rel / sizeof(blackbox_snapshot_t)) & SNAPSHOT_MASK;
+    uint32_t run = (BLACKBOX_SNAPSHOTS - index) * sizeof(blackbox_snapshot_t) - rel % sizeof(blackbox_snapshot_t);
+    *data = (const uint8_t *)&snapshots[index] + rel % sizeof(blackbox_snapshot_t);
+    return (run < dump_bytes - offset) ? run : dump_bytes - offset;
+}
+
+/**
+ * @brief Writes one page of a frozen dump; the header goes last, so an
+ *        interrupted dump reads as none.
+ */
+void blackbox_process(void)
+{
+    if (state != BB_WRITING) return;
+    
+    uint32_t page = DUMP_START + write_offset;
+    uint32_t end = write_offset + FLASH_PAGE_SIZE;
+    bool ok = (flash_store_erase_page(page) == HAL_OK);
+    
+    if (end > dump_bytes) end = dump_bytes;
+    if (write_offset == 0) write_offset = sizeof(header);
+    while (ok && write_offset < end)
+    {
+        const uint8_t *data;
+        uint32_t run = image_span(write_offset, &data);
+        if (run > end - write_offset) run = end - write_offset;
+        ok = (flash_store_program(DUMP_START + write_offset, data, (uint16_t)run) == HAL_OK);
+        write_offset += run;
+    }
+    
+    if (ok && write_offset < dump_bytes) return;
+    
+    if (ok)
+    {
+        header.magic = BLACKBOX_MAGIC;
+        flash_store_program(DUMP_START, &header, sizeof(header));
+    }
+    valid_seq = sample_seq;
+    state = BB_RECORDING;
+}
+
+/**
+ * @brief Gets the size of the stored dump.
+ */
+uint16_t blackbox_dump_size(void)
+{
+    const blackbox_header_t *h = (const blackbox_header_t *)(uintptr_t)DUMP_START;
+    
+    if (state == BB_WRITING || h->magic != BLACKBOX_MAGIC || h->version != BLACKBOX_VERSION ||
+        h->sample_count > BLACKBOX_SAMPLES || h->snapshot_count > BLACKBOX_SNAPSHOTS)
+    {
+        return 0;
+    }
+    return (uint16_t)(sizeof(*h) + h->sample_count * SAMPLE_BYTES + h->snapshot_count * sizeof(blackbox_snapshot_t));
+}
+
+/**
+ * @brief Copies bytes of the stored dump.
+ */
+uint16_t blackbox_read(uint16_t offset, uint8_t *buf, uint16_t len)
+{
+    uint16_t size = blackbox_dump_size();
+    
+    if (offset >= size) return 0;
+    if (len > size - offset) len = size - offset;
+    memcpy(buf, (const uint8_t *)(uintptr_t)(DUMP_START + offset), len);
+    return len;
+}
+
+#endif // ENABLE_BLACKBOX
@@ -0,0 +1,116 @@
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#include "mpu6050.h"
+#include "exercise_config.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Black-box recorder (ENABLE_BLACKBOX): the last BLACKBOX_SAMPLES raw samples
+// and periodic detector snapshots in RAM rings. A trigger records
+// BLACKBOX_POST_SAMPLES more, then freezes the rings and writes them to the
+// black-box pages (FLASH_STORE_BLACKBOX_ADDR), one page per main-loop pass;
+// recording resumes once the dump is complete. Samples arriving meanwhile are
+// counted but not kept, and the next dump starts after them, so a dump never
+// spans a gap. The latest dump is kept.
+// Dump layout: blackbox_header_t, sample_count x 6 int16 (raw accel XYZ,
+// gyro XYZ, oldest first), snapshot_count x blackbox_snapshot_t. The header
+// is programmed last. Read with tools/tune_params.py blackbox, decoded by
+// tools/blackbox_replay.py.
+#define BLACKBOX_MAGIC           0x58424242U  // "BBBX"
+#define BLACKBOX_VERSION         1
+#define BLACKBOX_SAMPLES         512    // Power of two: 2.56 s at 200 Hz, 6 KB
+#define BLACKBOX_SNAPSHOT_EVERY  16     // Samples between detector snapshots
+#define BLACKBOX_POST_SAMPLES    128    // Recorded after the trigger
+#define BLACKBOX_DOUBLE_PRESS_MS 500    // Second short press within this time triggers
+#define BLACKBOX_AUTO_HOLDOFF_MS 30000  // Automatic triggers at most this often
+
+#define BLACKBOX_SNAPSHOTS (BLACKBOX_SAMPLES / BLACKBOX_SNAPSHOT_EVERY)
+
+typedef enum {
+    BLACKBOX_REASON_BUTTON = 1,  // Double press
+    BLACKBOX_REASON_RETRACT,     // An early count was taken back (BLACKBOX_AUTO_TRIGGER)
+    BLACKBOX_REASON_HOST         // host_proto request
+} blackbox_reason_t;
+
+// Snapshot flags (detector state) and events (since the previous snapshot)
+#define BLACKBOX_FLAG_IN_PEAK  0x01U
+#define BLACKBOX_FLAG_EARLY    0x02U
+#define BLACKBOX_EVENT_REP     0x01U
+#define BLACKBOX_EVENT_RETRACT 0x02U
+#define BLACKBOX_EVENT_TRIGGER 0x04U
+
+typedef struct {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t reason;          // blackbox_reason_t
+    uint8_t exercise;        // exercise_t
+    uint8_t snapshot_every;
+    uint16_t sample_hz;
+    uint16_t sample_count;
+    uint16_t snapshot_count;
+    uint16_t trigger_index;  // Sample at which the trigger fired
+    uint32_t first_seq;      // Sequence number of the first sample
+    uint32_t last_us;        // Timestamp of the last sample
+    uint32_t uptime_ms;      // When the dump was frozen
+    uint32_t reserved;
+} blackbox_header_t;
+
+typedef struct {
+    uint32_t seq;            // Sequence number of the sample it was taken after
+    float rep_signal;
+    float threshold;
+    float baseline_mu;
+    float rolling_sigma;
+    uint16_t rep_count;
+    uint8_t flags;           // BLACKBOX_FLAG_*
+    uint8_t events;          // BLACKBOX_EVENT_*
+} blackbox_snapshot_t;
+
+/**
+ * @brief Clears the rings and starts recording.
+ */
+void blackbox_init(void);
+
+/**
+ * @brief Appends one raw sample (a 12-byte copy; only counted while frozen).
+ * @param raw Decimated raw frame, before scaling.
+ */
+void blackbox_record(const MPU6050_RawData_t *raw);
+
+/**
+ * @brief Notes the detector state after a block of samples; a snapshot is
+ *        taken every BLACKBOX_SNAPSHOT_EVERY samples, events are kept until then.
+ * @param ex Exercise being detected.
+ * @param rep_signal Rep signal of the latest sample.
+ * @param rep_count Current count.
+ * @param events BLACKBOX_EVENT_* seen in this block.
+ */
+void blackbox_snapshot(exercise_t ex, float rep_signal, uint16_t rep_count, uint8_t events);
+
+/**
+ * @brief Freezes the rings after BLACKBOX_POST_SAMPLES more samples. Ignored
+ *        while a dump is pending; automatic reasons respect BLACKBOX_AUTO_HOLDOFF_MS.
+ * @retval bool true if the trigger was taken.
+ */
+bool blackbox_trigger(blackbox_reason_t reason);
+
+/**
+ * @brief Writes one page of a frozen dump (~50 ms: erase + program). Call
+ *        from the main loop.
+ */
+void blackbox_process(void);
+
+/**
+ * @brief Gets the size of the stored dump.
+ * @retval uint16_t Bytes, 0 if there is no complete dump.
+ */
+uint16_t blackbox_dump_size(void);
+
+/**
+ * @brief Copies bytes of the stored dump.
+ * @retval uint16_t Bytes copied (fewer at the end of the dump).
+ */
+uint16_t blackbox_read(uint16_t offset, uint8_t *buf, uint16_t len);
+
+#endif // BLACKBOX_H
@@ -0,0 +1,46 @@
+#include "calib_store.h"
+#include "flash_store.h"
+#include <string.h>
+
+_Static_assert(sizeof(calib_store_t) <= FLASH_STORE_MAX_RECORD, "calibration record exceeds one flash page");
+
+/**
+ * @brief Layout version tied to the exercise list: ex[] and last_exercise
+ *        are indexed by enum position.
+ */
+static uint16_t store_version(void)
+{
+    return CALIB_STORE_VERSION ^ exercise_config_list_hash();
+}
+
+/**
+ * @brief Loads the calibration page.
+ */
+bool calib_store_load(calib_store_t *store)
+{
+    if (store == NULL) return false;
+    
+    if (!flash_store_load(FLASH_STORE_CALIB_ADDR, CALIB_STORE_MAGIC, store_version(),
+                          store, sizeof(calib_store_t)))
+    {
+        memset(store, 0, sizeof(calib_store_t));
+        return false;
+    }
+    
+    if (store->last_exercise >= EX_COUNT)
+    {
+        store->last_exercise = 0;
+    }
+    return true;
+}
+
+/**
+ * @brief Writes the record to the calibration page.
+ */
+HAL_StatusTypeDef calib_store_save(const calib_store_t *store)
+{
+    if (store == NULL) return HAL_ERROR;
+    
+    return flash_store_save(FLASH_STORE_CALIB_ADDR, CALIB_STORE_MAGIC, store_version(),
+                            store, sizeof(calib_store_t));
+}
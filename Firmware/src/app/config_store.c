@@ -0,0 +1,70 @@
+#include "config_store.h"
+#include "flash_store.h"
+
+// Parameters by id, so the record does not depend on the exercise_cfg_t layout
+typedef struct {
+    float params[EX_COUNT][EX_PARAM_COUNT];
+} config_store_t;
+
+_Static_assert(sizeof(config_store_t) <= FLASH_STORE_MAX_RECORD, "config record exceeds one flash page");
+
+/**
+ * @brief Layout version tied to the exercise list: params[] is indexed by
+ *        enum position.
+ */
+static uint16_t store_version(void)
+{
+    return CONFIG_STORE_VERSION ^ exercise_config_list_hash();
+}
+
+/**
+ * @brief Applies the committed parameters over the live table.
+ */
+bool config_store_load(void)
+{
+    config_store_t store;
+    
+    if (!flash_store_load(FLASH_STORE_CONFIG_ADDR, CONFIG_STORE_MAGIC, store_version(),
+                          &store, sizeof(store)))
+    {
+        return false;
+    }
+    
+    for (int ex = 0; ex < EX_COUNT; ex++)
+    {
+        // All or nothing per exercise
+        bool valid = true;
+        for (int id = 0; id < EX_PARAM_COUNT; id++)
+        {
+            valid = valid && exercise_param_check((exercise_param_t)id, store.params[ex][id]);
+        }
+        if (!valid)
+        {
+            continue;
+        }
+        for (int id = 0; id < EX_PARAM_COUNT; id++)
+        {
+            exercise_param_set((exercise_t)ex, (exercise_param_t)id, store.params[ex][id]);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Writes every exercise's live parameters to the config page.
+ */
+HAL_StatusTypeDef config_store_commit(void)
+{
+    config_store_t store;
+    
+    for (int ex = 0; ex < EX_COUNT; ex++)
+    {
+        for (int id = 0; id < EX_PARAM_COUNT; id++)
+        {
+            exercise_param_get((exercise_t)ex, (exercise_param_t)id, &store.params[ex][id]);
+        }
+    }
+    
+    return flash_store_save(FLASH_STORE_CONFIG_ADDR, CONFIG_STORE_MAGIC, store_version(),
+                            &store, sizeof(store));
+}
@@ -0,0 +1,612 @@
+#include "host_proto.h"
+#include "app_config.h"
+#include "app_controller.h"
+#include "exercise_config.h"
+#include "config_store.h"
+#include "uart_link.h"
+#include "latency_trace.h"
+#include "blackbox.h"
+#include "trace_store.h"
+#include "clock_ctrl.h"
+#include <string.h>
+
+#if ENABLE_HOST_PROTO
+
+// Receive state machine
+typedef enum {
+    RX_SYNC = 0,
+    RX_CMD,
+    RX_LEN,
+    RX_PAYLOAD,
+    RX_CRC_LO,
+    RX_CRC_HI
+} rx_state_t;
+
+static rx_state_t rx_state = RX_SYNC;
+static uint8_t rx_cmd;
+static uint8_t rx_len;
+static uint8_t rx_pos;
+static uint16_t rx_crc;
+static uint8_t rx_payload[HOST_PROTO_MAX_PAYLOAD];
+
+#if ENABLE_TRACE_STORE
+// Session download: chunks from stream_next up to stream_limit go out as the
+// transmit ring has room
+static const trace_session_t *stream_session = NULL;
+static uint32_t stream_seq;
+static uint32_t stream_size;
+static uint32_t stream_next;
+static uint32_t stream_limit;
+static uint32_t stream_window;
+#endif
+
+/**
+ * @brief Updates a CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) with one byte.
+ */
+static uint16_t crc16_update(uint16_t crc, uint8_t byte)
+{
+    crc ^= (uint16_t)byte << 8;
+    for (uint8_t bit = 0; bit < 8; bit++)
+    {
+        crc = (crc & 0x8000U) ? (uint16_t)((crc << 1) ^ 0x1021U) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+/**
+ * @brief Sends a reply frame: status followed by data.
+ */
+static void send_reply(uint8_t cmd, host_status_t status, const uint8_t *data, uint8_t len)
+{
+    uint8_t frame[HOST_PROTO_MAX_PAYLOAD + 6];
+    uint8_t n = 0;
+    
+    if (len > HOST_PROTO_MAX_PAYLOAD - 1) len = HOST_PROTO_MAX_PAYLOAD - 1;
+    
+    frame[n++] = HOST_PROTO_SYNC;
+    frame[n++] = cmd | HOST_PROTO_REPLY;
+    frame[n++] = len + 1;
+    frame[n++] = (uint8_t)status;
+    if (len > 0)
+    {
+        memcpy(&frame[n], data, len);
+        n += len;
+    }
+    
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 1; i < n; i++)
+    {
+        crc = crc16_update(crc, frame[i]);
+    }
+    frame[n++] = (uint8_t)(crc & 0xFF);
+    frame[n++] = (uint8_t)(crc >> 8);
+    
+    uart_link_write(frame, n);
+}
+
+/**
+ * @brief INFO: protocol version, table dimensions and the clock profile state.
+ */
+static void cmd_info(void)
+{
+    uint8_t info[14] = {HOST_PROTO_VERSION, EX_COUNT, EX_PARAM_COUNT,
+                        (uint8_t)clock_ctrl_get_profile(), clock_ctrl_get_load_pct(), clock_ctrl_get_wait_pct()};
+    uint32_t low_ms = clock_ctrl_get_residency_ms(CLOCK_PROFILE_LOW_POWER);
+    uint32_t full_ms = clock_ctrl_get_residency_ms(CLOCK_PROFILE_FULL_SPEED);
+    
+    memcpy(&info[6], &low_ms, sizeof(low_ms));
+    memcpy(&info[10], &full_ms, sizeof(full_ms));
+    send_reply(HOST_CMD_INFO, HOST_STATUS_OK, info, sizeof(info));
+}
+
+/**
+ * @brief GET_EXERCISE: every live parameter of one exercise, then its name.
+ */
+static void cmd_get_exercise(const uint8_t *payload, uint8_t len)
+{
+    uint8_t reply[HOST_PROTO_MAX_PAYLOAD - 1];
+    uint8_t n = 0;
+    
+    if (len != 1)
+    {
+        send_reply(HOST_CMD_GET_EXERCISE, HOST_STATUS_BAD_LENGTH, NULL, 0);
+        return;
+    }
+    exercise_t ex = (exercise_t)payload[0];
+    if (ex >= EX_COUNT)
+    {
+        send_reply(HOST_CMD_GET_EXERCISE, HOST_STATUS_BAD_ARG, NULL, 0);
+        return;
+    }
+    
+    reply[n++] = (uint8_t)ex;
+    for (int id = 0; id < EX_PARAM_COUNT; id++)
+    {
+        float value = 0.0f;
+        exercise_param_get(ex, (exercise_param_t)id, &value);
+        memcpy(&reply[n], &value, sizeof(value));
+        n += sizeof(value);
+    }
+    
+    const char *name = EX_NAMES[ex];
+    size_t name_len = strlen(name);
+    if (name_len > sizeof(reply) - n) name_len = sizeof(reply) - n;
+    memcpy(&reply[n], name, name_len);
+    n += (uint8_t)name_len;
+    
+    send_reply(HOST_CMD_GET_EXERCISE, HOST_STATUS_OK, reply, n);
+}
+
+/**
+ * @brief SET_PARAMS: checks every (id, value) pair first, then applies them
+ *        together, so the detector never runs with half a parameter set.
+ */
+static void cmd_set_params(const uint8_t *payload, uint8_t len)
+{
+    const uint8_t pair_bytes = 1 + sizeof(float);
+    
+    if (len < 1 || ((len - 1) % pair_bytes) != 0)
+    {
+        send_reply(HOST_CMD_SET_PARAMS, HOST_STATUS_BAD_LENGTH, NULL, 0);
+        return;
+    }
+    exercise_t ex = (exercise_t)payload[0];
+    uint8_t pairs = (len - 1) / pair_bytes;
+    if (ex >= EX_COUNT)
+    {
+        send_reply(HOST_CMD_SET_PARAMS, HOST_STATUS_BAD_ARG, NULL, 0);
+        return;
+    }
+    
+    for (uint8_t i = 0; i < pairs; i++)
+    {
+        const uint8_t *pair = &payload[1 + i * pair_bytes];
+        float value;
+        memcpy(&value, &pair[1], sizeof(value));
+        if (pair[0] >= EX_PARAM_COUNT)
+        {
+            send_reply(HOST_CMD_SET_PARAMS, HOST_STATUS_BAD_ARG, &i, 1);
+            return;
+        }
+        if (!exercise_param_check((exercise_param_t)pair[0], value))
+        {
+            send_reply(HOST_CMD_SET_PARAMS, HOST_STATUS_RANGE, &i, 1);
+            return;
+        }
+    }
+    
+    uint32_t changed = 0;
+    for (uint8_t i = 0; i < pairs; i++)
+    {
+        const uint8_t *pair = &payload[1 + i * pair_bytes];
+        float value;
+        memcpy(&value, &pair[1], sizeof(value));
+        exercise_param_set(ex, (exercise_param_t)pair[0], value);
+        changed |= EX_PARAM_MASK(pair[0]);
+    }
+    app_controller_apply_config(ex, changed);
+    
+    send_reply(HOST_CMD_SET_PARAMS, HOST_STATUS_OK, NULL, 0);
+}
+
+/**
+ * @brief COMMIT: stores the live parameters of every exercise in flash.
+ */
+static void cmd_commit(uint8_t len)
+{
+    if (len != 0)
+    {
+        send_reply(HOST_CMD_COMMIT, HOST_STATUS_BAD_LENGTH, NULL, 0);
+        return;
+    }
+    host_status_t status = (config_store_commit() == HAL_OK) ? HOST_STATUS_OK : HOST_STATUS_FLASH;
+    send_reply(HOST_CMD_COMMIT, status, NULL, 0);
+}
+
+/**
+ * @brief DEFAULTS: restores built-in parameters of one exercise, or all.
+ */
+static void cmd_defaults(const uint8_t *payload, uint8_t len)
+{
+    if (len != 1)
+    {
+        send_reply(HOST_CMD_DEFAULTS, HOST_STATUS_BAD_LENGTH, NULL, 0);
+        return;
+    }
+    if (payload[0] != 0xFF && payload[0] >= EX_COUNT)
+    {
+        send_reply(HOST_CMD_DEFAULTS, HOST_STATUS_BAD_ARG, NULL, 0);
+        return;
+    }
+    
+    for (int ex = 0; ex < EX_COUNT; ex++)
+    {
+        if (payload[0] == 0xFF || payload[0] == ex)
+        {
+            exercise_config_restore_defaults((exercise_t)ex);
+            app_controller_apply_config((exercise_t)ex, EX_PARAM_MASK(EX_PARAM_COUNT) - 1U);
+        }
+    }
+    send_reply(HOST_CMD_DEFAULTS, HOST_STATUS_OK, NULL, 0);
+}
+
+#if ENABLE_LATENCY_TRACE
+_Static_assert(1 + 4 * sizeof(uint32_t) + LATENCY_TRACE_BINS * sizeof(uint16_t) <= HOST_PROTO_MAX_PAYLOAD - 1,
+               "latency reply exceeds one frame");
+
+/**
+ * @brief LATENCY: histogram of one rep-to-pixel span, or clears them all.
+ */
+static void cmd_latency(const uint8_t *payload, uint8_t len)
+{
+    uint8_t reply[1 + 4 * sizeof(uint32_t) + LATENCY_TRACE_BINS * sizeof(uint16_t)];
+    uint8_t n = 0;
+    latency_hist_t hist;
+    
+    if (len != 1)
+    {
+        send_reply(HOST_CMD_LATENCY, HOST_STATUS_BAD_LENGTH, NULL, 0);
+        return;
+    }
+    if (payload[0] == 0xFF)
+    {
+        latency_trace_reset();
+        send_reply(HOST_CMD_LATENCY, HOST_STATUS_OK, NULL, 0);
+        return;
+    }
+    if (payload[0] >= LAT_SPAN_COUNT)
+    {
+        send_reply(HOST_CMD_LATENCY, HOST_STATUS_BAD_ARG, NULL, 0);
+        return;
+    }
+    
+    latency_trace_get((latency_span_t)payload[0], &hist);
+    reply[n++] = payload[0];
+    memcpy(&reply[n], &hist.count, sizeof(hist.count));
+    n += sizeof(hist.count);
+    memcpy(&reply[n], &hist.min_us, sizeof(hist.min_us));
+    n += sizeof(hist.min_us);
+    memcpy(&reply[n], &hist.max_us, sizeof(hist.max_us));
+    n += sizeof(hist.max_us);
+    memcpy(&reply[n], &hist.mean_us, sizeof(hist.mean_us));
+    n += sizeof(hist.mean_us);
+    memcpy(&reply[n], hist.bins, sizeof(hist.bins));
+    n += sizeof(hist.bins);
+    
+    send_reply(HOST_CMD_LATENCY, HOST_STATUS_OK, reply, n);
+}
+#endif
+
+#if ENABLE_BLACKBOX
+_Static_assert(4 + HOST_PROTO_BLACKBOX_CHUNK <= HOST_PROTO_MAX_PAYLOAD - 1, "black-box chunk exceeds one frame");
+
+/**
+ * @brief BLACKBOX: reads a chunk of the stored dump (size 0: none), or
+ *        triggers the recorder.
+ */
+static void cmd_blackbox(const uint8_t *payload, uint8_t len)
+{
+    uint8_t reply[4 + HOST_PROTO_BLACKBOX_CHUNK];
+    
+    if (len == 1 && payload[0] == 1)
+    {
+        reply[0] = blackbox_trigger(BLACKBOX_REASON_HOST) ? 1 : 0;
+        send_reply(HOST_CMD_BLACKBOX, HOST_STATUS_OK, reply, 1);
+        return;
+    }
+    if (len != 3 || payload[0] != 0)
+    {
+        send_reply(HOST_CMD_BLACKBOX, (len == 0) ? HOST_STATUS_BAD_LENGTH : HOST_STATUS_BAD_ARG, NULL, 0);
+        return;
+    }
+    
+    uint16_t offset = (uint16_t)(payload[1] | (payload[2] << 8));
+    uint16_t size = blackbox_dump_size();
+    memcpy(&reply[0], &offset, sizeof(offset));
+    memcpy(&reply[2], &size, sizeof(size));
+    uint16_t n = blackbox_read(offset, &reply[4], HOST_PROTO_BLACKBOX_CHUNK);
+    
+    send_reply(HOST_CMD_BLACKBOX, HOST_STATUS_OK, reply, (uint8_t)(4 + n));
+}
+#endif
+
+#if ENABLE_TRACE_STORE
+_Static_assert(4 + HOST_PROTO_CHUNK <= HOST_PROTO_MAX_PAYLOAD - 1, "session chunk exceeds one frame");
+_Static_assert(2 + HOST_PROTO_SESSIONS_PER_REPLY * 14 <= HOST_PROTO_MAX_PAYLOAD - 1, "session list exceeds one frame");
+
+/**
+ * @brief Gets the bytes a session is downloaded as (header and records).
+ * @retval uint32_t 0 while the session is being recorded.
+ */
+static uint32_t session_size(const trace_session_t *s)
+{
+    return (s->data_bytes == 0xFFFFFFFFU) ? 0 : sizeof(*s) + s->data_bytes;
+}
+
+/**
+ * @brief SESSIONS: lists stored sessions from one position on.
+ */
+static void cmd_sessions(const uint8_t *payload, uint8_t len)
+{
+    uint8_t reply[3 + HOST_PROTO_SESSIONS_PER_REPLY * 14];
+    uint8_t n = 3;
+    uint16_t first;
+    uint16_t total = 0;
+    
+    if (len != 2)
+    {
+        send_reply(HOST_CMD_SESSIONS, HOST_STATUS_BAD_LENGTH, NULL, 0);
+        return;
+    }
+    memcpy(&first, payload, sizeof(first));
+    
+    const trace_session_t *s;
+    while ((s = trace_store_get_session(total)) != NULL)
+    {
+        if (total >= first && total - first < HOST_PROTO_SESSIONS_PER_REPLY)
+        {
+            uint32_t size = session_size(s);
+            uint32_t samples = (size > 0) ? s->sample_count : 0;
+            memcpy(&reply[n], &s->seq, sizeof(s->seq));
+            memcpy(&reply[n + 4], &size, sizeof(size));
+            memcpy(&reply[n + 8], &samples, sizeof(samples));
+            reply[n + 12] = s->exercise;
+            reply[n + 13] = (s->flags == TRACE_FLAGS_SYNCED) ? 1 : 0;
+            n += 14;
+        }
+        total++;
+    }
+    memcpy(&reply[0], &total, sizeof(total));
+    reply[2] = trace_store_is_full() ? 1 : 0;
+    send_reply(HOST_CMD_SESSIONS, HOST_STATUS_OK, reply, n);
+}
+
+/**
+ * @brief SESSION_READ: (re)starts streaming a closed session at an offset.
+ */
+static void cmd_session_read(const uint8_t *payload, uint8_t len)
+{
+    uint32_t seq;
+    uint32_t offset;
+    
+    if (len != 9)
+    {
+        send_reply(HOST_CMD_SESSION_READ, HOST_STATUS_BAD_LENGTH, NULL, 0);
+        return;
+    }
+    memcpy(&seq, &payload[0], sizeof(seq));
+    memcpy(&offset, &payload[4], sizeof(offset));
+    
+    stream_session = NULL;
+    const trace_session_t *s = trace_store_find(seq);
+    if (s == NULL || session_size(s) == 0 || !trace_store_is_readable(s, 0, session_size(s)))
+    {
+        send_reply(HOST_CMD_SESSION_READ, HOST_STATUS_BAD_ARG, NULL, 0);
+        return;
+    }
+    if (offset > session_size(s))
+    {
+        send_reply(HOST_CMD_SESSION_READ, HOST_STATUS_RANGE, NULL, 0);
+        return;
+    }
+    
+    uint8_t reply[8];
+    stream_seq = seq;
+    stream_size = session_size(s);
+    stream_next = offset;
+    stream_window = (uint32_t)payload[8] * HOST_PROTO_CHUNK;
+    stream_limit = offset + stream_window;
+    memcpy(&reply[0], &stream_seq, sizeof(stream_seq));
+    memcpy(&reply[4], &stream_size, sizeof(stream_size));
+    send_reply(HOST_CMD_SESSION_READ, HOST_STATUS_OK, reply, sizeof(reply));
+    if (payload[8] > 0) stream_session = s;
+}
+
+/**
+ * @brief SESSION_ACK: slides the window of the session being streamed.
+ */
+static void cmd_session_ack(const uint8_t *payload, uint8_t len)
+{
+    uint32_t offset;
+    
+    if (len != 4 || stream_session == NULL) return;
+    memcpy(&offset, payload, sizeof(offset));
+    if (offset <= stream_size && offset + stream_window > stream_limit)
+    {
+        stream_limit = offset + stream_window;
+    }
+}
+
+/**
+ * @brief SESSION_SYNCED: marks a downloaded session.
+ */
+static void cmd_session_synced(const uint8_t *payload, uint8_t len)
+{
+    uint32_t seq;
+    
+    if (len != 4)
+    {
+        send_reply(HOST_CMD_SESSION_SYNCED, HOST_STATUS_BAD_LENGTH, NULL, 0);
+        return;
+    }
+    memcpy(&seq, payload, sizeof(seq));
+    if (trace_store_find(seq) == NULL)
+    {
+        send_reply(HOST_CMD_SESSION_SYNCED, HOST_STATUS_BAD_ARG, NULL, 0);
+        return;
+    }
+    host_status_t status = trace_store_mark_synced(seq) ? HOST_STATUS_OK : HOST_STATUS_FLASH;
+    send_reply(HOST_CMD_SESSION_SYNCED, status, NULL, 0);
+}
+
+/**
+ * @brief Sends the chunks of the streamed session that are within the
+ *        window and fit in the transmit ring.
+ */
+static void stream_chunks(void)
+{
+    uint8_t chunk[4 + HOST_PROTO_CHUNK];
+    
+    while (stream_session != NULL && stream_next < stream_size && stream_next < stream_limit &&
+           uart_link_tx_free() >= sizeof(chunk) + 6)
+    {
+        uint32_t n = stream_size - stream_next;
+        if (n > HOST_PROTO_CHUNK) n = HOST_PROTO_CHUNK;
+        
+        // A wrapped log may have erased or overwritten the session since
+        if (stream_session->magic != TRACE_STORE_MAGIC || stream_session->seq != stream_seq ||
+            !trace_store_is_readable(stream_session, stream_next, n))
+        {
+            stream_session = NULL;
+            send_reply(HOST_CMD_SESSION_DATA, HOST_STATUS_BAD_ARG, NULL, 0);
+            return;
+        }
+        
+        memcpy(&chunk[0], &stream_next, sizeof(stream_next));
+        memcpy(&chunk[4], (const uint8_t *)stream_session + stream_next, n);
+        send_reply(HOST_CMD_SESSION_DATA, HOST_STATUS_OK, chunk, (uint8_t)(4 + n));
+        stream_next += n;
+    }
+}
+#endif
+
+/**
+ * @brief Executes a received frame.
+ */
+static void dispatch(uint8_t cmd, const uint8_t *payload, uint8_t len)
+{
+    switch (cmd)
+    {
+        case HOST_CMD_INFO:
+            cmd_info();
+            break;
+        
+        case HOST_CMD_GET_EXERCISE:
+            cmd_get_exercise(payload, len);
+            break;
+        
+        case HOST_CMD_SET_PARAMS:
+            cmd_set_params(payload, len);
+            break;
+        
+        case HOST_CMD_COMMIT:
+            cmd_commit(len);
+            break;
+        
+        case HOST_CMD_DEFAULTS:
+            cmd_defaults(payload, len);
+            break;
+
+#if ENABLE_LATENCY_TRACE
+        case HOST_CMD_LATENCY:
+            cmd_latency(payload, len);
+            break;
+#endif
+
+#if ENABLE_BLACKBOX
+        case HOST_CMD_BLACKBOX:
+            cmd_blackbox(payload, len);
+            break;
+#endif
+
+#if ENABLE_TRACE_STORE
+        case HOST_CMD_SESSIONS:
+            cmd_sessions(payload, len);
+            break;
+        
+        case HOST_CMD_SESSION_READ:
+            cmd_session_read(payload, len);
+            break;
+        
+        case HOST_CMD_SESSION_ACK:
+            cmd_session_ack(payload, len);
+            break;
+        
+        case HOST_CMD_SESSION_SYNCED:
+            cmd_session_synced(payload, len);
+            break;
+#endif
+        
+        default:
+            send_reply(cmd, HOST_STATUS_BAD_CMD, NULL, 0);
+            break;
+    }
+}
+
+/**
+ * @brief Feeds one received byte to the frame parser.
+ */
+static void rx_byte(uint8_t byte)
+{
+    switch (rx_state)
+    {
+        case RX_SYNC:
+            if (byte == HOST_PROTO_SYNC) rx_state = RX_CMD;
+            break;
+        
+        case RX_CMD:
+            rx_cmd = byte;
+            rx_crc = crc16_update(0xFFFF, byte);
+            rx_state = RX_LEN;
+            break;
+        
+        case RX_LEN:
+            rx_len = byte;
+            rx_pos = 0;
+            rx_crc = crc16_update(rx_crc, byte);
+            if (rx_len > HOST_PROTO_MAX_PAYLOAD) rx_state = RX_SYNC;
+            else rx_state = (rx_len > 0) ? RX_PAYLOAD : RX_CRC_LO;
+            break;
+        
+        case RX_PAYLOAD:
+            rx_payload[rx_pos++] = byte;
+            rx_crc = crc16_update(rx_crc, byte);
+            if (rx_pos >= rx_len) rx_state = RX_CRC_LO;
+            break;
+        
+        case RX_CRC_LO:
+            rx_state = (byte == (rx_crc & 0xFF)) ? RX_CRC_HI : RX_SYNC;
+            break;
+        
+        case RX_CRC_HI:
+            // Corrupted frames are dropped silently; the host retries on timeout
+            if (byte == (rx_crc >> 8)) dispatch(rx_cmd, rx_payload, rx_len);
+            rx_state = RX_SYNC;
+            break;
+        
+        default:
+            rx_state = RX_SYNC;
+            break;
+    }
+}
+
+/**
+ * @brief Drops any partially received frame.
+ */
+void host_proto_reset(void)
+{
+    rx_state = RX_SYNC;
+}
+
+/**
+ * @brief Parses received bytes, executes complete commands and streams the
+ *        session being downloaded.
+ */
+void host_proto_process(void)
+{
+    uint8_t buf[32];
+    uint16_t n;
+    
+    while ((n = uart_link_read(buf, sizeof(buf))) > 0)
+    {
+        for (uint16_t i = 0; i < n; i++)
+        {
+            rx_byte(buf[i]);
+        }
+    }
+#if ENABLE_TRACE_STORE
+    stream_chunks();
+#endif
+}
+
+#endif // ENABLE_HOST_PROTO
@@ -0,0 +1,65 @@
+#ifndef HOST_PROTO_H
+#define HOST_PROTO_H
+
+#include <stdint.h>
+
+// Frame: SYNC, cmd, len, payload[len], CRC-16/CCITT (LE) over cmd, len and payload.
+// Replies echo cmd | HOST_PROTO_REPLY with the status as the first payload byte.
+// Multi-byte values are little-endian, parameters travel as float32.
+//
+// Session download (trace_store.h): SESSION_READ starts streaming a session
+// (header and records, as stored) at any offset. SESSION_DATA frames follow
+// unsolicited, one HOST_PROTO_CHUNK each, while they stay within the window:
+// window chunks past the last offset acknowledged with SESSION_ACK. The host
+// resumes after a lost or corrupted chunk, or a broken link, by sending
+// SESSION_READ again from the first byte it is missing. Once the log has no
+// room left, nothing is recorded until every session is marked with
+// SESSION_SYNCED (the full flag of SESSIONS).
+#define HOST_PROTO_SYNC        0xA5
+#define HOST_PROTO_REPLY       0x80
+#define HOST_PROTO_VERSION     1
+#define HOST_PROTO_MAX_PAYLOAD 96
+#define HOST_PROTO_BLACKBOX_CHUNK 64  // Dump bytes per BLACKBOX read
+#define HOST_PROTO_CHUNK       88     // Session bytes per SESSION_DATA frame
+#define HOST_PROTO_SESSIONS_PER_REPLY 6
+
+typedef enum {
+    HOST_CMD_INFO         = 0x01,  // -> version, EX_COUNT, EX_PARAM_COUNT, clock profile, CPU load %,
+                                   //    wait %, ms at 8 MHz, ms at 72 MHz (u32, since the set started)
+    HOST_CMD_GET_EXERCISE = 0x02,  // ex -> ex, EX_PARAM_COUNT x float, name
+    HOST_CMD_SET_PARAMS   = 0x03,  // ex, {id, float} x n -> all applied or none
+    HOST_CMD_COMMIT       = 0x04,  // Live parameters -> config flash page
+    HOST_CMD_DEFAULTS     = 0x05,  // ex (0xFF: all) -> built-in defaults (RAM only)
+    HOST_CMD_LATENCY      = 0x06,  // span -> span, count, min, max, mean (us), bins x u16; 0xFF clears
+    HOST_CMD_BLACKBOX     = 0x07,  // 0, offset u16 -> offset, size u16, dump bytes; 1 -> triggered u8
+    HOST_CMD_SESSIONS     = 0x08,  // first u16 -> total u16, full u8, {seq, size, samples u32, exercise, synced} x n
+                                   //    (size 0: recording; full: no new session until these are synced)
+    HOST_CMD_SESSION_READ = 0x09,  // seq u32, offset u32, window u8 (0: stop) -> seq, size u32
+    HOST_CMD_SESSION_DATA = 0x0A,  // Device to host only: offset u32, chunk bytes
+    HOST_CMD_SESSION_ACK  = 0x0B,  // offset u32: everything before it arrived (no reply)
+    HOST_CMD_SESSION_SYNCED = 0x0C // seq u32 -> session marked as downloaded
+} host_cmd_t;
+
+typedef enum {
+    HOST_STATUS_OK = 0,
+    HOST_STATUS_BAD_CMD,
+    HOST_STATUS_BAD_LENGTH,
+    HOST_STATUS_BAD_ARG,     // Unknown exercise or parameter id
+    HOST_STATUS_RANGE,       // Value outside the parameter's range (index of the pair follows)
+    HOST_STATUS_FLASH
+} host_status_t;
+
+/**
+ * @brief Drops any partially received frame.
+ */
+void host_proto_reset(void);
+
+/**
+ * @brief Parses the bytes received since the last call and executes complete
+ *        commands, then queues the session chunks the window allows. Call
+ *        from the main loop, between pipeline passes, so a parameter set is
+ *        applied atomically with respect to the detector.
+ */
+void host_proto_process(void);
+
+#endif // HOST_PROTO_H
@@ -0,0 +1,166 @@
+#include "latency_trace.h"
+#include "app_config.h"
+#include <string.h>
+
+#if ENABLE_LATENCY_TRACE
+
+// Histogram with exact count, extremes and sum
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint16_t bins[LATENCY_TRACE_BINS];
+} span_stats_t;
+
+// One rep between its confirmation and the flush that shows it
+typedef struct {
+    uint32_t peak_us;
+    uint32_t confirm_us;
+    uint32_t enqueue_us;
+    uint8_t enqueued;
+} pending_rep_t;
+
+static span_stats_t spans[LAT_SPAN_COUNT];
+static pending_rep_t pending[LATENCY_TRACE_PENDING];
+static uint8_t pending_count = 0;
+
+/**
+ * @brief Maps a latency to its bin: < 2 ms, then two bins per octave of
+ *        milliseconds ([2^j, 1.5 * 2^j) and [1.5 * 2^j, 2^(j+1))).
+ */
+static uint8_t bin_of(uint32_t us)
+{
+    uint32_t ms = us / 1000U;
+    if (ms < 2U)
+    {
+        return 0;
+    }
+    
+    uint8_t j = 31U - (uint8_t)__builtin_clz(ms);
+    uint8_t half = (ms >> (j - 1U)) & 1U;
+    uint8_t bin = 2U * j - 1U + half;
+    return bin < LATENCY_TRACE_BINS ? bin : LATENCY_TRACE_BINS - 1U;
+}
+
+/**
+ * @brief Adds one latency to a span.
+ */
+static void record(latency_span_t span, uint32_t us)
+{
+    span_stats_t *s = &spans[span];
+    
+    if (s->count == 0 || us < s->min_us) s->min_us = us;
+    if (us > s->max_us) s->max_us = us;
+    s->count++;
+    s->sum_us += us;
+    
+    uint8_t bin = bin_of(us);
+    if (s->bins[bin] < UINT16_MAX) s->bins[bin]++;
+}
+
+/**
+ * @brief Clears every histogram and drops the reps in flight.
+ */
+void latency_trace_reset(void)
+{
+    memset(spans, 0, sizeof(spans));
+    pending_count = 0;
+}
+
+/**
+ * @brief Drops the reps in flight; histograms are kept.
+ */
+void latency_trace_cancel(void)
+{
+    pending_count = 0;
+}
+
+/**
+ * @brief Peak and confirm trace points of one accepted rep.
+ *        When the display falls more than LATENCY_TRACE_PENDING reps behind,
+ *        the oldest is dropped.
+ */
+void latency_trace_confirm(uint32_t peak_us, uint32_t confirm_us)
+{
+    if (pending_count == LATENCY_TRACE_PENDING)
+    {
+        memmove(&pending[0], &pending[1], (LATENCY_TRACE_PENDING - 1) * sizeof(pending[0]));
+        pending_count--;
+    }
+    
+    pending_rep_t *rep = &pending[pending_count++];
+    rep->peak_us = peak_us;
+    rep->confirm_us = confirm_us;
+    rep->enqueued = 0;
+    record(LAT_SPAN_PEAK_TO_CONFIRM, confirm_us - peak_us);
+}
+
+/**
+ * @brief Drops the latest confirmed rep if it has not been shown yet.
+ *        Reps are flushed in confirmation order, so a pending taken-back rep
+ *        is always the last one.
+ */
+void latency_trace_retract(void)
+{
+    if (pending_count > 0)
+    {
+        pending_count--;
+    }
+}
+
+/**
+ * @brief Enqueue trace point: the reps confirmed so far go to the display.
+ */
+void latency_trace_enqueue(uint32_t now_us)
+{
+    for (uint8_t i = 0; i < pending_count; i++)
+    {
+        if (!pending[i].enqueued)
+        {
+            pending[i].enqueue_us = now_us;
+            pending[i].enqueued = 1;
+            record(LAT_SPAN_CONFIRM_TO_ENQUEUE, now_us - pending[i].confirm_us);
+        }
+    }
+}
+
+/**
+ * @brief Flush trace point: closes the enqueued reps and records their spans.
+ *        Reps confirmed after the enqueue wait for the next flush.
+ */
+void latency_trace_flush(uint32_t now_us)
+{
+    uint8_t kept = 0;
+    
+    for (uint8_t i = 0; i < pending_count; i++)
+    {
+        if (pending[i].enqueued)
+        {
+            record(LAT_SPAN_ENQUEUE_TO_FLUSH, now_us - pending[i].enqueue_us);
+            record(LAT_SPAN_PEAK_TO_FLUSH, now_us - pending[i].peak_us);
+        }
+        else
+        {
+            pending[kept++] = pending[i];
+        }
+    }
+    pending_count = kept;
+}
+
+/**
+ * @brief Copies the histogram of one span.
+ */
+void latency_trace_get(latency_span_t span, latency_hist_t *hist)
+{
+    if (span >= LAT_SPAN_COUNT || hist == NULL) return;
+    
+    const span_stats_t *s = &spans[span];
+    hist->count = s->count;
+    hist->min_us = s->min_us;
+    hist->max_us = s->max_us;
+    hist->mean_us = s->count ? (uint32_t)(s->sum_us / s->count) : 0;
+    memcpy(hist->bins, s->bins, sizeof(hist->bins));
+}
+
+#endif // ENABLE_LATENCY_TRACE
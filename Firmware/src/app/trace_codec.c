@@ -0,0 +1,204 @@
+#include "trace_codec.h"
+#include "stm32f1xx_hal.h"
+#include <string.h>
+
+#define MODE_DELTA    0U
+#define MODE_LINEAR   1U
+#define MODE_VERBATIM 2U
+#define RICE_K_MAX    15U
+
+// MSB-first bit writer
+typedef struct {
+    uint8_t *out;
+    uint16_t pos;
+    uint32_t acc;
+    uint8_t bits;
+} bit_writer_t;
+
+static uint32_t cycles_max = 0;
+
+/**
+ * @brief Appends the low count bits of value (count <= 24).
+ */
+static void put_bits(bit_writer_t *w, uint32_t value, uint8_t count)
+{
+    w->acc = (w->acc << count) | (value & ((1UL << count) - 1U));
+    w->bits += count;
+    while (w->bits >= 8U)
+    {
+        w->bits -= 8U;
+        w->out[w->pos++] = (uint8_t)(w->acc >> w->bits);
+    }
+}
+
+/**
+ * @brief Appends count one bits.
+ */
+static void put_ones(bit_writer_t *w, uint8_t count)
+{
+    while (count > 16U)
+    {
+        put_bits(w, 0xFFFFU, 16U);
+        count -= 16U;
+    }
+    put_bits(w, 0xFFFFU, count);
+}
+
+/**
+ * @brief Maps a signed residual to an unsigned code (0, -1, 1, -2, ...).
+ */
+static uint32_t zigzag(int32_t r)
+{
+    return r >= 0 ? (uint32_t)r << 1 : ((uint32_t)(-r) << 1) - 1U;
+}
+
+/**
+ * @brief Computes the zigzagged residuals of one channel for a predictor.
+ * @retval uint32_t Sum of the codes.
+ */
+static uint32_t residuals(const int16_t samples[][TRACE_CODEC_CHANNELS], uint8_t n, uint8_t ch,
+                          const int16_t prev[2], uint8_t mode, uint32_t *u)
+{
+    int32_t a = prev[0];
+    int32_t b = prev[1];
+    uint32_t sum = 0;
+    
+    for (uint8_t i = 0; i < n; i++)
+    {
+        int32_t x = samples[i][ch];
+        int32_t pred = (mode == MODE_DELTA) ? a : 2 * a - b;
+        u[i] = zigzag(x - pred);
+        sum += u[i];
+        b = a;
+        a = x;
+    }
+    return sum;
+}
+
+/**
+ * @brief Exact Rice bit count of n codes with parameter k.
+ */
+static uint32_t rice_bits(const uint32_t *u, uint8_t n, uint8_t k)
+{
+    uint32_t bits = 0;
+    for (uint8_t i = 0; i < n; i++)
+    {
+        uint32_t q = u[i] >> k;
+        bits += (q < TRACE_CODEC_RICE_ESCAPE) ? q + 1U + k : TRACE_CODEC_RICE_ESCAPE + TRACE_CODEC_ESCAPE_BITS;
+    }
+    return bits;
+}
+
+/**
+ * @brief Picks the Rice parameter: the exact cost is compared around
+ *        log2 of the mean code, where the optimum lies.
+ * @retval uint32_t Bit count with the chosen parameter.
+ */
+static uint32_t choose_k(const uint32_t *u, uint8_t n, uint32_t sum, uint8_t *k_out)
+{
+    uint32_t mean = sum / n;
+    uint8_t k0 = mean ? (uint8_t)(31U - __builtin_clz(mean)) : 0U;
+    uint8_t k_lo = k0 > 0U ? k0 - 1U : 0U;
+    uint8_t k_hi = k0 < RICE_K_MAX ? k0 + 1U : RICE_K_MAX;
+    uint32_t best = UINT32_MAX;
+    
+    for (uint8_t k = k_lo; k <= k_hi; k++)
+    {
+        uint32_t bits = rice_bits(u, n, k);
+        if (bits < best)
+        {
+            best = bits;
+            *k_out = k;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Starts a new stream.
+ */
+void trace_codec_reset(trace_codec_state_t *state)
+{
+    memset(state, 0, sizeof(*state));
+}
+
+/**
+ * @brief Encodes one block and advances the stream history.
+ */
+uint16_t trace_codec_encode(trace_codec_state_t *state, const int16_t samples[][TRACE_CODEC_CHANNELS],
+                            uint8_t n, uint8_t *out)
+{
+    uint32_t t0 = DWT->CYCCNT;
+    bit_writer_t w = {out, 0, 0, 0};
+    uint32_t u[2][TRACE_CODEC_BLOCK];
+    
+    if (n == 0 || n > TRACE_CODEC_BLOCK) return 0;
+    
+    for (uint8_t ch = 0; ch < TRACE_CODEC_CHANNELS; ch++)
+    {
+        int16_t *prev = state->prev[ch];
+        
+        // Cheaper predictor; verbatim bounds the block at the raw size
+        uint8_t k[2] = {0, 0};
+        uint32_t bits[2];
+        for (uint8_t mode = MODE_DELTA; mode <= MODE_LINEAR; mode++)
+        {
+            uint32_t sum = residuals(samples, n, ch, prev, mode, u[mode]);
+            bits[mode] = 4U + choose_k(u[mode], n, sum, &k[mode]);
+        }
+        uint8_t mode = bits[MODE_LINEAR] < bits[MODE_DELTA] ? MODE_LINEAR : MODE_DELTA;
+        if (bits[mode] >= 16U * n)
+        {
+            mode = MODE_VERBATIM;
+        }
+        
+        put_bits(&w, mode, 2);
+        if (mode == MODE_VERBATIM)
+        {
+            for (uint8_t i = 0; i < n; i++)
+            {
+                put_bits(&w, (uint16_t)samples[i][ch], 16);
+            }
+        }
+        else
+        {
+            put_bits(&w, k[mode], 4);
+            for (uint8_t i = 0; i < n; i++)
+            {
+                uint32_t q = u[mode][i] >> k[mode];
+                if (q < TRACE_CODEC_RICE_ESCAPE)
+                {
+                    put_ones(&w, (uint8_t)q);
+                    put_bits(&w, 0, 1);
+                    put_bits(&w, u[mode][i], k[mode]);
+                }
+                else
+                {
+                    put_ones(&w, TRACE_CODEC_RICE_ESCAPE);
+                    put_bits(&w, u[mode][i], TRACE_CODEC_ESCAPE_BITS);
+                }
+            }
+        }
+        
+        prev[1] = (n > 1) ? samples[n - 2][ch] : prev[0];
+        prev[0] = samples[n - 1][ch];
+    }
+    
+    // Pad the last byte
+    if (w.bits > 0)
+    {
+        put_bits(&w, 0, 8U - w.bits);
+    }
+    
+    uint32_t cycles = DWT->CYCCNT - t0;
+    if (cycles > cycles_max) cycles_max = cycles;
+    return w.pos;
+}
+
+/**
+ * @brief Worst-case cycles spent encoding one block (DWT measured).
+ */
+uint32_t trace_codec_get_cycles_max(void)
+{
+    return cycles_max;
+}
@@ -0,0 +1,51 @@
+#ifndef TRACE_CODEC_H
+#define TRACE_CODEC_H
+
+#include <stdint.h>
+
+// Lossless streaming codec for raw six-axis IMU samples (trace_store.h).
+// Each channel of a block picks the cheaper of two predictors from the
+// previous samples of the stream and Rice-codes the zigzagged residuals with
+// a per-block parameter. Block bitstream, MSB first, per channel:
+//   mode:2  0 = delta (x[n-1]), 1 = linear (2 x[n-1] - x[n-2]), 2 = verbatim
+//   k:4     Rice parameter (modes 0 and 1 only)
+//   n codes Rice: q = u >> k as q ones and a zero, then the low k bits of u;
+//           q >= TRACE_CODEC_RICE_ESCAPE: that many ones, then u in 18 bits.
+//           Verbatim: the 16-bit samples.
+// The block ends on a byte boundary (zero padding). tools/trace_decode.py
+// mirrors this layout.
+#define TRACE_CODEC_CHANNELS     6   // Accel XYZ, gyro XYZ
+#define TRACE_CODEC_BLOCK        32  // Samples per block (160 ms at 200 Hz)
+#define TRACE_CODEC_RICE_ESCAPE  20  // Quotients from here on are sent as escapes
+#define TRACE_CODEC_ESCAPE_BITS  18  // Zigzagged linear residuals of int16 fit in 18 bits
+
+// Worst case: every channel verbatim
+#define TRACE_CODEC_MAX_BLOCK_BYTES ((TRACE_CODEC_CHANNELS * (2 + 16 * TRACE_CODEC_BLOCK) + 7) / 8)
+
+// Predictor history of one stream
+typedef struct {
+    int16_t prev[TRACE_CODEC_CHANNELS][2];  // x[n-1], x[n-2]
+} trace_codec_state_t;
+
+/**
+ * @brief Starts a new stream (history cleared to zero).
+ */
+void trace_codec_reset(trace_codec_state_t *state);
+
+/**
+ * @brief Encodes one block and advances the stream history.
+ * @param state Stream history.
+ * @param samples n samples, channels in TRACE_CODEC_CHANNELS order.
+ * @param n Sample count (1..TRACE_CODEC_BLOCK).
+ * @param out At least TRACE_CODEC_MAX_BLOCK_BYTES.
+ * @retval uint16_t Encoded bytes.
+ */
+uint16_t trace_codec_encode(trace_codec_state_t *state, const int16_t samples[][TRACE_CODEC_CHANNELS],
+                            uint8_t n, uint8_t *out);
+
+/**
+ * @brief Worst-case cycles spent encoding one block (DWT measured).
+ */
+uint32_t trace_codec_get_cycles_max(void);
+
+#endif // TRACE_CODEC_H
@@ -0,0 +1,382 @@
+#include "trace_store.h"
+#include "flash_store.h"
+#include "app_config.h"
+#include <stddef.h>
+#include <string.h>
+
+#if ENABLE_TRACE_STORE
+
+#define TRACE_START FLASH_STORE_TRACE_ADDR
+#define TRACE_END   FLASH_STORE_TRACE_END
+#define ERASED_WORD 0xFFFFFFFFU
+#define ERASED_HALF 0xFFFFU
+
+// Header bytes written at the start; the sizes follow at the end
+#define HEADER_OPEN_BYTES offsetof(trace_session_t, data_bytes)
+
+_Static_assert(sizeof(trace_session_t) % 4U == 0, "session header must keep records word aligned");
+_Static_assert(TRACE_CODEC_MAX_BLOCK_BYTES <= TRACE_RECORD_BYTES_MASK, "coded block exceeds the record length field");
+_Static_assert(((TRACE_END - TRACE_START) % FLASH_PAGE_SIZE) == 0, "trace log must be whole pages");
+
+// Write position; pages before erased_end are known erased from write_addr on
+static uint32_t write_addr = TRACE_START;
+static uint32_t erased_end = TRACE_START;
+static uint32_t next_seq = 0;
+
+// Open session
+static bool recording = false;
+static uint32_t session_addr;
+static uint32_t session_bytes;
+static uint32_t session_samples;
+static trace_codec_state_t codec;
+static int16_t block[TRACE_CODEC_BLOCK][TRACE_CODEC_CHANNELS];
+static uint8_t block_fill = 0;
+static uint8_t coded[TRACE_CODEC_MAX_BLOCK_BYTES];
+
+/**
+ * @brief Reads a flash halfword.
+ */
+static uint16_t read_half(uint32_t addr)
+{
+    return *(const volatile uint16_t *)(uintptr_t)addr;
+}
+
+/**
+ * @brief Checks that a flash range is erased.
+ */
+static bool is_erased(uint32_t addr, uint32_t end)
+{
+    for (; addr < end; addr += 2U)
+    {
+        if (read_half(addr) != ERASED_HALF) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Gets the end of the page holding addr.
+ */
+static uint32_t page_end(uint32_t addr)
+{
+    return (addr - TRACE_START) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE + FLASH_PAGE_SIZE + TRACE_START;
+}
+
+/**
+ * @brief Gets the session header at addr, skipping voided page ends.
+ * @retval const trace_session_t* NULL at the end of the log.
+ */
+static const trace_session_t *session_at(uint32_t *addr)
+{
+    while (*addr + sizeof(trace_session_t) <= TRACE_END)
+    {
+        const trace_session_t *s = (const trace_session_t *)(uintptr_t)*addr;
+        if (s->magic == TRACE_STORE_VOID)
+        {
+            *addr = page_end(*addr);
+            continue;
+        }
+        if (s->magic != TRACE_STORE_MAGIC || s->version != TRACE_STORE_VERSION) return NULL;
+        return s;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Moves addr past a closed session.
+ * @retval bool false if the session is open (or its size is corrupt): it is the last one.
+ */
+static bool skip_session(uint32_t *addr, const trace_session_t *s)
+{
+    if (s->data_bytes > TRACE_END - *addr - sizeof(trace_session_t)) return false;
+    
+    *addr += sizeof(trace_session_t) + ((s->data_bytes + 3U) & ~3U);
+    return true;
+}
+
+/**
+ * @brief Erases the pages a write of length bytes at addr enters. While
+ *        recording, trace_store_process() has normally erased them already.
+ */
+static bool prepare(uint32_t addr, uint32_t length)
+{
+    while (erased_end < addr + length)
+    {
+        if (flash_store_erase_page(erased_end) != HAL_OK) return false;
+        erased_end += FLASH_PAGE_SIZE;
+    }
+    return true;
+}
+
+/**
+ * @brief Checks that every session in the log has been downloaded.
+ */
+static bool all_synced(void)
+{
+    uint32_t addr = TRACE_START;
+    const trace_session_t *s;
+    
+    while ((s = session_at(&addr)) != NULL)
+    {
+        if (s->flags != TRACE_FLAGS_SYNCED) return false;
+        if (!skip_session(&addr, s)) break;
+    }
+    return true;
+}
+
+/**
+ * @brief Walks the records of a session that was never closed.
+ */
+static void recover_session(uint32_t addr)
+{
+    uint32_t rec = addr + sizeof(trace_session_t);
+    uint32_t sizes[2] = {0, 0};  // data_bytes, sample_count
+    
+    while (rec + 2U <= TRACE_END)
+    {
+        uint16_t header = read_half(rec);
+        uint32_t bytes = 2U + (((uint32_t)(header & TRACE_RECORD_BYTES_MASK) + 1U) & ~1U);
+        if (header == ERASED_HALF || rec + bytes > TRACE_END) break;
+        
+        sizes[0] += bytes;
+        sizes[1] += (uint32_t)(header >> TRACE_RECORD_SAMPLES_SHIFT) + 1U;
+        rec += bytes;
+    }
+    flash_store_program(addr + HEADER_OPEN_BYTES, sizes, sizeof(sizes));
+}
+
+/**
+ * @brief Finds the end of the log and closes a session left open by a reset.
+ */
+void trace_store_init(void)
+{
+    uint32_t addr = TRACE_START;
+    const trace_session_t *s;
+    
+    recording = false;
+    next_seq = 0;
+    while ((s = session_at(&addr)) != NULL)
+    {
+        if (s->data_bytes == ERASED_WORD)
+        {
+            recover_session(addr);
+        }
+        if (s->seq >= next_seq) next_seq = s->seq + 1U;
+        if (!skip_session(&addr, s)) break;
+    }
+    
+    // A write interrupted by a reset leaves programmed bytes without a valid
+    // header behind: void the rest of the page and go on at the next one. A
+    // page start is erased anyway when it is reached.
+    if (addr < TRACE_END && (addr - TRACE_START) % FLASH_PAGE_SIZE != 0 && !is_erased(addr, page_end(addr)))
+    {
+        const uint32_t marker = TRACE_STORE_VOID;
+        flash_store_program(addr, &marker, sizeof(marker));
+        addr = page_end(addr);
+    }
+    write_addr = addr;
+    erased_end = (addr >= TRACE_END || (addr - TRACE_START) % FLASH_PAGE_SIZE == 0) ? addr : page_end(addr);
+}
+
+/**
+ * @brief Codes the pending samples into one record.
+ * @retval bool false if the log is full or programming failed.
+ */
+static bool flush_block(void)
+{
+    uint16_t length = trace_codec_encode(&codec, (const int16_t (*)[TRACE_CODEC_CHANNELS])block, block_fill, coded);
+    uint32_t bytes = 2U + (((uint32_t)length + 1U) & ~1U);
+    uint16_t header = length | (uint16_t)((block_fill - 1U) << TRACE_RECORD_SAMPLES_SHIFT);
+    
+    if (write_addr + bytes > TRACE_END || !prepare(write_addr, bytes)) return false;
+    
+    // Block first: a record whose header is still erased was never completed
+    if (flash_store_program(write_addr + 2U, coded, length) != HAL_OK ||
+        flash_store_program(write_addr, &header, sizeof(header)) != HAL_OK)
+    {
+        return false;
+    }
+    
+    write_addr += bytes;
+    session_bytes += bytes;
+    session_samples += block_fill;
+    block_fill = 0;
+    return true;
+}
+
+/**
+ * @brief Programs the session sizes and moves past it.
+ */
+static void close_session(void)
+{
+    const uint32_t sizes[2] = {session_bytes, session_samples};
+    
+    flash_store_program(session_addr + HEADER_OPEN_BYTES, sizes, sizeof(sizes));
+    write_addr = session_addr + sizeof(trace_session_t) + ((session_bytes + 3U) & ~3U);
+    recording = false;
+}
+
+/**
+ * @brief Starts a session.
+ */
+bool trace_store_begin(uint8_t exercise)
+{
+    trace_session_t header;
+    
+    trace_store_end();
+    
+    // Start over at the first page once everything was downloaded; older
+    // sessions go as their pages are erased
+    if (write_addr + TRACE_STORE_MIN_FREE > TRACE_END)
+    {
+        if (!all_synced()) return false;
+        write_addr = TRACE_START;
+        erased_end = TRACE_START;
+    }
+    
+    memset(&header, 0xFF, sizeof(header));
+    header.magic = TRACE_STORE_MAGIC;
+    header.version = TRACE_STORE_VERSION;
+    header.exercise = exercise;
+    header.sample_hz = IMU_SAMPLE_HZ;
+    header.accel_shift = TRACE_ACCEL_DROP_BITS;
+    header.gyro_shift = TRACE_GYRO_DROP_BITS;
+    header.seq = next_seq;
+    
+    if (!prepare(write_addr, sizeof(header)) ||
+        flash_store_program(write_addr, &header, HEADER_OPEN_BYTES) != HAL_OK)
+    {
+        return false;
+    }
+    
+    session_addr = write_addr;
+    session_bytes = 0;
+    session_samples = 0;
+    write_addr += sizeof(header);
+    next_seq++;
+    block_fill = 0;
+    trace_codec_reset(&codec);
+    recording = true;
+    return true;
+}
+
+/**
+ * @brief Appends one raw sample.
+ */
+void trace_store_append(const MPU6050_RawData_t *raw)
+{
+    if (!recording) return;
+    
+    int16_t *s = block[block_fill];
+    s[0] = raw->accel_x >> TRACE_ACCEL_DROP_BITS;
+    s[1] = raw->accel_y >> TRACE_ACCEL_DROP_BITS;
+    s[2] = raw->accel_z >> TRACE_ACCEL_DROP_BITS;
+    s[3] = raw->gyro_x >> TRACE_GYRO_DROP_BITS;
+    s[4] = raw->gyro_y >> TRACE_GYRO_DROP_BITS;
+    s[5] = raw->gyro_z >> TRACE_GYRO_DROP_BITS;
+    
+    if (++block_fill == TRACE_CODEC_BLOCK && !flush_block())
+    {
+        close_session();
+    }
+}
+
+/**
+ * @brief Codes the pending samples and closes the session.
+ */
+void trace_store_end(void)
+{
+    if (!recording) return;
+    
+    if (block_fill > 0)
+    {
+        flush_block();
+    }
+    close_session();
+}
+
+/**
+ * @brief Keeps the page after the write position erased.
+ */
+void trace_store_process(void)
+{
+    if (!recording || erased_end >= TRACE_END || erased_end - write_addr >= FLASH_PAGE_SIZE) return;
+    
+    if (flash_store_erase_page(erased_end) == HAL_OK)
+    {
+        erased_end += FLASH_PAGE_SIZE;
+    }
+}
+
+/**
+ * @brief Checks whether a session is being recorded.
+ */
+bool trace_store_is_recording(void)
+{
+    return recording;
+}
+
+/**
+ * @brief Checks whether a new session would have to overwrite sessions not
+ *        downloaded yet.
+ */
+bool trace_store_is_full(void)
+{
+    return write_addr + TRACE_STORE_MIN_FREE > TRACE_END && !all_synced();
+}
+
+/**
+ * @brief Gets a stored session by its position in the log.
+ */
+const trace_session_t *trace_store_get_session(uint16_t index)
+{
+    uint32_t addr = TRACE_START;
+    const trace_session_t *s;
+    
+    while ((s = session_at(&addr)) != NULL)
+    {
+        if (index-- == 0) return s;
+        if (!skip_session(&addr, s)) break;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Finds a stored session by sequence number.
+ */
+const trace_session_t *trace_store_find(uint32_t seq)
+{
+    uint32_t addr = TRACE_START;
+    const trace_session_t *s;
+    
+    while ((s = session_at(&addr)) != NULL)
+    {
+        if (s->seq == seq) return s;
+        if (!skip_session(&addr, s)) break;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Checks that bytes of a stored session are still in flash.
+ */
+bool trace_store_is_readable(const trace_session_t *s, uint32_t offset, uint32_t length)
+{
+    uint32_t start = (uint32_t)(uintptr_t)s + offset;
+    
+    return start + length <= write_addr || start >= erased_end;
+}
+
+/**
+ * @brief Marks a closed session as downloaded.
+ */
+bool trace_store_mark_synced(uint32_t seq)
+{
+    const trace_session_t *s = trace_store_find(seq);
+    const uint16_t flags = TRACE_FLAGS_SYNCED;
+    
+    if (s == NULL || s->data_bytes == ERASED_WORD) return false;
+    if (s->flags == TRACE_FLAGS_SYNCED) return true;
+    return flash_store_program((uint32_t)(uintptr_t)&s->flags, &flags, sizeof(flags)) == HAL_OK;
+}
+
+#endif // ENABLE_TRACE_STORE
@@ -0,0 +1,125 @@
+#ifndef TRACE_STORE_H
+#define TRACE_STORE_H
+
+#include "mpu6050.h"
+#include "trace_codec.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Raw IMU sessions in the trace log pages (FLASH_STORE_TRACE_ADDR..END),
+// appended one after the other. A session is a header, then records of one
+// coded block each: a halfword (bytes | (samples - 1) << 10), then the
+// trace_codec block padded to a halfword. The record header is programmed
+// after its block, so an erased header (0xFFFF) ends the session. Sessions
+// start on a word boundary; a zero word in place of a header (TRACE_STORE_VOID)
+// skips the rest of its page. When less than TRACE_STORE_MIN_FREE is left, the
+// next session starts over at the first page, and older sessions are lost as
+// their pages are erased, but only once every session was marked as
+// downloaded; until then no new session is recorded (trace_store_is_full()).
+// While recording, trace_store_process() erases the next page ahead of the
+// writer, so appends only program.
+#define TRACE_STORE_MAGIC    0x54524353U  // "TRCS"
+#define TRACE_STORE_VERSION  1
+#define TRACE_STORE_VOID     0x00000000U  // Left behind an interrupted write
+#define TRACE_STORE_MIN_FREE 1024U        // Room a new session needs (one page)
+#define TRACE_FLAGS_SYNCED   0x0000U      // flags once the session was downloaded
+
+#define TRACE_RECORD_BYTES_MASK   0x03FFU
+#define TRACE_RECORD_SAMPLES_SHIFT 10
+
+// Session header. data_bytes and sample_count stay erased (0xFFFFFFFF) while
+// recording and are programmed when the session ends; a session cut short by
+// a reset is closed at the next trace_store_init().
+typedef struct {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t exercise;       // exercise_t
+    uint16_t sample_hz;
+    uint8_t accel_shift;    // LSBs dropped before coding (TRACE_ACCEL_DROP_BITS)
+    uint8_t gyro_shift;     // TRACE_GYRO_DROP_BITS
+    uint16_t flags;         // Erased (0xFFFF), then TRACE_FLAGS_SYNCED; bits are only ever cleared
+    uint32_t seq;           // Session number, counting up across the log
+    uint32_t data_bytes;    // Record bytes after the header
+    uint32_t sample_count;
+} trace_session_t;
+
+/**
+ * @brief Finds the end of the log and closes a session left open by a reset.
+ */
+void trace_store_init(void);
+
+/**
+ * @brief Starts a session (erasing its first page if needed, ~20 ms).
+ *        An open session is ended first.
+ * @param exercise Exercise being recorded.
+ * @retval bool false if the log is full of sessions not downloaded yet, or
+ *         the header could not be written.
+ */
+bool trace_store_begin(uint8_t exercise);
+
+/**
+ * @brief Appends one raw sample; a full block is coded and programmed
+ *        (a few ms; a page is only erased here if trace_store_process() fell
+ *        behind). No-op without an open session. The session ends when the
+ *        log is full.
+ * @param raw Decimated raw frame, before scaling.
+ */
+void trace_store_append(const MPU6050_RawData_t *raw);
+
+/**
+ * @brief Erases the next page ahead of an open session (~20 ms when it
+ *        does). Call from the main loop.
+ */
+void trace_store_process(void);
+
+/**
+ * @brief Codes the pending samples and closes the session.
+ */
+void trace_store_end(void);
+
+/**
+ * @brief Checks whether a session is being recorded.
+ */
+bool trace_store_is_recording(void);
+
+/**
+ * @brief Checks whether the log is out of room until sessions are downloaded
+ *        and marked as synced.
+ * @retval bool true if the next session would be refused.
+ */
+bool trace_store_is_full(void);
+
+/**
+ * @brief Gets a stored session by its position in the log. The session
+ *        being recorded is the last one; its sizes are still erased.
+ * @param index Position, oldest first.
+ * @retval const trace_session_t* Header in flash (the records follow it),
+ *         NULL past the last session.
+ */
+const trace_session_t *trace_store_get_session(uint16_t index);
+
+/**
+ * @brief Finds a stored session by sequence number.
+ * @retval const trace_session_t* Header in flash, NULL if it is not in the log.
+ */
+const trace_session_t *trace_store_find(uint32_t seq);
+
+/**
+ * @brief Checks that bytes of a stored session are still in flash. After the
+ *        log started over, a session ahead of the writer loses its pages as
+ *        they are erased for new sessions.
+ * @param s Session header in flash.
+ * @param offset First byte, counted from the header.
+ * @param length Byte count.
+ * @retval bool true if the range lies behind the write position or past the
+ *         pages erased since.
+ */
+bool trace_store_is_readable(const trace_session_t *s, uint32_t offset, uint32_t length);
+
+/**
+ * @brief Marks a closed session as downloaded (flags -> TRACE_FLAGS_SYNCED).
+ * @retval bool false if there is no such closed session or programming failed.
+ */
+bool trace_store_mark_synced(uint32_t seq);
+
+#endif // TRACE_STORE_H
@@ -0,0 +1,160 @@
+#include "button.h"
+#include "mcu_pinmap.h"
+#include "systick.h"
+#include "clock_ctrl.h"
+#include <stdbool.h>
+
+// What the running TIM4 one-shot is timing
+typedef enum {
+    BUTTON_TIMER_DEBOUNCE = 0,
+    BUTTON_TIMER_HOLD
+} button_timer_phase_t;
+
+static TIM_HandleTypeDef htim4;
+static volatile button_event_t pending_event = BUTTON_EVENT_NONE;
+static volatile button_timer_phase_t timer_phase = BUTTON_TIMER_DEBOUNCE;
+static bool pressed = false;       // Debounced state (interrupt context only)
+static bool long_reported = false;
+static uint32_t press_start_ms = 0;
+
+/**
+ * @brief Starts the TIM4 one-shot. The prescaler is recomputed on every start,
+ *        so the timing follows clock_ctrl profile switches.
+ */
+static void start_timer(button_timer_phase_t phase, uint32_t ms)
+{
+    TIM4->CR1 &= ~TIM_CR1_CEN;
+    timer_phase = phase;
+    TIM4->PSC = (clock_ctrl_get_apb1_timer_hz() / BUTTON_TIMER_HZ) - 1U;
+    TIM4->ARR = ms * (BUTTON_TIMER_HZ / 1000U) - 1U;
+    TIM4->CNT = 0;
+    
+    // Load the prescaler now (URS: the forced update raises no interrupt)
+    TIM4->EGR = TIM_EGR_UG;
+    TIM4->SR = 0;
+    TIM4->CR1 |= TIM_CR1_CEN;
+}
+
+/**
+ * @brief Reads the (active-low) button level.
+ */
+static bool button_is_down(void)
+{
+    return HAL_GPIO_ReadPin(BUTTON_GPIO_PORT, BUTTON_PIN) == GPIO_PIN_RESET;
+}
+
+/**
+ * @brief Configures the button EXTI and the TIM4 debounce timer.
+ */
+HAL_StatusTypeDef button_init(void)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    
+    // Both edges: presses and releases are debounced the same way
+    GPIO_InitStruct.Pin = BUTTON_PIN;
+    GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING_FALLING;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(BUTTON_GPIO_PORT, &GPIO_InitStruct);
+    
+    __HAL_RCC_TIM4_CLK_ENABLE();
+    htim4.Instance = TIM4;
+    htim4.Init.Prescaler = (clock_ctrl_get_apb1_timer_hz() / BUTTON_TIMER_HZ) - 1U;
+    htim4.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim4.Init.Period = BUTTON_DEBOUNCE_MS * (BUTTON_TIMER_HZ / 1000U) - 1U;
+    htim4.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim4.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    if (HAL_TIM_Base_Init(&htim4) != HAL_OK) return HAL_ERROR;
+    
+    // One-pulse: the counter stops itself after each timeout
+    TIM4->CR1 |= TIM_CR1_OPM | TIM_CR1_URS;
+    TIM4->SR = 0;
+    TIM4->DIER |= TIM_DIER_UIE;
+    
+    HAL_NVIC_SetPriority(TIM4_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+    HAL_NVIC_SetPriority(BUTTON_EXTI_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(BUTTON_EXTI_IRQn);
+    
+    return HAL_OK;
+}
+
+/**
+ * @brief Takes the pending button event, if any.
+ */
+button_event_t button_get_event(void)
+{
+    __disable_irq();
+    button_event_t event = pending_event;
+    pending_event = BUTTON_EVENT_NONE;
+    __enable_irq();
+    return event;
+}
+
+/**
+ * @brief Button edge: masks the line and (re)starts the debounce timeout.
+ */
+void EXTI9_5_IRQHandler(void)
+{
+    if (__HAL_GPIO_EXTI_GET_IT(BUTTON_PIN))
+    {
+        __HAL_GPIO_EXTI_CLEAR_IT(BUTTON_PIN);
+        
+        // Further bounces are ignored until the level is sampled
+        EXTI->IMR &= ~BUTTON_PIN;
+        start_timer(BUTTON_TIMER_DEBOUNCE, BUTTON_DEBOUNCE_MS);
+    }
+}
+
+/**
+ * @brief Debounce / hold timeout: samples the settled level and raises events.
+ */
+void TIM4_IRQHandler(void)
+{
+    TIM4->SR = 0;
+    
+    if (timer_phase == BUTTON_TIMER_HOLD)
+    {
+        // Still held after BUTTON_LONG_PRESS_MS
+        if (pressed && !long_reported)
+        {
+            long_reported = true;
+            pending_event = BUTTON_EVENT_LONG;
+        }
+        return;
+    }
+    
+    bool down = button_is_down();
+    uint32_t now = systick_get_uptime_ms();
+    
+    if (down && !pressed)
+    {
+        pressed = true;
+        long_reported = false;
+        press_start_ms = now - BUTTON_DEBOUNCE_MS;
+        start_timer(BUTTON_TIMER_HOLD, BUTTON_LONG_PRESS_MS - BUTTON_DEBOUNCE_MS);
+    }
+    else if (!down && pressed)
+    {
+        pressed = false;
+        if (!long_reported)
+        {
+            pending_event = BUTTON_EVENT_SHORT;
+        }
+    }
+    else if (down && !long_reported)
+    {
+        // Glitch while held: the edge cancelled the hold timeout, resume it
+        uint32_t held_ms = now - press_start_ms;
+        uint32_t remaining_ms = held_ms < BUTTON_LONG_PRESS_MS ? BUTTON_LONG_PRESS_MS - held_ms : 1U;
+        start_timer(BUTTON_TIMER_HOLD, remaining_ms);
+    }
+    
+    // Settled: take the next edge; one that slipped in before unmasking shows up as a level mismatch
+    __HAL_GPIO_EXTI_CLEAR_IT(BUTTON_PIN);
+    EXTI->IMR |= BUTTON_PIN;
+    if (button_is_down() != pressed)
+    {
+        EXTI->IMR &= ~BUTTON_PIN;
+        start_timer(BUTTON_TIMER_DEBOUNCE, BUTTON_DEBOUNCE_MS);
+    }
+}
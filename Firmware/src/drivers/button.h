@@ -0,0 +1,31 @@
+#ifndef BUTTON_H
+#define BUTTON_H
+
+#include "stm32f1xx_hal.h"
+
+// Push-button timing: EXTI edges start a TIM4 one-shot, the level is only
+// sampled once the contacts have settled
+#define BUTTON_DEBOUNCE_MS  20
+#define BUTTON_LONG_PRESS_MS 800   // Held this long: long press (reported while still held)
+#define BUTTON_TIMER_HZ     10000  // TIM4 tick, 0.1 ms
+
+typedef enum {
+    BUTTON_EVENT_NONE = 0,
+    BUTTON_EVENT_SHORT,  // Released before BUTTON_LONG_PRESS_MS
+    BUTTON_EVENT_LONG    // Held for BUTTON_LONG_PRESS_MS (no event on release)
+} button_event_t;
+
+/**
+ * @brief Configures the button pin for EXTI on both edges and the TIM4
+ *        debounce timer. Needs the GPIO clock enabled.
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef button_init(void);
+
+/**
+ * @brief Takes the pending button event, if any (set from interrupt context).
+ * @retval button_event_t Pending event, BUTTON_EVENT_NONE if there is none.
+ */
+button_event_t button_get_event(void);
+
+#endif // BUTTON_H
@@ -0,0 +1,294 @@
+#include "clock_ctrl.h"
+#include "app_config.h"
+#include "mcu_pinmap.h"
+#include "i2c_bus.h"
+#include "timebase.h"
+#include "systick.h"
+#include <stdbool.h>
+
+// Active profile (SystemClock_Config boots at full speed)
+static clock_profile_t current_profile = CLOCK_PROFILE_FULL_SPEED;
+static bool peripherals_ready = false;
+
+// Load measurement state (DWT cycle counter)
+static uint32_t window_start_cycles = 0;
+static uint32_t busy_start_cycles = 0;
+static uint32_t busy_cycles = 0;
+static uint32_t wait_start_cycles = 0;
+static uint32_t wait_cycles = 0;
+static uint8_t load_pct = 0;
+static uint8_t wait_pct = 0;
+static uint8_t quiet_windows = 0;
+static volatile bool full_speed_requested = false;
+
+// Time spent in each profile since the last residency reset
+static uint32_t residency_ms[2] = {0, 0};
+static uint32_t residency_start_ms = 0;
+
+/**
+ * @brief Applies a clock profile to the RCC only (no peripheral re-timing).
+ */
+HAL_StatusTypeDef clock_ctrl_apply_rcc(clock_profile_t profile)
+{
+    RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+    RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
+    
+    RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
+                                |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
+    RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
+    RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
+    
+    if (profile == CLOCK_PROFILE_FULL_SPEED)
+    {
+        // HSE on, PLL = HSE x 9 = 72 MHz
+        RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSE;
+        RCC_OscInitStruct.HSEState = RCC_HSE_ON;
+        RCC_OscInitStruct.HSEPredivValue = RCC_HSE_PREDIV_DIV1;
+        RCC_OscInitStruct.HSIState = RCC_HSI_ON;
+        RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+        RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
+        RCC_OscInitStruct.PLL.PLLMUL = RCC_PLL_MUL9;
+        if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
+        {
+            return HAL_ERROR;
+        }
+        
+        // APB1 is limited to 36 MHz
+        RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+        RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV2;
+        
+        // HAL_RCC_ClockConfig raises flash latency before the switch and
+        // reloads SysTick for the new HCLK through HAL_InitTick()
+        return HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_2);
+    }
+    
+    // Move SYSCLK onto HSE first, the PLL cannot be stopped while it drives SYSCLK
+    RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_HSE;
+    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV1;
+    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_0) != HAL_OK)
+    {
+        return HAL_ERROR;
+    }
+    
+    // Stop the PLL to save its supply current
+    RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_NONE;
+    RCC_OscInitStruct.PLL.PLLState = RCC_PLL_OFF;
+    return HAL_RCC_OscConfig(&RCC_OscInitStruct);
+}
+
+/**
+ * @brief Restarts the load measurement window.
+ */
+static void restart_window(void)
+{
+    window_start_cycles = DWT->CYCCNT;
+    busy_cycles = 0;
+    wait_cycles = 0;
+}
+
+/**
+ * @brief Charges the time since the last call to the active profile.
+ */
+static void account_residency(void)
+{
+    uint32_t now = systick_get_uptime_ms();
+    residency_ms[current_profile] += now - residency_start_ms;
+    residency_start_ms = now;
+}
+
+/**
+ * @brief Initializes load measurement.
+ */
+void clock_ctrl_init(void)
+{
+    // Enable the DWT cycle counter
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    
+    peripherals_ready = true;
+    quiet_windows = 0;
+    restart_window();
+    clock_ctrl_reset_residency();
+}
+
+/**
+ * @brief Switches to a clock profile and re-times I2C, UART, SysTick and the timebase.
+ */
+HAL_StatusTypeDef clock_ctrl_set_profile(clock_profile_t profile)
+{
+    if (profile == current_profile) return HAL_OK;
+    
+    uint32_t now_us = peripherals_ready ? timebase_get_us() : 0;
+    if (peripherals_ready) account_residency();
+    if (clock_ctrl_apply_rcc(profile) != HAL_OK)
+    {
+        return HAL_ERROR;
+    }
+    current_profile = profile;
+    
+    // SysTick was reloaded by HAL_RCC_ClockConfig, re-derive bus timings from the new PCLK1
+    if (peripherals_ready)
+    {
+        timebase_reconfigure(now_us);
+        if (i2c_bus_reconfigure() != HAL_OK)
+        {
+            return HAL_ERROR;
+        }
+#if ENABLE_LOG_UART || ENABLE_HOST_PROTO
+        if (HAL_UART_Init(&huart2) != HAL_OK)
+        {
+            return HAL_ERROR;
+        }
+#endif
+    }
+    
+    quiet_windows = 0;
+    restart_window();
+    return HAL_OK;
+}
+
+/**
+ * @brief Gets the active clock profile.
+ */
+clock_profile_t clock_ctrl_get_profile(void)
+{
+    return current_profile;
+}
+
+/**
+ * @brief Gets the APB1 timer clock (x2 whenever APB1 is divided).
+ */
+uint32_t clock_ctrl_get_apb1_timer_hz(void)
+{
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) == RCC_CFGR_PPRE1_DIV1)
+    {
+        return pclk1;
+    }
+    return pclk1 * 2U;
+}
+
+/**
+ * @brief Marks the start of a busy section.
+ */
+void clock_ctrl_busy_begin(void)
+{
+    busy_start_cycles = DWT->CYCCNT;
+}
+
+/**
+ * @brief Marks the end of a busy section.
+ */
+void clock_ctrl_busy_end(void)
+{
+    busy_cycles += DWT->CYCCNT - busy_start_cycles;
+}
+
+/**
+ * @brief Marks the start of a blocking bus or flash wait.
+ */
+void clock_ctrl_wait_begin(void)
+{
+    wait_start_cycles = DWT->CYCCNT;
+}
+
+/**
+ * @brief Marks the end of a blocking bus or flash wait.
+ */
+void clock_ctrl_wait_end(void)
+{
+    wait_cycles += DWT->CYCCNT - wait_start_cycles;
+}
+
+/**
+ * @brief Requests full speed immediately.
+ */
+void clock_ctrl_request_full_speed(void)
+{
+    full_speed_requested = true;
+}
+
+/**
+ * @brief Evaluates the measured load and switches profile if needed.
+ */
+void clock_ctrl_update(void)
+{
+    if (!peripherals_ready) return;
+    
+    if (full_speed_requested)
+    {
+        full_speed_requested = false;
+        clock_ctrl_set_profile(CLOCK_PROFILE_FULL_SPEED);
+        return;
+    }
+    
+    uint32_t window_cycles = (SystemCoreClock / 1000U) * CLOCK_LOAD_WINDOW_MS;
+    uint32_t elapsed = DWT->CYCCNT - window_start_cycles;
+    if (elapsed < window_cycles) return;
+    
+    // Bus and flash waits take the same wall time in either profile, only the
+    // CPU-bound part of the busy time scales with the clock
+    uint32_t cpu_cycles = (busy_cycles > wait_cycles) ? busy_cycles - wait_cycles : 0;
+    load_pct = (uint8_t)(((uint64_t)cpu_cycles * 100U) / elapsed);
+    wait_pct = (uint8_t)(((uint64_t)wait_cycles * 100U) / elapsed);
+    restart_window();
+    
+    if (current_profile == CLOCK_PROFILE_LOW_POWER)
+    {
+        if (load_pct >= CLOCK_LOAD_UP_PCT)
+        {
+            clock_ctrl_set_profile(CLOCK_PROFILE_FULL_SPEED);
+        }
+        return;
+    }
+    
+    // Project the CPU load onto the 8 MHz profile
+    uint32_t projected_pct = (uint32_t)load_pct * 9U;
+    if (projected_pct < CLOCK_LOAD_DOWN_PCT)
+    {
+        if (++quiet_windows >= CLOCK_LOAD_DOWN_WINDOWS)
+        {
+            clock_ctrl_set_profile(CLOCK_PROFILE_LOW_POWER);
+        }
+    }
+    else
+    {
+        quiet_windows = 0;
+    }
+}
+
+/**
+ * @brief Gets the load measured over the last complete window.
+ */
+uint8_t clock_ctrl_get_load_pct(void)
+{
+    return load_pct;
+}
+
+/**
+ * @brief Gets the share of the last complete window spent waiting on I2C or flash.
+ */
+uint8_t clock_ctrl_get_wait_pct(void)
+{
+    return wait_pct;
+}
+
+/**
+ * @brief Restarts the per-profile residency counters.
+ */
+void clock_ctrl_reset_residency(void)
+{
+    residency_ms[CLOCK_PROFILE_LOW_POWER] = 0;
+    residency_ms[CLOCK_PROFILE_FULL_SPEED] = 0;
+    residency_start_ms = systick_get_uptime_ms();
+}
+
+/**
+ * @brief Gets the time spent in a profile since the last residency reset.
+ */
+uint32_t clock_ctrl_get_residency_ms(clock_profile_t profile)
+{
+    if (peripherals_ready) account_residency();
+    return residency_ms[profile];
+}
@@ -0,0 +1,158 @@
+#include "flash_store.h"
+#include "clock_ctrl.h"
+#include <string.h>
+
+// Header word 0: magic, word 1: version | length << 16
+#define HEADER_BYTES 8U
+
+/**
+ * @brief Computes the CRC-32 (IEEE, reflected), continuing from crc.
+ */
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * @brief Gets the word-padded size of a record.
+ */
+static uint32_t padded_length(uint16_t length)
+{
+    return ((uint32_t)length + 3U) & ~3U;
+}
+
+/**
+ * @brief Computes the CRC of a page image: header, then the padded record.
+ */
+static uint32_t record_crc(const uint32_t header[2], const uint8_t *record, uint16_t length)
+{
+    static const uint8_t pad[3] = {0, 0, 0};
+    uint32_t crc = crc32_update(0, (const uint8_t *)header, HEADER_BYTES);
+    crc = crc32_update(crc, record, length);
+    return crc32_update(crc, pad, padded_length(length) - length);
+}
+
+/**
+ * @brief Loads a record from a flash page.
+ */
+bool flash_store_load(uint32_t page_addr, uint32_t magic, uint16_t version, void *record, uint16_t length)
+{
+    const uint32_t *page = (const uint32_t *)(uintptr_t)page_addr;
+    const uint8_t *stored = (const uint8_t *)(uintptr_t)page_addr + HEADER_BYTES;
+    uint32_t header[2] = {magic, (uint32_t)version | ((uint32_t)length << 16)};
+    
+    if (record == NULL || length > FLASH_STORE_MAX_RECORD) return false;
+    
+    // Erased flash (all 0xFF) and records of another layout fail here
+    if (page[0] != header[0] || page[1] != header[1]) return false;
+    
+    uint32_t crc;
+    memcpy(&crc, stored + padded_length(length), sizeof(crc));
+    if (crc != record_crc(header, stored, length)) return false;
+    
+    memcpy(record, stored, length);
+    return true;
+}
+
+/**
+ * @brief Writes a record to a flash page.
+ */
+HAL_StatusTypeDef flash_store_save(uint32_t page_addr, uint32_t magic, uint16_t version, const void *record, uint16_t length)
+{
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t page_error = 0;
+    uint32_t header[2] = {magic, (uint32_t)version | ((uint32_t)length << 16)};
+    HAL_StatusTypeDef status;
+    
+    if (record == NULL || length > FLASH_STORE_MAX_RECORD) return HAL_ERROR;
+    
+    // Spare the erase cycle when nothing changed
+    const uint8_t *data = (const uint8_t *)record;
+    uint32_t crc = record_crc(header, data, length);
+    if (memcmp((const void *)(uintptr_t)page_addr, header, HEADER_BYTES) == 0 &&
+        memcmp((const uint8_t *)(uintptr_t)page_addr + HEADER_BYTES, data, length) == 0 &&
+        memcmp((const uint8_t *)(uintptr_t)page_addr + HEADER_BYTES + padded_length(length), &crc, sizeof(crc)) == 0)
+    {
+        return HAL_OK;
+    }
+    
+    clock_ctrl_wait_begin();
+    HAL_FLASH_Unlock();
+    
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.PageAddress = page_addr;
+    erase.NbPages = 1;
+    status = HAL_FLASHEx_Erase(&erase, &page_error);
+    
+    // Header, record (last word zero-padded), CRC
+    uint32_t addr = page_addr;
+    for (uint32_t i = 0; status == HAL_OK && i < 2U; i++, addr += 4U)
+    {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, header[i]);
+    }
+    for (uint32_t i = 0; status == HAL_OK && i < length; i += 4U, addr += 4U)
+    {
+        uint32_t word = 0;
+        memcpy(&word, data + i, (length - i) < 4U ? (length - i) : 4U);
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, word);
+    }
+    if (status == HAL_OK)
+    {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, crc);
+    }
+    
+    HAL_FLASH_Lock();
+    clock_ctrl_wait_end();
+    return status;
+}
+
+/**
+ * @brief Erases one page.
+ */
+HAL_StatusTypeDef flash_store_erase_page(uint32_t page_addr)
+{
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t page_error = 0;
+    
+    clock_ctrl_wait_begin();
+    HAL_FLASH_Unlock();
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.PageAddress = page_addr;
+    erase.NbPages = 1;
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &page_error);
+    HAL_FLASH_Lock();
+    clock_ctrl_wait_end();
+    return status;
+}
+
+/**
+ * @brief Programs bytes into erased flash, one halfword at a time.
+ */
+HAL_StatusTypeDef flash_store_program(uint32_t addr, const void *data, uint16_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    HAL_StatusTypeDef status = HAL_OK;
+    
+    if (data == NULL || (addr & 1U) != 0U) return HAL_ERROR;
+    
+    clock_ctrl_wait_begin();
+    HAL_FLASH_Unlock();
+    for (uint32_t i = 0; status == HAL_OK && i < length; i += 2U)
+    {
+        uint16_t half = bytes[i];
+        half |= (uint16_t)(((i + 1U) < length) ? bytes[i + 1U] : 0xFFU) << 8;
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, addr + i, half);
+    }
+    HAL_FLASH_Lock();
+    clock_ctrl_wait_end();
+    return status;
+}
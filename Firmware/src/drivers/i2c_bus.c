@@ -1,5 +1,6 @@
 #include "i2c_bus.h"
 #include "mcu_pinmap.h"
+#include "clock_ctrl.h"
 
 // I2C_HandleTypeDef hi2c1; // Defined in main.c or generated by CubeMX
 
@@ -19,7 +20,7 @@ HAL_StatusTypeDef i2c_bus_init(void)
     hi2c1.Init.OwnAddress2 = 0;
     hi2c1.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
     hi2c1.Init.NoStretchMode = I2C_NOSTRETCH_DISABLE;
-
+    
     if (HAL_I2C_Init(&hi2c1) != HAL_OK)
     {
         // Fallback to standard mode if fast mode fails
@@ -32,12 +33,26 @@ HAL_StatusTypeDef i2c_bus_init(void)
     return HAL_OK;
 }
 
+/**
+ * @brief Re-initializes the I2C bus so its timing follows the current PCLK1.
+ *        HAL_I2C_Init derives CCR/TRISE from HAL_RCC_GetPCLK1Freq().
+ */
+HAL_StatusTypeDef i2c_bus_reconfigure(void)
+{
+    HAL_I2C_DeInit(&hi2c1);
+    return i2c_bus_init();
+}
+
 /**
  * @brief Reads a sequence of bytes from a device's internal register.
  */
 HAL_StatusTypeDef i2c_mem_read(uint16_t dev_address, uint16_t reg_address, uint8_t *pData, uint16_t Size)
 {
-    return HAL_I2C_Mem_Read(&hi2c1, dev_address, reg_address, I2C_MEMADD_SIZE_8BIT, pData, Size, HAL_MAX_DELAY);
+    // Polled transfer: the wait is bus time, not CPU load
+    clock_ctrl_wait_begin();
+    HAL_StatusTypeDef status = HAL_I2C_Mem_Read(&hi2c1, dev_address, reg_address, I2C_MEMADD_SIZE_8BIT, pData, Size, HAL_MAX_DELAY);
+    clock_ctrl_wait_end();
+    return status;
 }
 
 /**
@@ -45,6 +60,10 @@ HAL_StatusTypeDef i2c_mem_read(uint16_t dev_address, uint16_t reg_address, uint8
  */
 HAL_StatusTypeDef i2c_mem_write(uint16_t dev_address, uint16_t reg_address, uint8_t *pData, uint16_t Size)
 {
-    return HAL_I2C_Mem_Write(&hi2c1, dev_address, reg_address, I2C_MEMADD_SIZE_8BIT, pData, Size, HAL_MAX_DELAY);
+    // Polled transfer: the wait is bus time, not CPU load
+    clock_ctrl_wait_begin();
+    HAL_StatusTypeDef status = HAL_I2C_Mem_Write(&hi2c1, dev_address, reg_address, I2C_MEMADD_SIZE_8BIT, pData, Size, HAL_MAX_DELAY);
+    clock_ctrl_wait_end();
+    return status;
 }
 
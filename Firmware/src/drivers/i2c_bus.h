@@ -13,6 +13,13 @@
  */
 HAL_StatusTypeDef i2c_bus_init(void);
 
+/**
+ * @brief Re-initializes the I2C bus so its timing follows the current PCLK1.
+ *        Must be called after every system clock change.
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef i2c_bus_reconfigure(void);
+
 /**
  * @brief Reads a sequence of bytes from a device's internal register.
  * @param dev_address Device address (7-bit, left-shifted by 1 for HAL usage).
@@ -4,7 +4,7 @@
 #include <stdio.h>
 #include <string.h>
 
-#ifdef ENABLE_LOG_UART
+#if ENABLE_LOG_UART
 
 // UART_HandleTypeDef huart2; // Defined in main.c or generated by CubeMX
 
@@ -2,8 +2,9 @@
 #define LOG_UART_H
 
 #include "stm32f1xx_hal.h"
+#include "app_config.h"
 
-#ifdef ENABLE_LOG_UART
+#if ENABLE_LOG_UART
 
 /**
  * @brief Initializes the UART for logging.
@@ -1,6 +1,7 @@
 #include "mpu6050.h"
 #include "i2c_bus.h"
 #include "app_config.h"
+#include "timebase.h"
 #include <math.h>
 
 // MPU6050 Register Map
@@ -12,6 +13,17 @@
 #define MPU6050_ACCEL_XOUT_H    0x3B
 #define MPU6050_TEMP_OUT_H      0x41
 #define MPU6050_GYRO_XOUT_H     0x43
+#define MPU6050_FIFO_EN         0x23
+#define MPU6050_USER_CTRL       0x6A
+#define MPU6050_FIFO_COUNTH     0x72
+#define MPU6050_FIFO_R_W        0x74
+
+// FIFO configuration (accel + gyro, 12 bytes per frame)
+#define MPU6050_FIFO_SIZE           1024
+#define MPU6050_FIFO_EN_ACCEL_GYRO  0x78  // XG | YG | ZG | ACCEL
+#define MPU6050_USER_CTRL_FIFO_EN   0x40
+#define MPU6050_USER_CTRL_FIFO_RST  0x04
+#define MPU6050_FIFO_CHUNK_FRAMES   8     // Frames per I2C burst (96-byte stack buffer)
 
 // MPU6050 Full-Scale Range Factors
 static float ACCEL_SCALE_FACTOR = 0.0f;
@@ -21,6 +33,20 @@ static float GYRO_SCALE_FACTOR = 0.0f;
 static float accel_bias[3] = {0.0f, 0.0f, 0.0f};
 static float gyro_bias[3] = {0.0f, 0.0f, 0.0f};
 
+// The gyro bias in 1/2^MPU6050_GYRO_BIAS_FRAC LSB (mpu6050_get_gyro_bias_raw())
+static int32_t gyro_bias_raw[3] = {0, 0, 0};
+
+/**
+ * @brief Re-derives the raw-unit gyro bias after a bias change.
+ */
+static void update_gyro_bias_raw(void)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        gyro_bias_raw[i] = (int32_t)lroundf(gyro_bias[i] * (MPU6050_GYRO_LSB_PER_DPS << MPU6050_GYRO_BIAS_FRAC));
+    }
+}
+
 /**
  * @brief Writes a single byte to an MPU6050 register.
  */
@@ -48,28 +74,106 @@ HAL_StatusTypeDef mpu6050_init(void)
         // LOG("MPU-6050 not found or WHO_AM_I mismatch!\n");
         return HAL_ERROR;
     }
-
+    
     // Wake up MPU-6050
     if (MPU6050_WriteRegister(MPU6050_PWR_MGMT_1, 0x00) != HAL_OK) return HAL_ERROR;
 
+#if IMU_OVERSAMPLE
+    // Oversampling: full 1 kHz output (SMPLRT_DIV = 0) with the widest DLPF that
+    // keeps the gyro at 1 kHz, DLPF_CFG = 1 (188 Hz gyro / 184 Hz accel).
+    // Anti-aliasing down to IMU_SAMPLE_HZ is done by the CIC decimator on the MCU.
+    if (MPU6050_WriteRegister(MPU6050_SMPLRT_DIV, (1000 / IMU_OVERSAMPLE_HZ) - 1) != HAL_OK) return HAL_ERROR;
+    if (MPU6050_WriteRegister(MPU6050_CONFIG, 0x01) != HAL_OK) return HAL_ERROR;
+#else
     // Set sample rate to IMU_SAMPLE_HZ (e.g., 200Hz, with DLPF 42Hz, gives SMPLRT_DIV = 4)
     // Sample Rate = Gyroscope Output Rate / (1 + SMPLRT_DIV)
     // Gyro Output Rate = 1kHz (when DLPF is enabled and set to 42Hz or less)
     // 200 Hz = 1000 Hz / (1 + SMPLRT_DIV) => 1 + SMPLRT_DIV = 5 => SMPLRT_DIV = 4
     if (MPU6050_WriteRegister(MPU6050_SMPLRT_DIV, (1000 / IMU_SAMPLE_HZ) - 1) != HAL_OK) return HAL_ERROR;
-
+    
     // Configure DLPF (Digital Low Pass Filter)
     // F_EXT_SYNC_SET = 0, DLPF_CFG = 3 (42 Hz) for both accel and gyro
     if (MPU6050_WriteRegister(MPU6050_CONFIG, 0x03) != HAL_OK) return HAL_ERROR;
-
+#endif
+    
     // Configure Gyroscope: +/- 250 deg/s (FS_SEL = 0)
     if (MPU6050_WriteRegister(MPU6050_GYRO_CONFIG, 0x00) != HAL_OK) return HAL_ERROR;
-    GYRO_SCALE_FACTOR = 131.0f; // 131 LSB/deg/s for +/- 250 deg/s
-
+    GYRO_SCALE_FACTOR = (float)MPU6050_GYRO_LSB_PER_DPS;
+    
     // Configure Accelerometer: +/- 2g (AFS_SEL = 0)
     if (MPU6050_WriteRegister(MPU6050_ACCEL_CONFIG, 0x00) != HAL_OK) return HAL_ERROR;
-    ACCEL_SCALE_FACTOR = 16384.0f; // 16384 LSB/g for +/- 2g
+    ACCEL_SCALE_FACTOR = (float)MPU6050_ACCEL_LSB_PER_G;
 
+#if IMU_OVERSAMPLE
+    // Route accel + gyro (no temperature) into the FIFO
+    if (MPU6050_WriteRegister(MPU6050_FIFO_EN, MPU6050_FIFO_EN_ACCEL_GYRO) != HAL_OK) return HAL_ERROR;
+    if (mpu6050_fifo_reset() != HAL_OK) return HAL_ERROR;
+#endif
+    
+    return HAL_OK;
+}
+
+/**
+ * @brief Flushes the FIFO and restarts collection on a frame boundary.
+ */
+HAL_StatusTypeDef mpu6050_fifo_reset(void)
+{
+    if (MPU6050_WriteRegister(MPU6050_USER_CTRL, MPU6050_USER_CTRL_FIFO_RST) != HAL_OK) return HAL_ERROR;
+    return MPU6050_WriteRegister(MPU6050_USER_CTRL, MPU6050_USER_CTRL_FIFO_EN);
+}
+
+/**
+ * @brief Drains complete accel + gyro frames from the FIFO in I2C bursts.
+ */
+HAL_StatusTypeDef mpu6050_read_fifo(imu_sample_t *slots, uint16_t max_frames, uint16_t *count)
+{
+    uint8_t buffer[MPU6050_FIFO_CHUNK_FRAMES * MPU6050_FIFO_FRAME_BYTES];
+    uint8_t count_bytes[2];
+    
+    *count = 0;
+    if (i2c_mem_read(MPU6050_I2C_ADDR, MPU6050_FIFO_COUNTH, count_bytes, 2) != HAL_OK) return HAL_ERROR;
+    uint16_t fifo_bytes = (uint16_t)(count_bytes[0] << 8 | count_bytes[1]);
+    uint32_t now_us = timebase_get_us();
+    
+    // A full FIFO has overwritten old data and lost frame alignment (1024 is not
+    // a multiple of 12): flush it and resume on the next frame boundary
+    if (fifo_bytes > MPU6050_FIFO_SIZE - MPU6050_FIFO_FRAME_BYTES)
+    {
+        return mpu6050_fifo_reset();
+    }
+    
+    uint16_t queued = fifo_bytes / MPU6050_FIFO_FRAME_BYTES;
+    if (queued == 0) return HAL_OK;
+    uint16_t available = queued;
+    if (available > max_frames) available = max_frames;
+    
+    // The newest queued frame was sampled about now, older ones one output period apart
+    const uint32_t frame_us = 1000000U / IMU_OVERSAMPLE_HZ;
+    uint32_t oldest_us = now_us - (uint32_t)(queued - 1U) * frame_us;
+    
+    while (*count < available)
+    {
+        uint16_t chunk = available - *count;
+        if (chunk > MPU6050_FIFO_CHUNK_FRAMES) chunk = MPU6050_FIFO_CHUNK_FRAMES;
+        
+        // FIFO_R_W does not auto-increment, a burst read keeps popping the FIFO
+        if (i2c_mem_read(MPU6050_I2C_ADDR, MPU6050_FIFO_R_W, buffer, chunk * MPU6050_FIFO_FRAME_BYTES) != HAL_OK) return HAL_ERROR;
+        
+        for (uint16_t i = 0; i < chunk; i++)
+        {
+            const uint8_t *f = &buffer[i * MPU6050_FIFO_FRAME_BYTES];
+            MPU6050_RawData_t *out = &slots[*count + i].raw;
+            out->accel_x = (int16_t)(f[0] << 8 | f[1]);
+            out->accel_y = (int16_t)(f[2] << 8 | f[3]);
+            out->accel_z = (int16_t)(f[4] << 8 | f[5]);
+            out->gyro_x = (int16_t)(f[6] << 8 | f[7]);
+            out->gyro_y = (int16_t)(f[8] << 8 | f[9]);
+            out->gyro_z = (int16_t)(f[10] << 8 | f[11]);
+            out->timestamp_us = oldest_us + (uint32_t)(*count + i) * frame_us;
+        }
+        *count += chunk;
+    }
+    
     return HAL_OK;
 }
 
@@ -79,8 +183,9 @@ HAL_StatusTypeDef mpu6050_init(void)
 HAL_StatusTypeDef mpu6050_read_raw(MPU6050_RawData_t *rawData)
 {
     uint8_t buffer[14];
+    rawData->timestamp_us = timebase_get_us();
     if (i2c_mem_read(MPU6050_I2C_ADDR, MPU6050_ACCEL_XOUT_H, buffer, 14) != HAL_OK) return HAL_ERROR;
-
+    
     rawData->accel_x = (int16_t)(buffer[0] << 8 | buffer[1]);
     rawData->accel_y = (int16_t)(buffer[2] << 8 | buffer[3]);
     rawData->accel_z = (int16_t)(buffer[4] << 8 | buffer[5]);
@@ -88,7 +193,7 @@ HAL_StatusTypeDef mpu6050_read_raw(MPU6050_RawData_t *rawData)
     rawData->gyro_x = (int16_t)(buffer[8] << 8 | buffer[9]);
     rawData->gyro_y = (int16_t)(buffer[10] << 8 | buffer[11]);
     rawData->gyro_z = (int16_t)(buffer[12] << 8 | buffer[13]);
-
+    
     return HAL_OK;
 }
 
@@ -101,9 +206,9 @@ HAL_StatusTypeDef mpu6050_calibrate(void)
     long sum_accel[3] = {0, 0, 0};
     long sum_gyro[3] = {0, 0, 0};
     const uint16_t num_samples = 500;
-
+    
     // TODO: Add a delay here for stability before calibration starts
-
+    
     for (uint16_t i = 0; i < num_samples; i++)
     {
         if (mpu6050_read_raw(&raw) != HAL_OK) return HAL_ERROR;
@@ -115,16 +220,17 @@ HAL_StatusTypeDef mpu6050_calibrate(void)
         sum_gyro[2] += raw.gyro_z;
         HAL_Delay(5); // Small delay between samples
     }
-
+    
     // Compute biases (accel bias is effectively gravity vector)
     accel_bias[0] = (float)sum_accel[0] / num_samples / ACCEL_SCALE_FACTOR;
     accel_bias[1] = (float)sum_accel[1] / num_samples / ACCEL_SCALE_FACTOR;
     accel_bias[2] = (float)sum_accel[2] / num_samples / ACCEL_SCALE_FACTOR;
-
+    
     gyro_bias[0] = (float)sum_gyro[0] / num_samples / GYRO_SCALE_FACTOR;
     gyro_bias[1] = (float)sum_gyro[1] / num_samples / GYRO_SCALE_FACTOR;
     gyro_bias[2] = (float)sum_gyro[2] / num_samples / GYRO_SCALE_FACTOR;
-
+    update_gyro_bias_raw();
+    
     return HAL_OK;
 }
 
@@ -133,12 +239,55 @@ HAL_StatusTypeDef mpu6050_calibrate(void)
  */
 void mpu6050_convert_to_scaled(const MPU6050_RawData_t *rawData, MPU6050_ScaledData_t *scaledData)
 {
-    scaledData->accel_x_g = (float)rawData->accel_x / ACCEL_SCALE_FACTOR - accel_bias[0];
-    scaledData->accel_y_g = (float)rawData->accel_y / ACCEL_SCALE_FACTOR - accel_bias[1];
-    scaledData->accel_z_g = (float)rawData->accel_z / ACCEL_SCALE_FACTOR - accel_bias[2] + 1.0f; // Assume Z is aligned with gravity and remove 1g offset
+    // Everything is read before the first store, so raw and scaled may share a slot
+    const MPU6050_RawData_t raw = *rawData;
+    
+    scaledData->accel_x_g = (float)raw.accel_x / ACCEL_SCALE_FACTOR - accel_bias[0];
+    scaledData->accel_y_g = (float)raw.accel_y / ACCEL_SCALE_FACTOR - accel_bias[1];
+    scaledData->accel_z_g = (float)raw.accel_z / ACCEL_SCALE_FACTOR - accel_bias[2] + 1.0f; // Assume Z is aligned with gravity and remove 1g offset
+    
+    scaledData->gyro_x_deg_s = (float)raw.gyro_x / GYRO_SCALE_FACTOR - gyro_bias[0];
+    scaledData->gyro_y_deg_s = (float)raw.gyro_y / GYRO_SCALE_FACTOR - gyro_bias[1];
+    scaledData->gyro_z_deg_s = (float)raw.gyro_z / GYRO_SCALE_FACTOR - gyro_bias[2];
+    scaledData->timestamp_us = raw.timestamp_us;
+}
+
+/**
+ * @brief Scales a ring slot in place (raw -> scaled).
+ */
+void mpu6050_scale_sample(imu_sample_t *sample)
+{
+    mpu6050_convert_to_scaled(&sample->raw, &sample->scaled);
+}
 
-    scaledData->gyro_x_deg_s = (float)rawData->gyro_x / GYRO_SCALE_FACTOR - gyro_bias[0];
-    scaledData->gyro_y_deg_s = (float)rawData->gyro_y / GYRO_SCALE_FACTOR - gyro_bias[1];
-    scaledData->gyro_z_deg_s = (float)rawData->gyro_z / GYRO_SCALE_FACTOR - gyro_bias[2];
+/**
+ * @brief Gets the gyro bias removed by mpu6050_convert_to_scaled().
+ */
+void mpu6050_get_gyro_bias(float bias[3])
+{
+    bias[0] = gyro_bias[0];
+    bias[1] = gyro_bias[1];
+    bias[2] = gyro_bias[2];
+}
+
+/**
+ * @brief Sets the gyro bias removed by mpu6050_convert_to_scaled().
+ */
+void mpu6050_set_gyro_bias(const float bias[3])
+{
+    gyro_bias[0] = bias[0];
+    gyro_bias[1] = bias[1];
+    gyro_bias[2] = bias[2];
+    update_gyro_bias_raw();
+}
+
+/**
+ * @brief Gets the gyro bias removed by mpu6050_convert_to_scaled(), in raw units.
+ */
+void mpu6050_get_gyro_bias_raw(int32_t bias[3])
+{
+    bias[0] = gyro_bias_raw[0];
+    bias[1] = gyro_bias_raw[1];
+    bias[2] = gyro_bias_raw[2];
 }
 
@@ -4,6 +4,12 @@
 #include "stm32f1xx_hal.h"
 
 #define MPU6050_I2C_ADDR    (0x68 << 1) // 0xD0
+#define MPU6050_FIFO_FRAME_BYTES 12     // Accel XYZ + gyro XYZ per FIFO frame
+
+// Sensitivity at the ranges set by mpu6050_init()
+#define MPU6050_ACCEL_LSB_PER_G   16384 // +/- 2 g
+#define MPU6050_GYRO_LSB_PER_DPS  131   // +/- 250 deg/s
+#define MPU6050_GYRO_BIAS_FRAC    4     // Fraction bits of the raw gyro bias
 
 typedef struct {
     int16_t accel_x;
@@ -12,6 +18,7 @@ typedef struct {
     int16_t gyro_x;
     int16_t gyro_y;
     int16_t gyro_z;
+    uint32_t timestamp_us;  // Sample time on the microsecond timebase
 } MPU6050_RawData_t;
 
 typedef struct {
@@ -21,14 +28,44 @@ typedef struct {
     float gyro_x_deg_s;
     float gyro_y_deg_s;
     float gyro_z_deg_s;
+    uint32_t timestamp_us;  // Sample time on the microsecond timebase
 } MPU6050_ScaledData_t;
 
+// One sample slot of the acquisition ring. The driver fills raw; every later
+// stage rewrites the slot in place (decimation, filtering, which also scales
+// it) and adds only the fields the stages after it read.
+typedef struct {
+    union {
+        MPU6050_RawData_t raw;        // Acquisition and decimation
+        MPU6050_ScaledData_t scaled;  // After imu_filters (mpu6050_scale_sample())
+    };
+    uint32_t dt_us;          // Interval to the previous sample
+    float gyro_filtered[3];  // Smoothed rate (deg/s)
+    float rep_signal;        // Band-limited rep signal of the selected exercise
+} imu_sample_t;
+
 /**
  * @brief Initializes the MPU-6050 sensor.
  * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
  */
 HAL_StatusTypeDef mpu6050_init(void);
 
+/**
+ * @brief Flushes the FIFO and re-enables it (oversampling mode).
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef mpu6050_fifo_reset(void);
+
+/**
+ * @brief Drains complete accel + gyro frames from the FIFO (oversampling mode).
+ *        An overflowed FIFO is flushed and reports zero frames.
+ * @param slots Ring slots whose raw frames are written, oldest first.
+ * @param max_frames Capacity of slots.
+ * @param count Number of frames written.
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef mpu6050_read_fifo(imu_sample_t *slots, uint16_t max_frames, uint16_t *count);
+
 /**
  * @brief Reads raw accelerometer and gyroscope data from MPU-6050.
  * @param rawData Pointer to MPU6050_RawData_t struct to store data.
@@ -50,5 +87,32 @@ HAL_StatusTypeDef mpu6050_calibrate(void);
  */
 void mpu6050_convert_to_scaled(const MPU6050_RawData_t *rawData, MPU6050_ScaledData_t *scaledData);
 
+/**
+ * @brief Scales a ring slot in place (raw -> scaled).
+ * @param sample Slot holding a raw frame.
+ */
+void mpu6050_scale_sample(imu_sample_t *sample);
+
+/**
+ * @brief Gets the gyro bias removed by mpu6050_convert_to_scaled().
+ * @param bias Filled with the x, y, z bias in deg/s.
+ */
+void mpu6050_get_gyro_bias(float bias[3]);
+
+/**
+ * @brief Sets the gyro bias removed by mpu6050_convert_to_scaled().
+ * @param bias Bias in deg/s (x, y, z), e.g. restored from flash.
+ */
+void mpu6050_set_gyro_bias(const float bias[3]);
+
+/**
+ * @brief Gets the gyro bias removed by mpu6050_convert_to_scaled(), in raw
+ *        units, for fixed-point consumers of the raw frame. The raw accel
+ *        needs no offset there: the scaled path's calibration offsets and
+ *        +1 g on Z only hold in the calibration pose.
+ * @param bias Filled with the x, y, z bias in 1/2^MPU6050_GYRO_BIAS_FRAC LSB.
+ */
+void mpu6050_get_gyro_bias_raw(int32_t bias[3]);
+
 #endif // MPU6050_H
 
@@ -0,0 +1,84 @@
+#include "timebase.h"
+#include "clock_ctrl.h"
+
+static TIM_HandleTypeDef htim2;
+static TIM_HandleTypeDef htim3;
+
+/**
+ * @brief Starts the chained TIM2/TIM3 microsecond counter.
+ */
+HAL_StatusTypeDef timebase_init(void)
+{
+    TIM_MasterConfigTypeDef master = {0};
+    TIM_SlaveConfigTypeDef slave = {0};
+    
+    __HAL_RCC_TIM2_CLK_ENABLE();
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    
+    // TIM2: 1 MHz, full 16-bit period, update event drives TRGO
+    htim2.Instance = TIM2;
+    htim2.Init.Prescaler = (clock_ctrl_get_apb1_timer_hz() / TIMEBASE_TICK_HZ) - 1U;
+    htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim2.Init.Period = 0xFFFF;
+    htim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    if (HAL_TIM_Base_Init(&htim2) != HAL_OK) return HAL_ERROR;
+    
+    master.MasterOutputTrigger = TIM_TRGO_UPDATE;
+    master.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+    if (HAL_TIMEx_MasterConfigSynchronization(&htim2, &master) != HAL_OK) return HAL_ERROR;
+    
+    // TIM3: counts TIM2 overflows (ITR1 = TIM2 TRGO), upper 16 bits
+    htim3.Instance = TIM3;
+    htim3.Init.Prescaler = 0;
+    htim3.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim3.Init.Period = 0xFFFF;
+    htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    if (HAL_TIM_Base_Init(&htim3) != HAL_OK) return HAL_ERROR;
+    
+    slave.SlaveMode = TIM_SLAVEMODE_EXTERNAL1;
+    slave.InputTrigger = TIM_TS_ITR1;
+    if (HAL_TIM_SlaveConfigSynchro(&htim3, &slave) != HAL_OK) return HAL_ERROR;
+    
+    // Start the slave first so no TIM2 overflow is missed
+    if (HAL_TIM_Base_Start(&htim3) != HAL_OK) return HAL_ERROR;
+    return HAL_TIM_Base_Start(&htim2);
+}
+
+/**
+ * @brief Recomputes the prescaler and resumes counting from resume_us.
+ *        The time spent in the clock switch itself (PLL lock) is not counted.
+ */
+void timebase_reconfigure(uint32_t resume_us)
+{
+    __HAL_TIM_DISABLE(&htim2);
+    
+    // PSC is preloaded: force an update to apply it now (this also pulses TRGO,
+    // which is why both counters are rewritten afterwards)
+    TIM2->PSC = (clock_ctrl_get_apb1_timer_hz() / TIMEBASE_TICK_HZ) - 1U;
+    TIM2->EGR = TIM_EGR_UG;
+    TIM2->CNT = resume_us & 0xFFFFU;
+    TIM3->CNT = resume_us >> 16;
+    TIM2->SR = 0;
+    
+    __HAL_TIM_ENABLE(&htim2);
+}
+
+/**
+ * @brief Gets the current time in microseconds.
+ */
+uint32_t timebase_get_us(void)
+{
+    uint32_t hi;
+    uint32_t lo;
+    
+    // Re-read if TIM2 overflowed between the two halves
+    do
+    {
+        hi = TIM3->CNT;
+        lo = TIM2->CNT;
+    } while (hi != TIM3->CNT);
+    
+    return (hi << 16) | lo;
+}
@@ -0,0 +1,30 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include "stm32f1xx_hal.h"
+#include <stdint.h>
+
+// Free-running microsecond timebase: TIM2 counts microseconds and its update
+// event clocks TIM3 (slave, ITR1), giving a 32-bit count that wraps every ~71.6 min
+#define TIMEBASE_TICK_HZ 1000000U
+
+/**
+ * @brief Starts the chained TIM2/TIM3 microsecond counter.
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef timebase_init(void);
+
+/**
+ * @brief Recomputes the prescaler for the current APB1 timer clock and resumes
+ *        counting from resume_us. Call after every system clock change.
+ * @param resume_us Timebase value read just before the clock change.
+ */
+void timebase_reconfigure(uint32_t resume_us);
+
+/**
+ * @brief Gets the current time in microseconds (wrap-safe differences only).
+ * @retval uint32_t Microsecond count.
+ */
+uint32_t timebase_get_us(void);
+
+#endif // TIMEBASE_H
@@ -0,0 +1,145 @@
+#include "uart_link.h"
+#include "app_config.h"
+#include "mcu_pinmap.h"
+
+#if ENABLE_HOST_PROTO
+
+#define RX_MASK (UART_LINK_RX_SIZE - 1U)
+#define TX_MASK (UART_LINK_TX_SIZE - 1U)
+
+_Static_assert((UART_LINK_RX_SIZE & RX_MASK) == 0, "UART_LINK_RX_SIZE must be a power of two");
+_Static_assert((UART_LINK_TX_SIZE & TX_MASK) == 0, "UART_LINK_TX_SIZE must be a power of two");
+
+// Single producer (interrupt) / single consumer (main loop) ring
+static uint8_t rx_ring[UART_LINK_RX_SIZE];
+static volatile uint16_t rx_head = 0;
+static volatile uint16_t rx_tail = 0;
+static volatile uint32_t rx_dropped = 0;
+
+// Single producer (main loop) / single consumer (interrupt) ring
+static uint8_t tx_ring[UART_LINK_TX_SIZE];
+static volatile uint16_t tx_head = 0;
+static volatile uint16_t tx_tail = 0;
+
+/**
+ * @brief Initializes USART2 with interrupt-driven reception.
+ */
+HAL_StatusTypeDef uart_link_init(void)
+{
+    rx_head = 0;
+    rx_tail = 0;
+    tx_head = 0;
+    tx_tail = 0;
+    
+    __HAL_RCC_USART2_CLK_ENABLE();
+    huart2.Instance = USART2;
+    huart2.Init.BaudRate = 115200;
+    huart2.Init.WordLength = UART_WORDLENGTH_8B;
+    huart2.Init.StopBits = UART_STOPBITS_1;
+    huart2.Init.Parity = UART_PARITY_NONE;
+    huart2.Init.Mode = UART_MODE_TX_RX;
+    huart2.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    huart2.Init.OverSampling = UART_OVERSAMPLING_16;
+    if (HAL_UART_Init(&huart2) != HAL_OK) return HAL_ERROR;
+    
+    // HAL_UART_Init (also run on clock profile switches) leaves RXNEIE alone
+    USART2->CR1 |= USART_CR1_RXNEIE;
+    HAL_NVIC_SetPriority(USART2_IRQn, 6, 0);
+    HAL_NVIC_EnableIRQ(USART2_IRQn);
+    return HAL_OK;
+}
+
+/**
+ * @brief Takes received bytes out of the ring.
+ */
+uint16_t uart_link_read(uint8_t *buf, uint16_t max)
+{
+    uint16_t count = 0;
+    uint16_t tail = rx_tail;
+    
+    while (count < max && tail != rx_head)
+    {
+        buf[count++] = rx_ring[tail];
+        tail = (tail + 1U) & RX_MASK;
+    }
+    rx_tail = tail;
+    return count;
+}
+
+/**
+ * @brief Queues bytes for transmission.
+ */
+HAL_StatusTypeDef uart_link_write(const uint8_t *buf, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++)
+    {
+        uint16_t next = (tx_head + 1U) & TX_MASK;
+        while (next == tx_tail)
+        {
+            // Full: let the interrupt drain it
+            USART2->CR1 |= USART_CR1_TXEIE;
+        }
+        tx_ring[tx_head] = buf[i];
+        tx_head = next;
+    }
+    
+    // The interrupt clears TXEIE once the ring is empty
+    USART2->CR1 |= USART_CR1_TXEIE;
+    return HAL_OK;
+}
+
+/**
+ * @brief Gets the room left in the transmit ring.
+ */
+uint16_t uart_link_tx_free(void)
+{
+    return (uint16_t)((tx_tail - tx_head - 1U) & TX_MASK);
+}
+
+/**
+ * @brief Gets the number of received bytes dropped because the ring was full.
+ */
+uint32_t uart_link_get_dropped(void)
+{
+    return rx_dropped;
+}
+
+/**
+ * @brief USART2 interrupt: moves the received byte into the ring and the
+ *        next queued byte out.
+ */
+void USART2_IRQHandler(void)
+{
+    uint32_t sr = USART2->SR;
+    
+    // Reading DR also clears an overrun
+    if (sr & (USART_SR_RXNE | USART_SR_ORE))
+    {
+        uint8_t byte = (uint8_t)USART2->DR;
+        uint16_t next = (rx_head + 1U) & RX_MASK;
+        if (next != rx_tail)
+        {
+            rx_ring[rx_head] = byte;
+            rx_head = next;
+        }
+        else
+        {
+            rx_dropped++;
+        }
+    }
+    
+    if ((sr & USART_SR_TXE) && (USART2->CR1 & USART_CR1_TXEIE))
+    {
+        if (tx_tail != tx_head)
+        {
+            USART2->DR = tx_ring[tx_tail];
+            tx_tail = (tx_tail + 1U) & TX_MASK;
+        }
+        else
+        {
+            USART2->CR1 &= ~USART_CR1_TXEIE;
+        }
+    }
+}
+
+#endif // ENABLE_HOST_PROTO
@@ -0,0 +1,46 @@
+#ifndef UART_LINK_H
+#define UART_LINK_H
+
+#include "stm32f1xx_hal.h"
+#include <stdint.h>
+
+// USART2 receive ring filled from the RXNE interrupt, transmit ring drained
+// by the TXE interrupt (powers of two)
+#define UART_LINK_RX_SIZE 256
+#define UART_LINK_TX_SIZE 512
+
+/**
+ * @brief Initializes USART2 (115200 8N1) with interrupt-driven reception.
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef uart_link_init(void);
+
+/**
+ * @brief Takes received bytes out of the ring.
+ * @param buf Destination buffer.
+ * @param max Capacity of buf.
+ * @retval uint16_t Number of bytes copied.
+ */
+uint16_t uart_link_read(uint8_t *buf, uint16_t max);
+
+/**
+ * @brief Queues bytes for transmission; waits only while the ring is full.
+ * @param buf Data to send.
+ * @param len Number of bytes.
+ * @retval HAL_StatusTypeDef HAL_OK if successful, HAL_ERROR otherwise.
+ */
+HAL_StatusTypeDef uart_link_write(const uint8_t *buf, uint16_t len);
+
+/**
+ * @brief Gets the room left in the transmit ring.
+ * @retval uint16_t Bytes that uart_link_write() queues without waiting.
+ */
+uint16_t uart_link_tx_free(void);
+
+/**
+ * @brief Gets the number of received bytes dropped because the ring was full.
+ * @retval uint32_t Dropped byte count since boot.
+ */
+uint32_t uart_link_get_dropped(void);
+
+#endif // UART_LINK_H
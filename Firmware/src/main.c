@@ -9,10 +9,14 @@
 #include "log_uart.h"
 #include "app_controller.h"
 #include "exercise_config.h"
+#include "clock_ctrl.h"
+#include "timebase.h"
+#include "button.h"
+#include "uart_link.h"
 
 // Global HAL handles
 I2C_HandleTypeDef hi2c1;
-#ifdef ENABLE_LOG_UART
+#if ENABLE_LOG_UART || ENABLE_HOST_PROTO
 UART_HandleTypeDef huart2;
 #endif
 
@@ -34,16 +38,36 @@ int main(void)
     // Initialize GPIO
     GPIO_Init();
     
+    // Start the microsecond sample timebase
+    if (timebase_init() != HAL_OK)
+    {
+        Error_Handler();
+    }
+    
+    // Push button: EXTI + TIM4 debounce, events consumed by the app controller
+    if (button_init() != HAL_OK)
+    {
+        Error_Handler();
+    }
+    
     // Initialize I2C bus
     if (i2c_bus_init() != HAL_OK)
     {
         Error_Handler();
     }
-    
-#ifdef ENABLE_LOG_UART
+
+#if ENABLE_LOG_UART
     // Initialize optional UART logging
     log_uart_init();
 #endif
+
+#if ENABLE_HOST_PROTO
+    // Host protocol link (parameter tuning) on USART2
+    if (uart_link_init() != HAL_OK)
+    {
+        Error_Handler();
+    }
+#endif
     
     // Initialize MPU-6050
     if (mpu6050_init() != HAL_OK)
@@ -63,49 +87,31 @@ int main(void)
     // Initialize application controller
     app_controller_init();
     
+    // Start load measurement for dynamic clock scaling
+    clock_ctrl_init();
+    
     // Main application loop
     while (1)
     {
+        clock_ctrl_busy_begin();
         app_controller_loop();
+        clock_ctrl_busy_end();
+        
+        // Re-evaluate clock profile between pipeline passes (no bus transfer in flight)
+        clock_ctrl_update();
         
-        // Small delay to prevent tight loop
-        HAL_Delay(1);
+        // Sleep until the next SysTick interrupt instead of spinning
+        __WFI();
     }
 }
 
 /**
- * @brief Configures the system clock to 72 MHz.
+ * @brief Configures the system clock to 72 MHz (full-speed profile).
  */
 static void SystemClock_Config(void)
 {
-    RCC_OscInitTypeDef RCC_OscInitStruct = {0};
-    RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
-
-    // Configure the main internal regulator output voltage
-    // Note: STM32F1 doesn't have PWREx functions, so we skip this step
-
-    // Initializes the RCC Oscillators according to the specified parameters
-    RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSE;
-    RCC_OscInitStruct.HSEState = RCC_HSE_ON;
-    RCC_OscInitStruct.HSEPredivValue = RCC_HSE_PREDIV_DIV1;
-    RCC_OscInitStruct.HSIState = RCC_HSI_ON;
-    RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
-    RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
-    RCC_OscInitStruct.PLL.PLLMUL = RCC_PLL_MUL9;
-    if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
-    {
-        Error_Handler();
-    }
-
-    // Initializes the CPU, AHB and APB buses clocks
-    RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
-                                |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
-    RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
-    RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
-    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV2;
-    RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
-
-    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_2) != HAL_OK)
+    // Boot at full speed; clock_ctrl drops to the low-power profile once the load allows
+    if (clock_ctrl_apply_rcc(CLOCK_PROFILE_FULL_SPEED) != HAL_OK)
     {
         Error_Handler();
     }
@@ -117,11 +123,11 @@ static void SystemClock_Config(void)
 static void GPIO_Init(void)
 {
     GPIO_InitTypeDef GPIO_InitStruct = {0};
-
+    
     // Enable GPIO clocks
     __HAL_RCC_GPIOA_CLK_ENABLE();
     __HAL_RCC_GPIOB_CLK_ENABLE();
-
+    
     // Configure I2C1 pins (PB6=SCL, PB7=SDA)
     GPIO_InitStruct.Pin = I2C1_SCL_PIN | I2C1_SDA_PIN;
     GPIO_InitStruct.Mode = GPIO_MODE_AF_OD;
@@ -129,13 +135,19 @@ static void GPIO_Init(void)
     GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
     HAL_GPIO_Init(I2C1_SCL_GPIO_PORT, &GPIO_InitStruct);
 
-#ifdef ENABLE_LOG_UART
+#if ENABLE_LOG_UART || ENABLE_HOST_PROTO
     // Configure UART2 pins (PA2=TX, PA3=RX)
-    GPIO_InitStruct.Pin = UART2_TX_PIN | UART2_RX_PIN;
+    GPIO_InitStruct.Pin = UART2_TX_PIN;
     GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
     GPIO_InitStruct.Pull = GPIO_NOPULL;
     GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
     HAL_GPIO_Init(UART2_TX_GPIO_PORT, &GPIO_InitStruct);
+    
+    // RX is an input; pull-up keeps an unconnected line idle
+    GPIO_InitStruct.Pin = UART2_RX_PIN;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_INPUT;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(UART2_RX_GPIO_PORT, &GPIO_InitStruct);
 #endif
 }
 
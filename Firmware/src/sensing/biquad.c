@@ -0,0 +1,91 @@
+#include "biquad.h"
+
+#define RESIDUE_MASK ((1U << BIQUAD_COEFF_Q) - 1U)
+
+void biquad_reset(biquad_state_t *state, uint8_t stages)
+{
+    for (uint8_t i = 0; i < stages; i++) {
+        state[i].x1 = 0;
+        state[i].x2 = 0;
+        state[i].y1 = 0;
+        state[i].y2 = 0;
+        state[i].residue = 0;
+    }
+}
+
+/**
+ * Runs one sample through a cascade of integer Direct-Form-I biquads.
+ *
+ * Each stage is five 32x32->64 multiply-accumulates (SMLAL on the M3) into a
+ * single 64-bit accumulator; negated feedback coefficients keep every term
+ * an accumulate. The bits dropped by the final shift are fed back into the
+ * next sample, which keeps low-cutoff stages free of DC offset and limit cycles.
+ */
+int32_t biquad_cascade(const biquad_coeffs_t *coeffs, biquad_state_t *state, uint8_t stages, int32_t x)
+{
+    for (uint8_t i = 0; i < stages; i++) {
+        const biquad_coeffs_t *c = &coeffs[i];
+        biquad_state_t *s = &state[i];
+        
+        int64_t acc = (int64_t)s->residue;
+        acc += (int64_t)c->b0 * x;
+        acc += (int64_t)c->b1 * s->x1;
+        acc += (int64_t)c->b2 * s->x2;
+        acc += (int64_t)c->na1 * s->y1;
+        acc += (int64_t)c->na2 * s->y2;
+        
+        int32_t y = (int32_t)(acc >> BIQUAD_COEFF_Q);
+        s->residue = (uint32_t)acc & RESIDUE_MASK;
+        
+        s->x2 = s->x1;
+        s->x1 = x;
+        s->y2 = s->y1;
+        s->y1 = y;
+        x = y;
+    }
+    return x;
+}
+
+/**
+ * Runs a block of samples through the cascade in place.
+ *
+ * Stage-major: each stage's coefficients and history are loaded once and
+ * stay in registers for the whole block, instead of being reloaded and
+ * stored back for every sample. Bit-exact with n calls to biquad_cascade().
+ */
+void biquad_cascade_block(const biquad_coeffs_t *coeffs, biquad_state_t *state, uint8_t stages,
+                          int32_t *buf, uint16_t n)
+{
+    for (uint8_t i = 0; i < stages; i++) {
+        const int32_t b0 = coeffs[i].b0, b1 = coeffs[i].b1, b2 = coeffs[i].b2;
+        const int32_t na1 = coeffs[i].na1, na2 = coeffs[i].na2;
+        int32_t x1 = state[i].x1, x2 = state[i].x2;
+        int32_t y1 = state[i].y1, y2 = state[i].y2;
+        uint32_t residue = state[i].residue;
+        
+        for (uint16_t k = 0; k < n; k++) {
+            int32_t x = buf[k];
+            int64_t acc = (int64_t)residue;
+            acc += (int64_t)b0 * x;
+            acc += (int64_t)b1 * x1;
+            acc += (int64_t)b2 * x2;
+            acc += (int64_t)na1 * y1;
+            acc += (int64_t)na2 * y2;
+            
+            int32_t y = (int32_t)(acc >> BIQUAD_COEFF_Q);
+            residue = (uint32_t)acc & RESIDUE_MASK;
+            
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = y;
+            buf[k] = y;
+        }
+        
+        state[i].x1 = x1;
+        state[i].x2 = x2;
+        state[i].y1 = y1;
+        state[i].y2 = y2;
+        state[i].residue = residue;
+    }
+}
@@ -0,0 +1,137 @@
+#include "cadence.h"
+#include "rep_detect.h"
+#include "app_config.h"
+#include "exercise_config.h"
+
+#define DECIM_FACTOR (IMU_SAMPLE_HZ / CADENCE_HZ)
+#define SAMPLE_Q     10  // History in Q10 g, products stay below 2^28
+
+#if (IMU_SAMPLE_HZ % CADENCE_HZ) != 0
+#error "IMU_SAMPLE_HZ must be a multiple of CADENCE_HZ"
+#endif
+
+// Decimated history, written twice so the last CADENCE_MAX_LAG samples are contiguous
+static int16_t history[2 * (CADENCE_MAX_LAG + 1)];
+static uint8_t history_pos = 0;
+static uint8_t history_len = 0;
+static int32_t decim_sum = 0;
+static uint8_t decim_phase = 0;
+
+// Exponentially averaged autocorrelation, [0] is the signal energy
+static int32_t corr[CADENCE_MAX_LAG + 1];
+
+// Current estimate (0 = not confident)
+static uint16_t period_ms = 0;
+
+void cadence_reset(void)
+{
+    for (int k = 0; k <= CADENCE_MAX_LAG; k++) corr[k] = 0;
+    history_pos = 0;
+    history_len = 0;
+    decim_sum = 0;
+    decim_phase = 0;
+    period_ms = 0;
+}
+
+/**
+ * Picks the rep period from the averaged autocorrelation: the first local
+ * maximum within 80 % of the strongest one (so 2x and 3x the period do not
+ * win), refined between lags with a parabolic fit.
+ */
+static void estimate_period(void)
+{
+    // Signal energy must clear the detector's noise floor
+    const int32_t floor_q = (int32_t)(MIN_SIGMA_FLOOR_G * (1 << SAMPLE_Q));
+    if (corr[0] <= floor_q * floor_q) {
+        period_ms = 0;
+        return;
+    }
+    
+    int32_t best = 0;
+    for (int k = CADENCE_MIN_LAG; k < CADENCE_MAX_LAG; k++) {
+        if (corr[k] > corr[k - 1] && corr[k] >= corr[k + 1] && corr[k] > best) best = corr[k];
+    }
+    if ((float)best < CADENCE_MIN_CORR * (float)corr[0]) {
+        period_ms = 0;
+        return;
+    }
+    
+    int32_t accept = best - (best >> 2) + (best >> 4);  // ~0.81 * best
+    for (int k = CADENCE_MIN_LAG; k < CADENCE_MAX_LAG; k++) {
+        if (corr[k] > corr[k - 1] && corr[k] >= corr[k + 1] && corr[k] >= accept) {
+            float ym = (float)corr[k - 1];
+            float y0 = (float)corr[k];
+            float yp = (float)corr[k + 1];
+            float denom = ym - 2.0f * y0 + yp;
+            float delta = denom < 0.0f ? 0.5f * (ym - yp) / denom : 0.0f;
+            period_ms = (uint16_t)(((float)k + delta) * (1000.0f / CADENCE_HZ) + 0.5f);
+            return;
+        }
+    }
+    period_ms = 0;
+}
+
+/**
+ * Feeds one rep signal sample (IMU_SAMPLE_HZ). Every DECIM_FACTOR samples the
+ * autocorrelation at every lag takes one exponential-average step: a fixed
+ * CADENCE_MAX_LAG + 1 multiply-accumulates at CADENCE_HZ, whatever the history.
+ */
+void cadence_update(float sample)
+{
+    float scaled = sample * (float)(1 << SAMPLE_Q);
+    if (scaled > 16383.0f) scaled = 16383.0f;
+    if (scaled < -16383.0f) scaled = -16383.0f;
+    decim_sum += (int32_t)scaled;
+    if (++decim_phase < DECIM_FACTOR) return;
+    
+    int16_t x = (int16_t)(decim_sum / DECIM_FACTOR);
+    decim_sum = 0;
+    decim_phase = 0;
+    
+    history[history_pos] = x;
+    history[history_pos + CADENCE_MAX_LAG + 1] = x;
+    if (++history_pos > CADENCE_MAX_LAG) history_pos = 0;
+    if (history_len <= CADENCE_MAX_LAG) {
+        history_len++;
+        return;
+    }
+    
+    // past[CADENCE_MAX_LAG] is the newest sample, past[CADENCE_MAX_LAG - k] is k samples older
+    const int16_t *past = &history[history_pos];
+    for (int k = 0; k <= CADENCE_MAX_LAG; k++) {
+        int32_t p = (int32_t)x * past[CADENCE_MAX_LAG - k];
+        corr[k] += (p - corr[k]) >> CADENCE_EMA_SHIFT;
+    }
+    
+    estimate_period();
+}
+
+/**
+ * Gets the tracked rep period; false while the cadence is not confident.
+ */
+bool cadence_get_period_ms(uint16_t *out_period_ms)
+{
+    if (period_ms == 0) return false;
+    if (out_period_ms) *out_period_ms = period_ms;
+    return true;
+}
+
+/**
+ * Refractory window following the tracked period, or default_ms (the
+ * exercise's refractory_ms) while the cadence is unknown.
+ */
+uint16_t cadence_refractory_ms(uint16_t default_ms)
+{
+    if (period_ms == 0) return default_ms;
+    return (uint16_t)(CADENCE_REFRACTORY_FRAC * period_ms);
+}
+
+/**
+ * Minimum spacing between counted peaks, never below default_ms.
+ */
+uint16_t cadence_min_peak_gap_ms(uint16_t default_ms)
+{
+    if (period_ms == 0) return default_ms;
+    uint16_t gap = (uint16_t)(CADENCE_PEAK_GAP_FRAC * period_ms);
+    return gap > default_ms ? gap : default_ms;
+}
@@ -0,0 +1,107 @@
+#include "cic_decim.h"
+#include "app_config.h"
+
+#define CIC_CHANNELS 6
+#define CIC_GAIN ((int32_t)(IMU_DECIMATION * IMU_DECIMATION * IMU_DECIMATION))
+
+// 16-bit input plus 3*log2(R) bits of growth must fit in the 32-bit registers
+#if IMU_DECIMATION < 1 || IMU_DECIMATION > 32
+#error "IMU_DECIMATION out of range for a 32-bit order-3 CIC"
+#endif
+
+// Integrator and comb delay lines per axis. Unsigned so the integrators wrap
+// modulo 2^32; the comb differences are still exact because the true output
+// fits in 32 bits.
+static uint32_t integrator[CIC_CHANNELS][CIC_ORDER];
+static uint32_t comb_delay[CIC_CHANNELS][CIC_ORDER];
+static uint8_t phase = 0;
+static uint32_t block_cycles = 0;
+static uint32_t cycles_max = 0;
+
+void cic_decim_reset(void)
+{
+    for (int ch = 0; ch < CIC_CHANNELS; ch++) {
+        for (int s = 0; s < CIC_ORDER; s++) {
+            integrator[ch][s] = 0;
+            comb_delay[ch][s] = 0;
+        }
+    }
+    phase = 0;
+    block_cycles = 0;
+}
+
+/**
+ * Divides by the CIC gain with rounding to nearest (no dead zone around 0).
+ */
+static int16_t scale_output(int32_t v)
+{
+    int32_t half = CIC_GAIN / 2;
+    return (int16_t)((v >= 0 ? v + half : v - half) / CIC_GAIN);
+}
+
+/**
+ * Order-3 CIC decimator for the six raw IMU axes.
+ *
+ * Every input sample runs through the integrators (adds only); every
+ * IMU_DECIMATION-th sample the combs produce one output at IMU_SAMPLE_HZ.
+ * The sinc^3 response puts nulls on every multiple of the output rate, so
+ * everything that would alias into the rep band is strongly attenuated while
+ * the droop below 5 Hz stays under 0.5 %. Returns true when out was written.
+ * in is read before out is written, so out may be the same or an earlier
+ * ring slot (in-place decimation).
+ */
+bool cic_decim_push(const MPU6050_RawData_t *in, MPU6050_RawData_t *out)
+{
+    uint32_t t0 = DWT->CYCCNT;
+    const int16_t x[CIC_CHANNELS] = {
+        in->accel_x, in->accel_y, in->accel_z,
+        in->gyro_x, in->gyro_y, in->gyro_z
+    };
+    
+    for (int ch = 0; ch < CIC_CHANNELS; ch++) {
+        uint32_t acc = (uint32_t)(int32_t)x[ch];
+        for (int s = 0; s < CIC_ORDER; s++) {
+            integrator[ch][s] += acc;
+            acc = integrator[ch][s];
+        }
+    }
+    
+    if (++phase < IMU_DECIMATION) {
+        block_cycles += DWT->CYCCNT - t0;
+        return false;
+    }
+    phase = 0;
+    
+    int16_t y[CIC_CHANNELS];
+    for (int ch = 0; ch < CIC_CHANNELS; ch++) {
+        uint32_t v = integrator[ch][CIC_ORDER - 1];
+        for (int s = 0; s < CIC_ORDER; s++) {
+            uint32_t d = v - comb_delay[ch][s];
+            comb_delay[ch][s] = v;
+            v = d;
+        }
+        y[ch] = scale_output((int32_t)v);
+    }
+    
+    out->accel_x = y[0];
+    out->accel_y = y[1];
+    out->accel_z = y[2];
+    out->gyro_x = y[3];
+    out->gyro_y = y[4];
+    out->gyro_z = y[5];
+    out->timestamp_us = in->timestamp_us;  // Constant group delay of 3*(R-1)/2 frames not removed
+    
+    // Cost of one output: IMU_DECIMATION integrator passes plus one comb pass
+    block_cycles += DWT->CYCCNT - t0;
+    if (block_cycles > cycles_max) cycles_max = block_cycles;
+    block_cycles = 0;
+    return true;
+}
+
+/**
+ * Worst-case cycles spent per decimated output sample (DWT measured).
+ */
+uint32_t cic_decim_get_cycles_max(void)
+{
+    return cycles_max;
+}
@@ -1,29 +1,162 @@
 #include "exercise_config.h"
+#include <math.h>
 
-// Exercise configuration table with sensible defaults
-const exercise_cfg_t EX_CFG[EX_COUNT] = {
-    [EX_BICEP_CURL] = {
-        .name = "Bicep Curl",
-        .thresh_k = 2.0f,           // 2 sigma threshold
-        .min_prominence_g = 0.5f,   // Minimum 0.5g peak prominence
-        .refractory_ms = 800,        // 800ms refractory period
-        .detect_warmup_ms = 1000     // 1 second warm-up
+// Built-in defaults, one entry per exercise in exercises.def
+const exercise_cfg_t EX_CFG_DEFAULTS[EX_COUNT] = {
+#define EXERCISE(id, name, k, prom, refr, warm, win, mode, proj, wx, wy, wz, gate) \
+    [EX_##id] = { \
+        .thresh_k = (k), \
+        .min_prominence_g = (prom), \
+        .refractory_ms = (refr), \
+        .detect_warmup_ms = (warm), \
+        .window_len = (win), \
+        .thresh_mode = (mode), \
+        .projection = (proj), \
+        .proj_weights = {(wx), (wy), (wz)}, \
+        .template_gate = (gate) \
     },
-    [EX_SHOULDER_PRESS] = {
-        .name = "Shoulder Press",
-        .thresh_k = 2.5f,           // 2.5 sigma threshold
-        .min_prominence_g = 0.7f,   // Minimum 0.7g peak prominence
-        .refractory_ms = 1000,       // 1 second refractory period
-        .detect_warmup_ms = 1200     // 1.2 second warm-up
-    },
-    [EX_BENCH_PRESS] = {
-        .name = "Bench Press",
-        .thresh_k = 3.0f,           // 3 sigma threshold
-        .min_prominence_g = 1.0f,   // Minimum 1.0g peak prominence
-        .refractory_ms = 1200,       // 1.2 second refractory period
-        .detect_warmup_ms = 1500     // 1.5 second warm-up
-    }
+#include "exercises.def"
 };
 
+const char *const EX_NAMES[EX_COUNT] = {
+#define EXERCISE(id, name, ...) [EX_##id] = name,
+#include "exercises.def"
+};
+
+// Built exercise ids in enum order ("BICEP_CURL,SHOULDER_PRESS,...")
+static const char EX_LIST[] =
+#define EXERCISE(id, ...) #id ","
+#include "exercises.def"
+    "";
+
+// Live configuration, tunable at runtime
+exercise_cfg_t EX_CFG[EX_COUNT];
+
 // Runtime context for each exercise
 rep_ctx_t REP_CTX[EX_COUNT] = {0};
+
+// Accepted range per parameter; integer parameters must be whole numbers
+typedef struct {
+    float min;
+    float max;
+    bool integer;
+} param_range_t;
+
+static const param_range_t PARAM_RANGE[EX_PARAM_COUNT] = {
+    [EX_PARAM_THRESH_K]          = {0.5f, 10.0f, false},
+    [EX_PARAM_MIN_PROMINENCE_G]  = {0.0f, 8.0f, false},
+    [EX_PARAM_REFRACTORY_MS]     = {0.0f, 5000.0f, true},
+    [EX_PARAM_DETECT_WARMUP_MS]  = {0.0f, 10000.0f, true},
+    [EX_PARAM_WINDOW_LEN]        = {2.0f, 1000.0f, true},  // rep_detect clamps to its arena
+    [EX_PARAM_THRESH_MODE]       = {0.0f, (float)THRESH_MODE_MAD, true},
+    [EX_PARAM_PROJECTION]        = {0.0f, (float)(PROJ_COUNT - 1), true},
+    [EX_PARAM_PROJ_WEIGHT_X]     = {-100.0f, 100.0f, false},
+    [EX_PARAM_PROJ_WEIGHT_Y]     = {-100.0f, 100.0f, false},
+    [EX_PARAM_PROJ_WEIGHT_Z]     = {-100.0f, 100.0f, false},
+    [EX_PARAM_TEMPLATE_GATE]     = {0.0f, 10.0f, false},
+};
+
+/**
+ * @brief 16-bit hash (folded FNV-1a) of the built exercise list. The flash
+ *        stores mix it into their version, so a page written by a build
+ *        with other exercises or another order is not loaded by position.
+ */
+uint16_t exercise_config_list_hash(void)
+{
+    uint32_t h = 2166136261UL;
+    for (const char *c = EX_LIST; *c != '\0'; c++) {
+        h = (h ^ (uint8_t)*c) * 16777619UL;
+    }
+    return (uint16_t)(h ^ (h >> 16));
+}
+
+/**
+ * @brief Loads the built-in defaults into the live table.
+ */
+void exercise_config_init(void)
+{
+    for (int ex = 0; ex < EX_COUNT; ex++) {
+        EX_CFG[ex] = EX_CFG_DEFAULTS[ex];
+    }
+}
+
+/**
+ * @brief Restores one exercise's built-in defaults (EX_COUNT: all of them).
+ */
+void exercise_config_restore_defaults(exercise_t ex)
+{
+    if (ex >= EX_COUNT) {
+        exercise_config_init();
+        return;
+    }
+    EX_CFG[ex] = EX_CFG_DEFAULTS[ex];
+}
+
+/**
+ * @brief Reads a live parameter.
+ */
+bool exercise_param_get(exercise_t ex, exercise_param_t id, float *value)
+{
+    if (ex >= EX_COUNT || id >= EX_PARAM_COUNT || !value) return false;
+    
+    const exercise_cfg_t *cfg = &EX_CFG[ex];
+    switch (id) {
+    case EX_PARAM_THRESH_K:         *value = cfg->thresh_k; break;
+    case EX_PARAM_MIN_PROMINENCE_G: *value = cfg->min_prominence_g; break;
+    case EX_PARAM_REFRACTORY_MS:    *value = (float)cfg->refractory_ms; break;
+    case EX_PARAM_DETECT_WARMUP_MS: *value = (float)cfg->detect_warmup_ms; break;
+    case EX_PARAM_WINDOW_LEN:       *value = (float)cfg->window_len; break;
+    case EX_PARAM_THRESH_MODE:      *value = (float)cfg->thresh_mode; break;
+    case EX_PARAM_PROJECTION:       *value = (float)cfg->projection; break;
+    case EX_PARAM_PROJ_WEIGHT_X:    *value = cfg->proj_weights[0]; break;
+    case EX_PARAM_PROJ_WEIGHT_Y:    *value = cfg->proj_weights[1]; break;
+    case EX_PARAM_PROJ_WEIGHT_Z:    *value = cfg->proj_weights[2]; break;
+    case EX_PARAM_TEMPLATE_GATE:    *value = cfg->template_gate; break;
+    default: return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Checks a value against the parameter's range (no side effects).
+ */
+bool exercise_param_check(exercise_param_t id, float value)
+{
+    if (id >= EX_PARAM_COUNT || !isfinite(value)) return false;
+    
+    const param_range_t *range = &PARAM_RANGE[id];
+    if (value < range->min || value > range->max) return false;
+    if (range->integer && value != floorf(value)) return false;
+    
+    // Kernels and modes that were compiled out cannot be selected
+    if (id == EX_PARAM_PROJECTION) return EX_PROJ_IS_BUILT((int)value);
+    if (id == EX_PARAM_THRESH_MODE) return EX_THRESH_MODE_IS_BUILT((int)value);
+    return true;
+}
+
+/**
+ * @brief Writes a live parameter after checking its range.
+ *        Read by the pipeline on the next sample; see EX_PARAM_MASK_* for the
+ *        ones that need re-derived state.
+ */
+bool exercise_param_set(exercise_t ex, exercise_param_t id, float value)
+{
+    if (ex >= EX_COUNT || !exercise_param_check(id, value)) return false;
+    
+    exercise_cfg_t *cfg = &EX_CFG[ex];
+    switch (id) {
+    case EX_PARAM_THRESH_K:         cfg->thresh_k = value; break;
+    case EX_PARAM_MIN_PROMINENCE_G: cfg->min_prominence_g = value; break;
+    case EX_PARAM_REFRACTORY_MS:    cfg->refractory_ms = (uint16_t)value; break;
+    case EX_PARAM_DETECT_WARMUP_MS: cfg->detect_warmup_ms = (uint16_t)value; break;
+    case EX_PARAM_WINDOW_LEN:       cfg->window_len = (uint16_t)value; break;
+    case EX_PARAM_THRESH_MODE:      cfg->thresh_mode = (thresh_mode_t)value; break;
+    case EX_PARAM_PROJECTION:       cfg->projection = (projection_t)value; break;
+    case EX_PARAM_PROJ_WEIGHT_X:    cfg->proj_weights[0] = value; break;
+    case EX_PARAM_PROJ_WEIGHT_Y:    cfg->proj_weights[1] = value; break;
+    case EX_PARAM_PROJ_WEIGHT_Z:    cfg->proj_weights[2] = value; break;
+    case EX_PARAM_TEMPLATE_GATE:    cfg->template_gate = value; break;
+    default: return false;
+    }
+    return true;
+}
@@ -1,67 +1,353 @@
 #include "imu_filters.h"
+#include "app_config.h"
+#include "biquad_coeffs.h"
 #include <math.h>
 
-// Simple low-pass filter coefficients
-#define ACCEL_ALPHA 0.1f
-#define GYRO_ALPHA 0.1f
+#if BIQUAD_SAMPLE_HZ != IMU_SAMPLE_HZ
+#error "biquad_coeffs.h is stale: run tools/gen_biquad_coeffs.py"
+#endif
 
-// Filter state
-static float accel_filter_state[3] = {0.0f, 0.0f, 0.0f};
-static float gyro_filter_state[3] = {0.0f, 0.0f, 0.0f};
+// Gyro smoothing runs in Q6 deg/s (1/64 deg/s per LSB)
+#define GYRO_SMOOTH_Q 6
+
+// Raw frame to fixed point. Raw accel is already Q14; the raw gyro less its
+// bias (1/16 LSB) is scaled by integer factors, Q(DTHETA_SHIFT) and Q(RATE_SHIFT):
+//   DTHETA_MUL = pi/180 * 2^16 / (131 * 16 * 1e6) * 2^36  (Q16 rad per us)
+//   RATE_MUL   = 2^6 / (131 * 16) * 2^24                  (Q6 deg/s)
+#define DTHETA_SHIFT 36
+#define DTHETA_MUL   37501
+#define RATE_SHIFT   24
+#define RATE_MUL     512281
+
+_Static_assert(MPU6050_ACCEL_LSB_PER_G == 1 << IMU_FUSION_ACCEL_Q, "raw accel is not Q(IMU_FUSION_ACCEL_Q)");
+_Static_assert(MPU6050_GYRO_LSB_PER_DPS == 131 && MPU6050_GYRO_BIAS_FRAC == 4 && IMU_FUSION_GYRO_Q == 16,
+               "regenerate DTHETA_MUL and RATE_MUL");
+// dt_us is capped at 4 nominal intervals (app_controller sample_dt())
+_Static_assert(4000LL * IMU_SAMPLE_INTERVAL_MS * DTHETA_MUL <= INT32_MAX, "dt_us * DTHETA_MUL overflows");
+
+// Driver gyro bias in raw units, loaded per call
+static int32_t gyro_offset[3];
+
+// Filter state: gyro smoothing and the selected exercise's rep bank
+static biquad_state_t gyro_filter_state[3][BIQUAD_SMOOTH_STAGES];
+static biquad_state_t rep_bank_state[BIQUAD_BANK_MAX_STAGES];
+static const biquad_coeffs_t *rep_bank_coeffs = BIQUAD_BANK_COEFFS[0];
+static uint8_t rep_bank_stages = 0;
 static float horizontal_reference[3] = {0.0f, 0.0f, 1.0f}; // Default to +Z up
 
+// Gravity estimate in the body frame, Q(ACCEL_Q + STATE_FRAC)
+static int32_t gravity_state[3] = {0, 0, 0};
+static bool gravity_valid = false;
+static uint32_t fusion_cycles_max = 0;
+
+// Average pipeline cost per sample (DWT), latched every CYCLE_AVG_SAMPLES samples
+#define CYCLE_AVG_SAMPLES 1024U
+static uint32_t cycle_sum = 0;
+static uint32_t cycle_samples = 0;
+static uint32_t cycles_per_sample = 0;
+
+// Rep signal projection, resolved once per exercise selection
+typedef float (*projection_fn_t)(const float linear_accel[3], const float gyro[3], const float w[3]);
+
+static float project_accel_axes(const float linear_accel[3], const float gyro[3], const float w[3])
+{
+    (void)gyro;
+    return w[0] * linear_accel[0] + w[1] * linear_accel[1] + w[2] * linear_accel[2];
+}
+
+static float project_gyro_axes(const float linear_accel[3], const float gyro[3], const float w[3])
+{
+    (void)linear_accel;
+    return w[0] * gyro[0] + w[1] * gyro[1] + w[2] * gyro[2];
+}
+
+// Gravity-relative projection is an accel dot product whose weights are the
+// calibrated gravity direction, folded in when the reference is set.
+// Kernels no built exercise can select stay NULL and are dropped by the linker.
+#define PROJ_KERNEL(kind, fn) [kind] = EX_PROJ_IS_BUILT(kind) ? (fn) : NULL
+static const projection_fn_t projection_table[PROJ_COUNT] = {
+    PROJ_KERNEL(PROJ_ACCEL_AXES, project_accel_axes),
+    PROJ_KERNEL(PROJ_GRAVITY_DIR, project_accel_axes),
+    PROJ_KERNEL(PROJ_GYRO_AXES, project_gyro_axes),
+};
+
+static exercise_t active_exercise = (exercise_t)0;
+static projection_fn_t active_projection = NULL;  // Set by imu_filters_select_exercise()
+static float active_weights[3] = {0.0f, 1.0f, 0.0f};
+
+#define ACCEL_TO_Q ((float)(1 << IMU_FUSION_ACCEL_Q))
+#define Q_TO_ACCEL (1.0f / (float)(1 << IMU_FUSION_ACCEL_Q))
+
 void imu_filters_init(void)
 {
     // Initialize filter states to zero
     for (int i = 0; i < 3; i++) {
-        accel_filter_state[i] = 0.0f;
-        gyro_filter_state[i] = 0.0f;
+        biquad_reset(gyro_filter_state[i], BIQUAD_SMOOTH_STAGES);
     }
     
+    // Gravity estimate is seeded from the first accel sample
+    gravity_state[0] = 0;
+    gravity_state[1] = 0;
+    gravity_state[2] = 0;
+    gravity_valid = false;
+    
     // Set default horizontal reference (assuming +Z is up)
     horizontal_reference[0] = 0.0f;
     horizontal_reference[1] = 0.0f;
     horizontal_reference[2] = 1.0f;
+    
+    imu_filters_select_exercise(active_exercise);
+}
+
+/**
+ * Folds the exercise's kernel weights (and the gravity reference for
+ * gravity-relative kernels) into the active projection weights.
+ */
+static void resolve_projection_weights(void)
+{
+    const exercise_cfg_t *cfg = &EX_CFG[active_exercise];
+    
+    if (cfg->projection == PROJ_GRAVITY_DIR) {
+        for (int i = 0; i < 3; i++) {
+            active_weights[i] = cfg->proj_weights[0] * horizontal_reference[i];
+        }
+    } else {
+        for (int i = 0; i < 3; i++) {
+            active_weights[i] = cfg->proj_weights[i];
+        }
+    }
+}
+
+void imu_filters_select_exercise(exercise_t exercise)
+{
+    if (exercise >= EX_COUNT) return;
+    
+    active_exercise = exercise;
+    active_projection = projection_table[EX_CFG[exercise].projection];
+    resolve_projection_weights();
+    
+    // Rep signal filter bank generated for this exercise
+    rep_bank_coeffs = BIQUAD_BANK_COEFFS[exercise];
+    rep_bank_stages = BIQUAD_BANK_STAGES[exercise];
+    biquad_reset(rep_bank_state, BIQUAD_BANK_MAX_STAGES);
+}
+
+/**
+ * Fixed-point complementary gravity estimator.
+ *
+ * The gravity vector is propagated in the body frame with the small-angle
+ * update g -= dtheta x g, then pulled toward the measured acceleration by
+ * 1/2^CORR_SHIFT per sample. Linear acceleration is the measured accel
+ * minus that estimate. Integer multiply/shift only (no normalization, no
+ * trig), so the step is branch-free and constant time.
+ */
+static inline void fuse_gravity(int32_t g[3], const int32_t accel_q[3], const int32_t dtheta_q[3], int32_t lin_q[3])
+{
+    const int32_t frac = IMU_FUSION_STATE_FRAC;
+    
+    int32_t gx = g[0] >> frac;
+    int32_t gy = g[1] >> frac;
+    int32_t gz = g[2] >> frac;
+    
+    // Rotate gravity opposite to the body rotation: g -= dtheta x g (Q16 * Q14 -> Q30)
+    int32_t shift = IMU_FUSION_GYRO_Q - frac;
+    g[0] -= (dtheta_q[1] * gz - dtheta_q[2] * gy) >> shift;
+    g[1] -= (dtheta_q[2] * gx - dtheta_q[0] * gz) >> shift;
+    g[2] -= (dtheta_q[0] * gy - dtheta_q[1] * gx) >> shift;
+    
+    // Complementary correction toward the accelerometer
+    g[0] += ((accel_q[0] << frac) - g[0]) >> IMU_FUSION_CORR_SHIFT;
+    g[1] += ((accel_q[1] << frac) - g[1]) >> IMU_FUSION_CORR_SHIFT;
+    g[2] += ((accel_q[2] << frac) - g[2]) >> IMU_FUSION_CORR_SHIFT;
+    
+    lin_q[0] = accel_q[0] - (g[0] >> frac);
+    lin_q[1] = accel_q[1] - (g[1] >> frac);
+    lin_q[2] = accel_q[2] - (g[2] >> frac);
+}
+
+/**
+ * Seeds the gravity estimate from the first accel sample after a reset.
+ */
+static void seed_gravity(const int32_t accel_q[3])
+{
+    if (gravity_valid) return;
+    
+    gravity_state[0] = accel_q[0] << IMU_FUSION_STATE_FRAC;
+    gravity_state[1] = accel_q[1] << IMU_FUSION_STATE_FRAC;
+    gravity_state[2] = accel_q[2] << IMU_FUSION_STATE_FRAC;
+    gravity_valid = true;
+}
+
+/**
+ * Adds the cycles of n processed samples to the per-sample average.
+ */
+static void account_cycles(uint32_t cycles, uint16_t n)
+{
+    cycle_sum += cycles;
+    cycle_samples += n;
+    if (cycle_samples >= CYCLE_AVG_SAMPLES) {
+        cycles_per_sample = cycle_sum / cycle_samples;
+        cycle_sum = 0;
+        cycle_samples = 0;
+    }
+}
+
+/**
+ * Converts one raw sample to fixed point with integer math only: accel Q14,
+ * the gyro as a per-sample rotation in Q16 rad and as a Q6 deg/s rate.
+ * The gyro loses its bias; the accel stays as measured, gravity included,
+ * since a body-fixed offset would not rotate with the gravity estimate.
+ */
+static inline void sample_to_q(const imu_sample_t *sample, int32_t accel_q[3], int32_t dtheta_q[3], int32_t rate_q[3])
+{
+    const MPU6050_RawData_t *in = &sample->raw;
+    const int32_t accel[3] = {in->accel_x, in->accel_y, in->accel_z};
+    const int32_t gyro[3] = {in->gyro_x, in->gyro_y, in->gyro_z};
+    int32_t dtheta_mul = (int32_t)sample->dt_us * DTHETA_MUL;
+    
+    for (int i = 0; i < 3; i++) {
+        int32_t rate = gyro[i] * (1 << MPU6050_GYRO_BIAS_FRAC) - gyro_offset[i];
+        accel_q[i] = accel[i];
+        dtheta_q[i] = (int32_t)(((int64_t)rate * dtheta_mul) >> DTHETA_SHIFT);
+        rate_q[i] = (int32_t)(((int64_t)rate * RATE_MUL) >> RATE_SHIFT);
+    }
+}
+
+/**
+ * Filters one raw slot in place: scales it and adds the smoothed gyro and
+ * the rep signal.
+ */
+void imu_filters_process_all(imu_sample_t *sample)
+{
+    if (!sample) return;
+    uint32_t t_start = DWT->CYCCNT;
+    mpu6050_get_gyro_bias_raw(gyro_offset);
+    
+    uint32_t t0 = DWT->CYCCNT;
+    int32_t accel_q[3];
+    int32_t dtheta_q[3];
+    int32_t rate_q[3];
+    int32_t lin_q[3];
+    sample_to_q(sample, accel_q, dtheta_q, rate_q);
+    seed_gravity(accel_q);
+    fuse_gravity(gravity_state, accel_q, dtheta_q, lin_q);
+    const float linear_accel[3] = {lin_q[0] * Q_TO_ACCEL, lin_q[1] * Q_TO_ACCEL, lin_q[2] * Q_TO_ACCEL};
+    
+    uint32_t cycles = DWT->CYCCNT - t0;
+    if (cycles > fusion_cycles_max) fusion_cycles_max = cycles;
+    
+    // Later stages read the scaled frame
+    mpu6050_scale_sample(sample);
+    
+    // Smooth the gyro with the generated low-pass stages
+    for (int i = 0; i < 3; i++) {
+        int32_t g = biquad_cascade(BIQUAD_SMOOTH_COEFFS, gyro_filter_state[i], BIQUAD_SMOOTH_STAGES, rate_q[i]);
+        sample->gyro_filtered[i] = g * (1.0f / (float)(1 << GYRO_SMOOTH_Q));
+    }
+    
+    // Project onto the selected exercise's rep axis (no per-exercise branching),
+    // then band-limit it with the exercise's rep filter bank
+    float rep_signal = active_projection(linear_accel, sample->gyro_filtered, active_weights);
+    int32_t rep_q = biquad_cascade(rep_bank_coeffs, rep_bank_state, rep_bank_stages,
+                                   (int32_t)(rep_signal * ACCEL_TO_Q));
+    sample->rep_signal = rep_q * Q_TO_ACCEL;
+    
+    account_cycles(DWT->CYCCNT - t_start, 1);
 }
 
-void imu_filters_process_all(const MPU6050_ScaledData_t *raw_data, 
-                           IMUFilteredData_t *filtered_data, 
-                           float dt, 
-                           exercise_t exercise)
+/**
+ * Filters up to IMU_FILTERS_BLOCK_MAX raw slots with the invariants and the
+ * filter state hoisted out of the per-sample work; scales each slot once its
+ * raw frame is converted.
+ */
+static void process_chunk(imu_sample_t *samples, uint16_t n)
 {
-    if (!raw_data || !filtered_data) return;
+    float linear_accel[IMU_FILTERS_BLOCK_MAX][3];
+    int32_t gyro_q[3][IMU_FILTERS_BLOCK_MAX];
+    int32_t rep_q[IMU_FILTERS_BLOCK_MAX];
     
-    // Apply low-pass filter to accelerometer data
-    accel_filter_state[0] = ACCEL_ALPHA * raw_data->accel_x_g + (1.0f - ACCEL_ALPHA) * accel_filter_state[0];
-    accel_filter_state[1] = ACCEL_ALPHA * raw_data->accel_y_g + (1.0f - ACCEL_ALPHA) * accel_filter_state[1];
-    accel_filter_state[2] = ACCEL_ALPHA * raw_data->accel_z_g + (1.0f - ACCEL_ALPHA) * accel_filter_state[2];
+    // Fusion over the chunk with the gravity estimate held in locals
+    uint32_t t0 = DWT->CYCCNT;
+    int32_t accel_q[3];
+    int32_t dtheta_q[3];
+    int32_t rate_q[3];
+    if (!gravity_valid) {
+        sample_to_q(&samples[0], accel_q, dtheta_q, rate_q);
+        seed_gravity(accel_q);
+    }
+    int32_t g[3] = {gravity_state[0], gravity_state[1], gravity_state[2]};
+    
+    for (uint16_t k = 0; k < n; k++) {
+        int32_t lin_q[3];
+        sample_to_q(&samples[k], accel_q, dtheta_q, rate_q);
+        fuse_gravity(g, accel_q, dtheta_q, lin_q);
+        mpu6050_scale_sample(&samples[k]);
+        
+        linear_accel[k][0] = lin_q[0] * Q_TO_ACCEL;
+        linear_accel[k][1] = lin_q[1] * Q_TO_ACCEL;
+        linear_accel[k][2] = lin_q[2] * Q_TO_ACCEL;
+        gyro_q[0][k] = rate_q[0];
+        gyro_q[1][k] = rate_q[1];
+        gyro_q[2][k] = rate_q[2];
+    }
     
-    // Apply low-pass filter to gyroscope data
-    gyro_filter_state[0] = GYRO_ALPHA * raw_data->gyro_x_deg_s + (1.0f - GYRO_ALPHA) * gyro_filter_state[0];
-    gyro_filter_state[1] = GYRO_ALPHA * raw_data->gyro_y_deg_s + (1.0f - GYRO_ALPHA) * gyro_filter_state[1];
-    gyro_filter_state[2] = GYRO_ALPHA * raw_data->gyro_z_deg_s + (1.0f - GYRO_ALPHA) * gyro_filter_state[2];
+    gravity_state[0] = g[0];
+    gravity_state[1] = g[1];
+    gravity_state[2] = g[2];
+    uint32_t cycles = (DWT->CYCCNT - t0) / n;
+    if (cycles > fusion_cycles_max) fusion_cycles_max = cycles;
     
-    // Store filtered data
-    filtered_data->accel_filtered[0] = accel_filter_state[0];
-    filtered_data->accel_filtered[1] = accel_filter_state[1];
-    filtered_data->accel_filtered[2] = accel_filter_state[2];
+    // Gyro smoothing, one axis at a time so each cascade keeps its state in registers
+    for (int i = 0; i < 3; i++) {
+        biquad_cascade_block(BIQUAD_SMOOTH_COEFFS, gyro_filter_state[i], BIQUAD_SMOOTH_STAGES, gyro_q[i], n);
+        for (uint16_t k = 0; k < n; k++) {
+            samples[k].gyro_filtered[i] = gyro_q[i][k] * (1.0f / (float)(1 << GYRO_SMOOTH_Q));
+        }
+    }
     
-    filtered_data->gyro_filtered[0] = gyro_filter_state[0];
-    filtered_data->gyro_filtered[1] = gyro_filter_state[1];
-    filtered_data->gyro_filtered[2] = gyro_filter_state[2];
+    // Rep signal: projection resolved once for the chunk, then the rep bank
+    const projection_fn_t project = active_projection;
+    const float w[3] = {active_weights[0], active_weights[1], active_weights[2]};
+    for (uint16_t k = 0; k < n; k++) {
+        rep_q[k] = (int32_t)(project(linear_accel[k], samples[k].gyro_filtered, w) * ACCEL_TO_Q);
+    }
+    biquad_cascade_block(rep_bank_coeffs, rep_bank_state, rep_bank_stages, rep_q, n);
+    for (uint16_t k = 0; k < n; k++) {
+        samples[k].rep_signal = rep_q[k] * Q_TO_ACCEL;
+    }
+}
+
+/**
+ * Block version of imu_filters_process_all() for FIFO/DMA batches, with the
+ * same results slot for slot.
+ */
+void imu_filters_process_block(imu_sample_t *samples, uint16_t n)
+{
+    if (!samples || n == 0) return;
+    uint32_t t_start = DWT->CYCCNT;
+    uint16_t total = n;
+    mpu6050_get_gyro_bias_raw(gyro_offset);
     
-    // Copy horizontal reference
-    filtered_data->horizontal_ref[0] = horizontal_reference[0];
-    filtered_data->horizontal_ref[1] = horizontal_reference[1];
-    filtered_data->horizontal_ref[2] = horizontal_reference[2];
+    while (n > 0) {
+        uint16_t chunk = n < IMU_FILTERS_BLOCK_MAX ? n : IMU_FILTERS_BLOCK_MAX;
+        process_chunk(samples, chunk);
+        samples += chunk;
+        n -= chunk;
+    }
     
-    // Set horizontal vector
-    filtered_data->horizontal_vector.x = horizontal_reference[0];
-    filtered_data->horizontal_vector.y = horizontal_reference[1];
-    filtered_data->horizontal_vector.z = horizontal_reference[2];
+    account_cycles(DWT->CYCCNT - t_start, total);
+}
+
+/**
+ * Current gravity estimate in the body frame (g).
+ */
+void imu_filters_get_gravity(vec3_t *gravity)
+{
+    if (!gravity) return;
     
-    // Compute curl axis scalar (simplified - use Y-axis acceleration for bicep curl)
-    filtered_data->curl_axis_scalar = raw_data->accel_y_g;
+    gravity->x = (gravity_state[0] >> IMU_FUSION_STATE_FRAC) * Q_TO_ACCEL;
+    gravity->y = (gravity_state[1] >> IMU_FUSION_STATE_FRAC) * Q_TO_ACCEL;
+    gravity->z = (gravity_state[2] >> IMU_FUSION_STATE_FRAC) * Q_TO_ACCEL;
 }
 
 void imu_filters_set_horizontal_reference(const vec3_t *ref)
@@ -74,5 +360,24 @@ void imu_filters_set_horizontal_reference(const vec3_t *ref)
         horizontal_reference[0] = ref->x / magnitude;
         horizontal_reference[1] = ref->y / magnitude;
         horizontal_reference[2] = ref->z / magnitude;
+        resolve_projection_weights();
     }
 }
+
+/**
+ * Worst-case cycles spent in the fixed-point fusion step (DWT measured).
+ * Expected to stay around a few hundred cycles on the M3 at 72 MHz.
+ */
+uint32_t imu_filters_get_fusion_cycles_max(void)
+{
+    return fusion_cycles_max;
+}
+
+/**
+ * Average cycles per filtered sample over the last CYCLE_AVG_SAMPLES samples,
+ * for whichever API the pipeline uses (DWT measured; 0 until the first average).
+ */
+uint32_t imu_filters_get_cycles_per_sample(void)
+{
+    return cycles_per_sample;
+}
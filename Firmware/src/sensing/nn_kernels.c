@@ -0,0 +1,77 @@
+#include "nn_kernels.h"
+#include <string.h>
+
+/**
+ * Loads four int8 values as one word (a single LDR on the M3, unaligned is fine).
+ */
+static inline uint32_t load4(const int8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * Dot product of two int8 vectors, len a multiple of 4.
+ *
+ * The M3 has no SIMD multiply (SMLAD is M4 and up), so the loop is built
+ * around the cheap parts it does have: one word load brings in four weights
+ * and four inputs, SXTB with rotation unpacks each byte in one cycle, and
+ * two independent MLA chains hide the multiply latency.
+ */
+static int32_t dot_s8(const int8_t *a, const int8_t *b, uint16_t len)
+{
+    int32_t acc0 = 0;
+    int32_t acc1 = 0;
+    
+    for (uint16_t i = 0; i < len; i += 4) {
+        uint32_t va = load4(&a[i]);
+        uint32_t vb = load4(&b[i]);
+        acc0 += (int32_t)(int8_t)va * (int8_t)vb;
+        acc1 += (int32_t)(int8_t)(va >> 8) * (int8_t)(vb >> 8);
+        acc0 += (int32_t)(int8_t)(va >> 16) * (int8_t)(vb >> 16);
+        acc1 += (int32_t)(int8_t)(va >> 24) * (int8_t)(vb >> 24);
+    }
+    return acc0 + acc1;
+}
+
+/**
+ * Fully connected int8 layer with int32 accumulation and per-layer
+ * requantization back to int8 (one 32x32->64 multiply per output).
+ */
+void nn_dense_s8(const nn_dense_t *layer, const int8_t *in, int8_t *out)
+{
+    const int8_t *w = layer->weights;
+    const int64_t round = (layer->shift > 0) ? ((int64_t)1 << (layer->shift - 1)) : 0;
+    
+    for (uint16_t o = 0; o < layer->out_len; o++) {
+        int32_t acc = layer->bias[o] + dot_s8(w, in, layer->in_len);
+        w += layer->in_len;
+        
+        int32_t y = (int32_t)(((int64_t)acc * layer->mult + round) >> layer->shift);
+        if (layer->relu && y < 0) y = 0;
+        if (y > 127) y = 127;
+        if (y < -128) y = -128;
+        out[o] = (int8_t)y;
+    }
+}
+
+/**
+ * Index of the largest value; margin receives its lead over the runner-up.
+ */
+uint8_t nn_argmax_s8(const int8_t *v, uint8_t n, int16_t *margin)
+{
+    uint8_t best = 0;
+    int16_t second = -129;
+    
+    for (uint8_t i = 1; i < n; i++) {
+        if (v[i] > v[best]) {
+            second = v[best];
+            best = i;
+        } else if (v[i] > second) {
+            second = v[i];
+        }
+    }
+    if (margin) *margin = (n > 1) ? (int16_t)(v[best] - second) : 0;
+    return best;
+}
@@ -0,0 +1,161 @@
+#include "rep_classifier.h"
+#include "app_config.h"
+
+#if ENABLE_REP_CLASSIFIER
+
+#include "rep_classifier_weights.h"
+#include "nn_kernels.h"
+#include <math.h>
+
+#define DECIM_FACTOR (IMU_SAMPLE_HZ / REP_CLASSIFIER_HZ)
+#define AXES 6
+
+#if (IMU_SAMPLE_HZ % REP_CLASSIFIER_HZ) != 0
+#error "IMU_SAMPLE_HZ must be a multiple of REP_CLASSIFIER_HZ"
+#endif
+_Static_assert(REP_CLASSIFIER_EX_COUNT == EX_COUNT, "rep_classifier_weights.h was trained for another exercise list");
+
+static const nn_dense_t layers[3] = {
+    {REP_CLASSIFIER_W1, REP_CLASSIFIER_B1, REP_CLASSIFIER_IN, REP_CLASSIFIER_H1,
+     REP_CLASSIFIER_L1_MULT, REP_CLASSIFIER_L1_SHIFT, true},
+    {REP_CLASSIFIER_W2, REP_CLASSIFIER_B2, REP_CLASSIFIER_H1, REP_CLASSIFIER_H2,
+     REP_CLASSIFIER_L2_MULT, REP_CLASSIFIER_L2_SHIFT, true},
+    {REP_CLASSIFIER_W3, REP_CLASSIFIER_B3, REP_CLASSIFIER_H2, REP_CLASSIFIER_OUT,
+     REP_CLASSIFIER_L3_MULT, REP_CLASSIFIER_L3_SHIFT, false},
+};
+
+// Quantized frames, written twice so the window is always contiguous (time-major)
+static int8_t frames[2 * REP_CLASSIFIER_IN];
+static uint8_t frame_pos = 0;
+static uint8_t frame_count = 0;
+static float decim_sum[AXES];
+static uint8_t decim_phase = 0;
+
+static int8_t act1[REP_CLASSIFIER_H1];
+static int8_t act2[REP_CLASSIFIER_H2];
+static int8_t logits[REP_CLASSIFIER_OUT];
+
+static rep_class_t last;
+static bool has_result = false;
+static bool rep_seen = false;
+static uint32_t cycles_max = 0;
+
+void rep_classifier_reset(void)
+{
+    for (int i = 0; i < AXES; i++) decim_sum[i] = 0.0f;
+    decim_phase = 0;
+    frame_pos = 0;
+    frame_count = 0;
+    has_result = false;
+    rep_seen = false;
+}
+
+static int8_t quantize(float v, float q)
+{
+    long x = lrintf(v * q);
+    if (x > 127) return 127;
+    if (x < -128) return -128;
+    return (int8_t)x;
+}
+
+/**
+ * Runs the three dense layers over the current window (about 9.8k MACs).
+ */
+static void classify(void)
+{
+    uint32_t t0 = DWT->CYCCNT;
+    const int8_t *window = &frames[frame_pos * AXES];
+    
+    nn_dense_s8(&layers[0], window, act1);
+    nn_dense_s8(&layers[1], act1, act2);
+    nn_dense_s8(&layers[2], act2, logits);
+    
+    last.is_rep = nn_argmax_s8(logits, 2, &last.rep_margin) == 1;
+    last.exercise = (exercise_t)nn_argmax_s8(&logits[2], EX_COUNT, &last.exercise_margin);
+    has_result = true;
+    if (last.is_rep) rep_seen = true;
+    
+    uint32_t cycles = DWT->CYCCNT - t0;
+    if (cycles > cycles_max) cycles_max = cycles;
+}
+
+/**
+ * Feeds one scaled IMU sample. Samples are block-averaged to
+ * REP_CLASSIFIER_HZ; each new frame slides the window and runs one
+ * inference. Returns true when a new classification is available.
+ */
+bool rep_classifier_update(const MPU6050_ScaledData_t *sample)
+{
+    if (!REP_CLASSIFIER_TRAINED) return false;
+    
+    decim_sum[0] += sample->accel_x_g;
+    decim_sum[1] += sample->accel_y_g;
+    decim_sum[2] += sample->accel_z_g;
+    decim_sum[3] += sample->gyro_x_deg_s;
+    decim_sum[4] += sample->gyro_y_deg_s;
+    decim_sum[5] += sample->gyro_z_deg_s;
+    if (++decim_phase < DECIM_FACTOR) return false;
+    decim_phase = 0;
+    
+    int8_t *slot = &frames[frame_pos * AXES];
+    for (int i = 0; i < AXES; i++) {
+        float mean = decim_sum[i] * (1.0f / DECIM_FACTOR);
+        int8_t q = quantize(mean, i < 3 ? REP_CLASSIFIER_ACCEL_Q : REP_CLASSIFIER_GYRO_Q);
+        slot[i] = q;
+        slot[i + REP_CLASSIFIER_IN] = q;
+        decim_sum[i] = 0.0f;
+    }
+    if (++frame_pos >= REP_CLASSIFIER_STEPS) frame_pos = 0;
+    if (frame_count < REP_CLASSIFIER_STEPS) {
+        frame_count++;
+        if (frame_count < REP_CLASSIFIER_STEPS) return false;
+    }
+    
+    classify();
+    return true;
+}
+
+bool rep_classifier_get_last(rep_class_t *out)
+{
+    if (!has_result || out == NULL) return false;
+    *out = last;
+    return true;
+}
+
+/**
+ * Starts a new candidate rep (called at the threshold crossing).
+ */
+void rep_classifier_arm(void)
+{
+    rep_seen = last.is_rep && has_result;
+}
+
+/**
+ * Drops the candidate rep without judging it (the set was restarted mid-peak).
+ */
+void rep_classifier_disarm(void)
+{
+    rep_seen = false;
+}
+
+/**
+ * True if the classifier saw a rep since the crossing, or if no trained
+ * weights are built in (the threshold detector then decides alone).
+ */
+bool rep_classifier_confirm(void)
+{
+    if (!REP_CLASSIFIER_TRAINED) return true;
+    bool seen = rep_seen;
+    rep_seen = false;
+    return seen;
+}
+
+/**
+ * Worst-case cycles of one inference (DWT measured).
+ */
+uint32_t rep_classifier_get_cycles_max(void)
+{
+    return cycles_max;
+}
+
+#endif // ENABLE_REP_CLASSIFIER
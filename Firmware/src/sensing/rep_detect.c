@@ -1,76 +1,189 @@
 #include "rep_detect.h"
 #include "exercise_config.h"
+#include "rep_template.h"
+#include "cadence.h"
+#include "rep_classifier.h"
+#include "app_config.h"
+#include "stm32f1xx_hal.h"
 #include <math.h>
+#include <string.h>
 
-// Static variables for each exercise
-static RepDetectState_t rep_state[EX_COUNT];
-static uint16_t rep_count[EX_COUNT] = {0};
+// Consistency constant: 1.4826 * MAD estimates sigma for Gaussian noise
+#define MAD_TO_SIGMA 1.4826f
 
-// Rolling statistics buffer for each exercise
-#define ROLLING_BUFFER_SIZE 100
-static float sample_buffer[EX_COUNT][ROLLING_BUFFER_SIZE];
-static uint16_t buffer_index[EX_COUNT] = {0};
-static bool buffer_filled[EX_COUNT] = {0};
+// Constant 0 when no built exercise can select THRESH_MODE_MAD: the sorted
+// window code then folds away
+#define MAD_BUILT EX_THRESH_MODE_IS_BUILT(THRESH_MODE_MAD)
 
-// Calibration accumulators
-static float calib_sum[EX_COUNT] = {0};
-static float calib_sum_sq[EX_COUNT] = {0};
-static uint16_t calib_count[EX_COUNT] = {0};
+// Detector state for the active exercise, allocated from the arena
+typedef struct {
+    RepDetectState_t state;
+    uint16_t rep_count;
+    
+    // Rolling statistics window (scaled int16 samples)
+    int16_t *window;
+    uint16_t window_len;
+    uint16_t window_index;
+    bool window_filled;
+    int32_t window_sum;      // Exact: no drift over long sessions
+    int64_t window_sum_sq;
+    
+    // Sorted copy of the window for THRESH_MODE_MAD (NULL otherwise)
+    int16_t *sorted;
+    
+    // Rolling centre/spread, copied to REP_CTX once per update call
+    float rolling_mu;
+    float rolling_sigma;
+    
+    // Previous sample, for the slope at the peak
+    float prev_sample;
+    
+    // Calibration accumulators
+    float calib_sum;
+    float calib_sum_sq;
+    uint16_t calib_count;
+} rep_detector_t;
+
+// Shared arena: only the selected exercise owns detector state, so RAM use
+// does not grow with EX_COUNT
+static uint32_t arena[REP_DETECT_ARENA_BYTES / sizeof(uint32_t)];
+static uint16_t arena_used = 0;
+
+static rep_detector_t *det = NULL;
+static exercise_t active_ex = EX_COUNT;
+
+// Exercise parameters read once per update call instead of once per sample
+typedef struct {
+    float thresh_k;
+    float min_prominence_g;
+    float baseline_mu;
+    float sigma_floor;
+    uint16_t refractory_ms;
+} detect_params_t;
+
+// Average detector cost per sample (DWT), latched every CYCLE_AVG_SAMPLES samples
+#define CYCLE_AVG_SAMPLES 1024U
+static uint32_t cycle_sum = 0;
+static uint32_t cycle_samples = 0;
+static uint32_t cycles_per_sample = 0;
+
+/**
+ * @brief Allocates a 4-byte aligned block from the detector arena.
+ * @retval void* Block pointer, or NULL if the arena is exhausted.
+ */
+static void *arena_alloc(uint16_t size)
+{
+    size = (size + 3U) & ~3U;
+    if (size > sizeof(arena) - arena_used) return NULL;
+    
+    void *block = (uint8_t *)arena + arena_used;
+    arena_used += size;
+    return block;
+}
+
+/**
+ * @brief Converts a sample in g to the int16 window representation.
+ */
+static int16_t to_window_sample(float sample)
+{
+    float scaled = sample * REP_SAMPLE_SCALE;
+    if (scaled > 32767.0f) return 32767;
+    if (scaled < -32768.0f) return -32768;
+    return (int16_t)lrintf(scaled);
+}
 
 /**
  * @brief Initializes the rep detection system.
  */
 void rep_detect_init(void)
 {
+    arena_used = 0;
+    det = NULL;
+    active_ex = EX_COUNT;
+    
     for (int ex = 0; ex < EX_COUNT; ex++)
     {
-        // Initialize state
-        rep_state[ex].last_rep_time_ms = 0;
-        rep_state[ex].last_peak_time_ms = 0;
-        rep_state[ex].last_peak_value = 0.0f;
-        rep_state[ex].threshold = 0.0f;
-        rep_state[ex].mean = 0.0f;
-        rep_state[ex].std_dev = 0.0f;
-        rep_state[ex].sample_count = 0;
-        rep_state[ex].in_peak = false;
-        rep_state[ex].peak_start_time = 0;
-        
-        // Initialize buffer
-        for (int i = 0; i < ROLLING_BUFFER_SIZE; i++)
-        {
-            sample_buffer[ex][i] = 0.0f;
-        }
-        buffer_index[ex] = 0;
-        buffer_filled[ex] = false;
-        
-        // Reset counter
-        rep_count[ex] = 0;
-        
-        // Initialize calibration
-        calib_sum[ex] = 0.0f;
-        calib_sum_sq[ex] = 0.0f;
-        calib_count[ex] = 0;
-        
         // Mark as not calibrated
         REP_CTX[ex].calibrated = false;
     }
 }
 
+/**
+ * @brief Selects the active exercise and allocates its detector state.
+ */
+void rep_detect_select(exercise_t ex)
+{
+    if (ex >= EX_COUNT) return;
+    
+    // Release the previous exercise's state
+    arena_used = 0;
+    det = arena_alloc(sizeof(rep_detector_t));
+    active_ex = ex;
+    
+    // Clamp the window to what is left in the arena (MAD mode keeps a sorted copy)
+    bool use_mad = MAD_BUILT && (EX_CFG[ex].thresh_mode == THRESH_MODE_MAD);
+    uint16_t bytes_per_sample = use_mad ? 2 * sizeof(int16_t) : sizeof(int16_t);
+    uint16_t window_len = EX_CFG[ex].window_len;
+    uint16_t max_len = ((sizeof(arena) - arena_used) / bytes_per_sample) & ~1U;
+    if (window_len > max_len) window_len = max_len;
+    if (window_len == 0) window_len = 1;
+    
+    // Initialize state
+    det->state.last_rep_time_us = 0;
+    det->state.last_peak_time_us = 0;
+    det->state.last_peak_value = 0.0f;
+    det->state.threshold = 0.0f;
+    det->state.mean = 0.0f;
+    det->state.std_dev = 0.0f;
+    det->state.sample_count = 0;
+    det->state.in_peak = false;
+    det->state.peak_start_time_us = 0;
+    det->state.peak_max_time_us = 0;
+    det->state.early_counted = false;
+    det->state.early_threshold = 0.0f;
+    det->state.retracted_count = 0;
+    det->state.skip_peak = false;
+    det->rep_count = 0;
+    
+    // Initialize window
+    det->window = arena_alloc(window_len * sizeof(int16_t));
+    det->window_len = window_len;
+    for (uint16_t i = 0; i < window_len; i++)
+    {
+        det->window[i] = 0;
+    }
+    det->window_index = 0;
+    det->window_filled = false;
+    det->window_sum = 0;
+    det->window_sum_sq = 0;
+    det->rolling_mu = 0.0f;
+    det->rolling_sigma = 0.0f;
+    det->prev_sample = 0.0f;
+    det->sorted = use_mad ? arena_alloc(window_len * sizeof(int16_t)) : NULL;
+    
+    // Initialize calibration
+    det->calib_sum = 0.0f;
+    det->calib_sum_sq = 0.0f;
+    det->calib_count = 0;
+}
+
 /**
  * @brief Begins calibration for a specific exercise.
  */
 void rep_detect_begin_calibration(exercise_t ex)
 {
-    if (ex >= EX_COUNT) return;
+    if (ex != active_ex) return;
     
     // Reset calibration accumulators
-    calib_sum[ex] = 0.0f;
-    calib_sum_sq[ex] = 0.0f;
-    calib_count[ex] = 0;
+    det->calib_sum = 0.0f;
+    det->calib_sum_sq = 0.0f;
+    det->calib_count = 0;
     
     // Reset rep detection state
-    rep_state[ex].sample_count = 0;
-    rep_state[ex].in_peak = false;
+    det->state.sample_count = 0;
+    det->state.in_peak = false;
+    det->state.early_counted = false;
+    det->state.skip_peak = false;
 }
 
 /**
@@ -78,11 +191,11 @@ void rep_detect_begin_calibration(exercise_t ex)
  */
 void rep_detect_accumulate_calibration(exercise_t ex, float sample)
 {
-    if (ex >= EX_COUNT) return;
+    if (ex != active_ex) return;
     
-    calib_sum[ex] += sample;
-    calib_sum_sq[ex] += sample * sample;
-    calib_count[ex]++;
+    det->calib_sum += sample;
+    det->calib_sum_sq += sample * sample;
+    det->calib_count++;
 }
 
 /**
@@ -90,11 +203,11 @@ void rep_detect_accumulate_calibration(exercise_t ex, float sample)
  */
 void rep_detect_end_calibration(exercise_t ex, float *out_mu, float *out_sigma)
 {
-    if (ex >= EX_COUNT || calib_count[ex] == 0) return;
+    if (ex != active_ex || det->calib_count == 0) return;
     
     // Compute mean and standard deviation
-    float mu = calib_sum[ex] / calib_count[ex];
-    float variance = (calib_sum_sq[ex] / calib_count[ex]) - (mu * mu);
+    float mu = det->calib_sum / det->calib_count;
+    float variance = (det->calib_sum_sq / det->calib_count) - (mu * mu);
     float sigma = sqrtf(fmaxf(variance, 0.0f));
     
     // Store in runtime context
@@ -108,143 +221,437 @@ void rep_detect_end_calibration(exercise_t ex, float *out_mu, float *out_sigma)
 }
 
 /**
- * @brief Updates rolling statistics (mean and standard deviation).
+ * @brief Restores a stored baseline and prefills the rolling window with it,
+ *        so detection starts with the next sample instead of after window_len.
+ *        The first rolling sigma is zero, i.e. the threshold starts from the
+ *        baseline sigma floor until real samples replace the seed.
  */
-static void update_rolling_stats(exercise_t ex, float new_sample)
+void rep_detect_seed(exercise_t ex, float mu, float sigma)
 {
-    if (ex >= EX_COUNT) return;
+    if (ex != active_ex) return;
     
-    // Add new sample to buffer
-    sample_buffer[ex][buffer_index[ex]] = new_sample;
-    buffer_index[ex] = (buffer_index[ex] + 1) % ROLLING_BUFFER_SIZE;
+    REP_CTX[ex].baseline_mu = mu;
+    REP_CTX[ex].baseline_sigma = fmaxf(sigma, MIN_SIGMA_FLOOR_G);
+    REP_CTX[ex].calibrated = true;
     
-    if (buffer_index[ex] == 0)
+    int16_t s = to_window_sample(mu);
+    for (uint16_t i = 0; i < det->window_len; i++)
     {
-        buffer_filled[ex] = true;
+        det->window[i] = s;
+        if (det->sorted) det->sorted[i] = s;
     }
+    det->window_index = 0;
+    det->window_filled = true;
+    det->window_sum = (int32_t)s * det->window_len;
+    det->window_sum_sq = (int64_t)s * s * det->window_len;
     
-    // Compute mean
-    float sum = 0.0f;
-    uint16_t count = buffer_filled[ex] ? ROLLING_BUFFER_SIZE : buffer_index[ex];
+    det->state.sample_count = det->window_len;
+    det->state.in_peak = false;
+    det->state.early_counted = false;
+    det->state.skip_peak = false;
+    det->state.mean = mu;
+    det->state.std_dev = 0.0f;
+    det->state.threshold = mu + EX_CFG[ex].thresh_k * REP_CTX[ex].baseline_sigma;
+}
+
+/**
+ * @brief Binary search for the first position in a sorted array whose value is >= v.
+ */
+static uint16_t lower_bound(const int16_t *a, uint16_t n, int16_t v)
+{
+    uint16_t lo = 0;
+    uint16_t hi = n;
+    while (lo < hi)
+    {
+        uint16_t mid = (lo + hi) >> 1;
+        if (a[mid] < v) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * @brief Replaces one value of the sorted window with another.
+ *        Binary search locates both positions; only the elements between them move.
+ */
+static void sorted_replace(int16_t *a, uint16_t n, int16_t old_v, int16_t new_v)
+{
+    if (new_v == old_v) return;
+    
+    uint16_t p_old = lower_bound(a, n, old_v);
     
-    for (uint16_t i = 0; i < count; i++)
+    if (new_v >= old_v)
+    {
+        // New value lands at or after the old slot: shift (p_old, p_new) left
+        uint16_t p_new = lower_bound(a, n, new_v);
+        memmove(&a[p_old], &a[p_old + 1], (p_new - p_old - 1) * sizeof(int16_t));
+        a[p_new - 1] = new_v;
+    }
+    else
     {
-        sum += sample_buffer[ex][i];
+        // New value lands before the old slot: shift [p_new, p_old) right
+        uint16_t p_new = lower_bound(a, p_old, new_v);
+        memmove(&a[p_new + 1], &a[p_new], (p_old - p_new) * sizeof(int16_t));
+        a[p_new] = new_v;
     }
-    rep_state[ex].mean = sum / count;
+}
+
+/**
+ * @brief Inserts a value into a sorted array holding n elements.
+ */
+static void sorted_insert(int16_t *a, uint16_t n, int16_t v)
+{
+    uint16_t p = lower_bound(a, n, v);
+    memmove(&a[p + 1], &a[p], (n - p) * sizeof(int16_t));
+    a[p] = v;
+}
+
+/**
+ * @brief Computes the median absolute deviation of a sorted array in O(log n).
+ *        Deviations below the median (m - a[mid-1-i]) and above it (a[mid+j] - m)
+ *        form two ascending sequences; the MAD is the k-th smallest of their union,
+ *        found by binary search on how many elements come from the lower side.
+ */
+static int32_t sorted_mad(const int16_t *a, uint16_t n)
+{
+    uint16_t mid = n >> 1;
+    int32_t m = a[mid];
+    int32_t len_lo = mid;           // Lower deviations: m - a[mid - 1 - i]
+    int32_t len_hi = n - mid;       // Upper deviations: a[mid + j] - m
+    int32_t take = (n >> 1) + 1;    // Rank of the MAD (1-based)
     
-    // Compute standard deviation
-    float sum_sq = 0.0f;
-    for (uint16_t i = 0; i < count; i++)
+    int32_t lo = take > len_hi ? take - len_hi : 0;
+    int32_t hi = take < len_lo ? take : len_lo;
+    while (lo < hi)
     {
-        float diff = sample_buffer[ex][i] - rep_state[ex].mean;
-        sum_sq += diff * diff;
+        int32_t i = (lo + hi) >> 1;
+        int32_t j = take - i;
+        // Take more from the lower side while its next deviation is smaller
+        if ((m - a[mid - 1 - i]) < (a[mid + j - 1] - m)) lo = i + 1;
+        else hi = i;
     }
-    rep_state[ex].std_dev = sqrtf(sum_sq / count);
     
-    // Update rolling context
-    REP_CTX[ex].rolling_mu = rep_state[ex].mean;
-    REP_CTX[ex].rolling_sigma = rep_state[ex].std_dev;
+    int32_t i = lo;
+    int32_t j = take - i;
+    int32_t dev_lo = (i > 0) ? m - a[mid - i] : 0;
+    int32_t dev_hi = (j > 0) ? a[mid + j - 1] - m : 0;
+    return dev_lo > dev_hi ? dev_lo : dev_hi;
+}
+
+/**
+ * @brief Loads the active exercise's parameters once per update call.
+ */
+static void load_params(exercise_t ex, detect_params_t *p)
+{
+    const exercise_cfg_t *cfg = &EX_CFG[ex];
+    p->thresh_k = cfg->thresh_k;
+    p->min_prominence_g = cfg->min_prominence_g;
+    p->refractory_ms = cfg->refractory_ms;
+    p->baseline_mu = REP_CTX[ex].baseline_mu;
+    p->sigma_floor = fmaxf(REP_CTX[ex].baseline_sigma, MIN_SIGMA_FLOOR_G);
+}
+
+/**
+ * @brief Updates rolling statistics (mean and standard deviation) in O(1).
+ */
+static void update_rolling_stats(rep_detector_t *d, const detect_params_t *p, float new_sample)
+{
+    // Replace the oldest sample in the integer running sums
+    int16_t s_new = to_window_sample(new_sample);
+    d->window_sum += s_new;
+    d->window_sum_sq += (int32_t)s_new * s_new;
+    if (d->window_filled)
+    {
+        int16_t s_old = d->window[d->window_index];
+        d->window_sum -= s_old;
+        d->window_sum_sq -= (int32_t)s_old * s_old;
+        if (MAD_BUILT && d->sorted) sorted_replace(d->sorted, d->window_len, s_old, s_new);
+    }
+    else if (MAD_BUILT && d->sorted)
+    {
+        sorted_insert(d->sorted, d->window_index, s_new);
+    }
+    
+    // Add new sample to buffer
+    d->window[d->window_index] = s_new;
+    if (++d->window_index >= d->window_len)
+    {
+        d->window_index = 0;
+        d->window_filled = true;
+    }
+    
+    // Mean and standard deviation from the running sums
+    int32_t count = d->window_filled ? d->window_len : d->window_index;
+    int64_t var_num = (int64_t)count * d->window_sum_sq - (int64_t)d->window_sum * d->window_sum;
+    float inv_scale = 1.0f / (count * REP_SAMPLE_SCALE);
+    d->state.mean = (float)d->window_sum * inv_scale;
+    d->state.std_dev = sqrtf((float)var_num) * inv_scale;
     
     // Update dynamic threshold using exercise-specific configuration
-    const exercise_cfg_t *cfg = &EX_CFG[ex];
-    float sigma_floor = fmaxf(REP_CTX[ex].baseline_sigma, MIN_SIGMA_FLOOR_G);
-    float rolling_sigma = fmaxf(rep_state[ex].std_dev, sigma_floor);
+    if (MAD_BUILT && d->sorted)
+    {
+        // Robust mode: a single large rep cannot inflate median or MAD
+        float median = d->sorted[count >> 1] * (1.0f / REP_SAMPLE_SCALE);
+        float robust_sigma = MAD_TO_SIGMA * sorted_mad(d->sorted, count) * (1.0f / REP_SAMPLE_SCALE);
+        
+        d->rolling_mu = median;
+        d->rolling_sigma = robust_sigma;
+        d->state.threshold = median + p->thresh_k * fmaxf(robust_sigma, p->sigma_floor);
+        return;
+    }
     
-    rep_state[ex].threshold = REP_CTX[ex].baseline_mu + cfg->thresh_k * rolling_sigma;
+    d->rolling_mu = d->state.mean;
+    d->rolling_sigma = d->state.std_dev;
+    
+    float rolling_sigma = fmaxf(d->state.std_dev, p->sigma_floor);
+    d->state.threshold = p->baseline_mu + p->thresh_k * rolling_sigma;
 }
 
+#if REP_EARLY_CONFIRM
 /**
- * @brief Updates the rep detection with a new sample.
+ * @brief Checks whether the current peak is established before it ends: the
+ *        signal is falling, has dropped EARLY_CONFIRM_DROP of the peak height
+ *        below the maximum, the maximum is prominent enough, and the duration
+ *        and spacing criteria are already met.
  */
-bool rep_detect_update(exercise_t ex, float sample, uint32_t now_ms)
+static bool early_peak_established(const RepDetectState_t *st, const detect_params_t *p,
+                                   float sample, float prev_sample, uint32_t now_us)
 {
-    if (ex >= EX_COUNT || !REP_CTX[ex].calibrated) return false;
+    float height = st->last_peak_value - st->threshold;
     
-    bool rep_detected = false;
+    return sample < prev_sample &&
+           sample <= st->last_peak_value - EARLY_CONFIRM_DROP * height &&
+           height >= p->min_prominence_g &&
+           (now_us - st->peak_start_time_us) >= 1000U * MIN_PEAK_INTERVAL_MS &&
+           (now_us - st->last_peak_time_us) >= 1000U * cadence_min_peak_gap_ms(MIN_PEAK_INTERVAL_MS);
+}
+#endif
+
+/**
+ * @brief Runs one sample through the detector.
+ *        With REP_EARLY_CONFIRM the count rises once the peak is established;
+ *        the rep criteria are applied again when it ends (prominence against
+ *        the threshold it was counted at, since the rolling sigma grows with
+ *        the peak itself) and a failed peak is taken back. The return value
+ *        is the final verdict either way.
+ * @retval bool true if the sample ends an accepted rep.
+ */
+static bool detect_sample(rep_detector_t *d, const detect_params_t *p, float sample, uint32_t now_us)
+{
+    RepDetectState_t *st = &d->state;
+    float prev_sample = d->prev_sample;
+    d->prev_sample = sample;
+    
+    // The template matcher and cadence tracker see every sample before its verdict
+    rep_template_update(sample);
+    cadence_update(sample);
     
     // Update rolling statistics
-    update_rolling_stats(ex, sample);
+    update_rolling_stats(d, p, sample);
     
     // Check if we have enough samples for reliable statistics
-    if (rep_state[ex].sample_count < ROLLING_BUFFER_SIZE)
+    if (st->sample_count < d->window_len)
     {
-        rep_state[ex].sample_count++;
+        st->sample_count++;
         return false;
     }
     
-    // Check refractory period using exercise-specific configuration
-    const exercise_cfg_t *cfg = &EX_CFG[ex];
-    if ((now_ms - rep_state[ex].last_rep_time_ms) < cfg->refractory_ms)
+    // Check refractory period: follows the tracked cadence, exercise default until it locks
+    if ((now_us - st->last_rep_time_us) < 1000U * cadence_refractory_ms(p->refractory_ms))
     {
         return false;
     }
     
     // Peak detection logic
-    if (!rep_state[ex].in_peak)
+    if (!st->in_peak)
     {
+        // A set restarted mid-peak lets that peak pass uncounted
+        if (st->skip_peak)
+        {
+            if (sample <= st->threshold) st->skip_peak = false;
+            return false;
+        }
+        
         // Look for start of peak (signal crosses above threshold)
-        if (sample > rep_state[ex].threshold)
+        if (sample > st->threshold)
         {
-            rep_state[ex].in_peak = true;
-            rep_state[ex].peak_start_time = now_ms;
-            rep_state[ex].last_peak_value = sample;
+            st->in_peak = true;
+            st->peak_start_time_us = now_us;
+            st->peak_max_time_us = now_us;
+            st->last_peak_value = sample;
+            rep_template_arm();
+#if ENABLE_REP_CLASSIFIER
+            rep_classifier_arm();
+#endif
         }
+        return false;
     }
-    else
+    
+    // We're in a peak, track the maximum value
+    if (sample > st->last_peak_value)
+    {
+        st->last_peak_value = sample;
+        st->peak_max_time_us = now_us;
+    }
+
+#if REP_EARLY_CONFIRM
+    // Count as soon as the maximum is established instead of after the return phase
+    if (!st->early_counted && early_peak_established(st, p, sample, prev_sample, now_us))
+    {
+        st->early_counted = true;
+        st->early_threshold = st->threshold;
+        d->rep_count++;
+    }
+#else
+    (void)prev_sample;
+#endif
+    
+    // Check if peak has ended (signal drops below threshold)
+    if (sample >= st->threshold)
+    {
+        return false;
+    }
+    
+    st->in_peak = false;
+    bool rep_detected = false;
+    
+    // Check if this peak meets the criteria for a rep
+    uint32_t peak_duration_us = now_us - st->peak_start_time_us;
+    
+    float prominence_base = st->early_counted ? st->early_threshold : st->threshold;
+    
+    if (peak_duration_us >= 1000U * MIN_PEAK_INTERVAL_MS &&
+        st->last_peak_value >= (prominence_base + p->min_prominence_g))
     {
-        // We're in a peak, track the maximum value
-        if (sample > rep_state[ex].last_peak_value)
+        // Check minimum interval between peaks, then the template shape
+        // (and the classifier when it is built in)
+        bool accept = (now_us - st->last_peak_time_us) >= 1000U * cadence_min_peak_gap_ms(MIN_PEAK_INTERVAL_MS) &&
+                      rep_template_confirm(peak_duration_us / 1000U, NULL);
+#if ENABLE_REP_CLASSIFIER
+        accept = rep_classifier_confirm() && accept;
+#endif
+        if (accept)
         {
-            rep_state[ex].last_peak_value = sample;
+            rep_detected = true;
+            if (!st->early_counted) d->rep_count++;
+            st->last_rep_time_us = now_us;
         }
-        
-        // Check if peak has ended (signal drops below threshold)
-        if (sample < rep_state[ex].threshold)
+    }
+    
+    // The whole peak is known now: an early count it fails is taken back
+    if (st->early_counted && !rep_detected)
+    {
+        d->rep_count--;
+        st->retracted_count++;
+    }
+    st->early_counted = false;
+    
+    st->last_peak_time_us = now_us;
+    return rep_detected;
+}
+
+/**
+ * @brief Adds the cycles of n detector samples to the per-sample average.
+ */
+static void account_cycles(uint32_t cycles, uint16_t n)
+{
+    cycle_sum += cycles;
+    cycle_samples += n;
+    if (cycle_samples >= CYCLE_AVG_SAMPLES)
+    {
+        cycles_per_sample = cycle_sum / cycle_samples;
+        cycle_sum = 0;
+        cycle_samples = 0;
+    }
+}
+
+/**
+ * @brief Updates the rep detection with a new sample.
+ *        Also feeds the sample to rep_template and cadence.
+ */
+bool rep_detect_update(exercise_t ex, float sample, uint32_t now_us)
+{
+    if (ex != active_ex || !REP_CTX[ex].calibrated) return false;
+    uint32_t t0 = DWT->CYCCNT;
+    
+    detect_params_t params;
+    load_params(ex, &params);
+    bool rep_detected = detect_sample(det, &params, sample, now_us);
+    
+    REP_CTX[ex].rolling_mu = det->rolling_mu;
+    REP_CTX[ex].rolling_sigma = det->rolling_sigma;
+    account_cycles(DWT->CYCCNT - t0, 1);
+    return rep_detected;
+}
+
+/**
+ * @brief Updates the rep detection with a block of filtered ring slots
+ *        (FIFO/DMA batches), reading rep_signal and the timestamp in place.
+ *        Same results as rep_detect_update() per sample, in order; blocks
+ *        longer than REP_DETECT_BLOCK_MAX are truncated.
+ * @retval uint32_t Bit k set if samples[k] ended an accepted rep.
+ */
+uint32_t rep_detect_update_block(exercise_t ex, const imu_sample_t *samples, uint16_t n)
+{
+    if (ex != active_ex || !REP_CTX[ex].calibrated || !samples) return 0;
+    if (n > REP_DETECT_BLOCK_MAX) n = REP_DETECT_BLOCK_MAX;
+    uint32_t t0 = DWT->CYCCNT;
+    
+    // Exercise parameters and the detector pointer stay in registers across the block
+    detect_params_t params;
+    load_params(ex, &params);
+    rep_detector_t *d = det;
+    
+    uint32_t rep_mask = 0;
+    for (uint16_t k = 0; k < n; k++)
+    {
+        if (detect_sample(d, &params, samples[k].rep_signal, samples[k].scaled.timestamp_us))
         {
-            rep_state[ex].in_peak = false;
-            
-            // Check if this peak meets the criteria for a rep
-            uint32_t peak_duration = now_ms - rep_state[ex].peak_start_time;
-            
-            if (peak_duration >= MIN_PEAK_INTERVAL_MS && 
-                rep_state[ex].last_peak_value >= (rep_state[ex].threshold + cfg->min_prominence_g))
-            {
-                // Check minimum interval between peaks
-                if ((now_ms - rep_state[ex].last_peak_time_ms) >= MIN_PEAK_INTERVAL_MS)
-                {
-                    rep_detected = true;
-                    rep_count[ex]++;
-                    rep_state[ex].last_rep_time_ms = now_ms;
-                }
-            }
-            
-            rep_state[ex].last_peak_time_ms = now_ms;
+            rep_mask |= 1UL << k;
         }
     }
     
-    return rep_detected;
+    REP_CTX[ex].rolling_mu = d->rolling_mu;
+    REP_CTX[ex].rolling_sigma = d->rolling_sigma;
+    account_cycles(DWT->CYCCNT - t0, n);
+    return rep_mask;
 }
 
 /**
- * @brief Gets the current rep count for a specific exercise.
+ * @brief Gets the current rep count for a specific exercise, including a
+ *        peak counted early (REP_EARLY_CONFIRM) that may still be taken back.
  */
 uint16_t rep_detect_get_count(exercise_t ex)
 {
-    if (ex >= EX_COUNT) return 0;
-    return rep_count[ex];
+    if (ex != active_ex) return 0;
+    return det->rep_count;
 }
 
 /**
- * @brief Resets the rep counter for a specific exercise.
+ * @brief Resets the rep counter for a specific exercise. A peak in progress
+ *        is dropped with its template/classifier capture and not re-entered
+ *        until the signal falls below threshold, so a set started mid-rep
+ *        counts from the next rep.
  */
 void rep_detect_reset_count(exercise_t ex)
 {
-    if (ex >= EX_COUNT) return;
+    if (ex != active_ex) return;
     
-    rep_count[ex] = 0;
-    rep_state[ex].last_rep_time_ms = 0;
-    rep_state[ex].last_peak_time_ms = 0;
+    det->rep_count = 0;
+    det->state.last_rep_time_us = 0;
+    det->state.last_peak_time_us = 0;
+    det->state.last_peak_value = 0.0f;
+    det->state.skip_peak = det->state.in_peak;
+    det->state.in_peak = false;
+    det->state.peak_start_time_us = 0;
+    det->state.peak_max_time_us = 0;
+    det->state.early_counted = false;
+    det->state.early_threshold = 0.0f;
+    det->state.retracted_count = 0;
+    rep_template_disarm();
+#if ENABLE_REP_CLASSIFIER
+    rep_classifier_disarm();
+#endif
 }
 
 /**
@@ -252,6 +659,15 @@ void rep_detect_reset_count(exercise_t ex)
  */
 void rep_detect_get_state(exercise_t ex, RepDetectState_t *state)
 {
-    if (ex >= EX_COUNT || state == NULL) return;
-    *state = rep_state[ex];
+    if (ex != active_ex || state == NULL) return;
+    *state = det->state;
+}
+
+/**
+ * @brief Average cycles per detector sample over the last CYCLE_AVG_SAMPLES
+ *        samples, for whichever API is in use (DWT measured).
+ */
+uint32_t rep_detect_get_cycles_per_sample(void)
+{
+    return cycles_per_sample;
 }
@@ -0,0 +1,251 @@
+#include "rep_features.h"
+#include <math.h>
+#include <stddef.h>
+
+// A phase also ends where the velocity turns back within this fraction of its
+// extreme: integration drift can keep it from reaching zero exactly
+#define TURN_FRACTION 0.1f
+
+// Movement phases, split where the integrated velocity crosses zero
+typedef enum {
+    PHASE_REST = 0,    // Waiting for the rep signal to rise above baseline
+    PHASE_CONCENTRIC,  // Onset until the velocity falls back to zero (top of the rep)
+    PHASE_ECCENTRIC    // Top until the velocity returns to zero
+} phase_t;
+
+// Streaming accumulators for the rep in progress. Everything restarts at the
+// next onset, so no part of the rep is ever buffered.
+static float baseline_g = 0.0f;
+static phase_t phase = PHASE_REST;
+static bool confirmed = false;       // The detector counted this excursion
+static uint32_t confirm_us = 0;
+static uint32_t onset_us = 0;
+static uint32_t peak_us = 0;
+static float peak_accel = 0.0f;
+static float peak_prev = 0.0f;       // Sample before the peak (parabolic refinement)
+static float peak_offset_us = 0.0f;  // Sub-sample correction of peak_us
+static bool peak_refine = false;     // Waiting for the sample after the peak
+static float prev_accel = 0.0f;
+static float velocity = 0.0f;
+static float peak_velocity = 0.0f;
+static float valley_velocity = 0.0f;  // Most negative velocity of the eccentric phase
+static bool braking = false;          // The lobe slowing the current phase has started
+static float angle_deg[3] = {0.0f, 0.0f, 0.0f};
+static float top_rel_us = 0.0f;      // Top of the rep, from onset
+static float rom_deg = 0.0f;
+
+// Last completed rep
+static rep_record_t last_record;
+static bool has_record = false;
+
+/**
+ * @brief Restarts the accumulators at movement onset.
+ */
+static void restart(uint32_t now_us)
+{
+    onset_us = now_us;
+    peak_us = now_us;
+    peak_accel = 0.0f;
+    peak_prev = 0.0f;
+    peak_offset_us = 0.0f;
+    peak_refine = false;
+    prev_accel = 0.0f;
+    velocity = 0.0f;
+    peak_velocity = 0.0f;
+    valley_velocity = 0.0f;
+    braking = false;
+    angle_deg[0] = 0.0f;
+    angle_deg[1] = 0.0f;
+    angle_deg[2] = 0.0f;
+    top_rel_us = 0.0f;
+    rom_deg = 0.0f;
+    confirmed = false;
+}
+
+/**
+ * @brief Places the peak between samples by fitting a parabola through the
+ *        peak and its two neighbours (offset clamped to half a sample).
+ */
+static void refine_peak(float next, float dt)
+{
+    float denom = peak_prev - 2.0f * peak_accel + next;
+    if (denom >= 0.0f) return;
+    
+    float delta = 0.5f * (peak_prev - next) / denom;
+    if (delta > 0.5f) delta = 0.5f;
+    if (delta < -0.5f) delta = -0.5f;
+    peak_offset_us = delta * dt * 1000000.0f;
+}
+
+/**
+ * @brief Places a zero crossing (velocity or acceleration) within the sample
+ *        that produced it.
+ * @retval float Crossing time relative to onset.
+ */
+static float crossing_rel_us(float prev, float cur, float dt, uint32_t now_us)
+{
+    float frac = (prev != cur) ? prev / (prev - cur) : 1.0f;
+    if (frac < 0.0f) frac = 0.0f;
+    if (frac > 1.0f) frac = 1.0f;
+    float rel_us = (float)(now_us - onset_us) - (1.0f - frac) * dt * 1000000.0f;
+    return (rel_us > 0.0f) ? rel_us : 0.0f;
+}
+
+/**
+ * @brief Emits the record of a confirmed rep.
+ * @param eccentric_us Eccentric phase length, 0 if its end was not seen.
+ */
+static void emit_record(float eccentric_us)
+{
+    // Peak time with sub-sample resolution
+    float peak_rel_us = (float)(peak_us - onset_us) + peak_offset_us;
+    if (peak_rel_us < 0.0f) peak_rel_us = 0.0f;
+    if (peak_rel_us > top_rel_us) peak_rel_us = top_rel_us;
+    
+    last_record.rep_end_us = confirm_us;
+    last_record.concentric_ms = (uint16_t)(top_rel_us * 0.001f + 0.5f);
+    last_record.eccentric_ms = (uint16_t)(eccentric_us * 0.001f + 0.5f);
+    last_record.peak_accel_ms = (uint16_t)(peak_rel_us * 0.001f + 0.5f);
+    last_record.peak_accel_g = peak_accel;
+    last_record.peak_velocity_mps = peak_velocity;
+    last_record.rom_deg = rom_deg;
+    has_record = true;
+}
+
+/**
+ * @brief Resets the extractor with the calibrated baseline of the rep signal.
+ */
+void rep_features_reset(float baseline)
+{
+    baseline_g = baseline;
+    phase = PHASE_REST;
+    restart(0);
+    has_record = false;
+}
+
+/**
+ * @brief Feeds one sample into the extractor (O(1)).
+ */
+void rep_features_update(float sample, const float gyro_dps[3], float dt, uint32_t now_us)
+{
+    float accel = sample - baseline_g;
+    
+    // The next excursion above baseline starts a new rep; until the detector
+    // counts it, dropping back to baseline makes it noise
+    if (phase == PHASE_CONCENTRIC && !confirmed && accel <= 0.0f)
+    {
+        phase = PHASE_REST;
+    }
+    if (phase == PHASE_REST)
+    {
+        if (accel <= 0.0f) return;
+        restart(now_us);
+        phase = PHASE_CONCENTRIC;
+    }
+    
+    // Both lobes are integrated: the velocity only returns to zero once the
+    // deceleration has cancelled the push
+    float v_prev = velocity;
+    float a_prev = prev_accel;
+    velocity += accel * STANDARD_GRAVITY_MPS2 * dt;
+    angle_deg[0] += gyro_dps[0] * dt;
+    angle_deg[1] += gyro_dps[1] * dt;
+    angle_deg[2] += gyro_dps[2] * dt;
+    prev_accel = accel;
+    float elapsed_us = (float)(now_us - onset_us);
+    
+    if (phase == PHASE_CONCENTRIC)
+    {
+        if (accel > peak_accel)
+        {
+            peak_accel = accel;
+            peak_us = now_us;
+            peak_prev = a_prev;
+            peak_offset_us = 0.0f;
+            peak_refine = true;
+        }
+        else if (peak_refine)
+        {
+            refine_peak(accel, dt);
+            peak_refine = false;
+        }
+        
+        if (velocity > peak_velocity)
+        {
+            peak_velocity = velocity;
+        }
+        if (accel < 0.0f) braking = true;
+        
+        // Top of the rep: the velocity is back to zero, or turns just short of it
+        if (velocity <= 0.0f)
+        {
+            top_rel_us = crossing_rel_us(v_prev, velocity, dt, now_us);
+        }
+        else if (braking && accel >= 0.0f && velocity < TURN_FRACTION * peak_velocity)
+        {
+            top_rel_us = crossing_rel_us(a_prev, accel, dt, now_us);
+        }
+        else
+        {
+            if (elapsed_us >= 1000.0f * REP_FEATURES_MAX_PHASE_MS) phase = PHASE_REST;  // Never turned
+            return;
+        }
+        
+        // Range of motion about the axis that rotated the most
+        rom_deg = fabsf(angle_deg[0]);
+        if (fabsf(angle_deg[1]) > rom_deg) rom_deg = fabsf(angle_deg[1]);
+        if (fabsf(angle_deg[2]) > rom_deg) rom_deg = fabsf(angle_deg[2]);
+        
+        // The limb is at rest at the top: the return integrates from zero
+        phase = PHASE_ECCENTRIC;
+        velocity = 0.0f;
+        braking = false;
+        return;
+    }
+    
+    // Eccentric: ends at the bottom, where the velocity is back to zero or turns just short of it
+    if (velocity < valley_velocity)
+    {
+        valley_velocity = velocity;
+    }
+    bool returning = valley_velocity < -TURN_FRACTION * peak_velocity;
+    if (accel > 0.0f && returning) braking = true;
+    
+    if (velocity >= 0.0f && returning)
+    {
+        emit_record(crossing_rel_us(v_prev, velocity, dt, now_us) - top_rel_us);
+    }
+    else if (braking && accel <= 0.0f && velocity > TURN_FRACTION * valley_velocity)
+    {
+        emit_record(crossing_rel_us(a_prev, accel, dt, now_us) - top_rel_us);
+    }
+    else if (elapsed_us >= top_rel_us + 1000.0f * REP_FEATURES_MAX_PHASE_MS)
+    {
+        emit_record(0.0f);
+    }
+    else
+    {
+        return;
+    }
+    phase = PHASE_REST;
+}
+
+/**
+ * @brief Marks the excursion in progress as a counted rep.
+ */
+void rep_features_confirm(uint32_t now_us)
+{
+    if (phase != PHASE_CONCENTRIC) return;
+    confirmed = true;
+    confirm_us = now_us;
+}
+
+/**
+ * @brief Gets the record of the last completed rep.
+ */
+bool rep_features_get_last(rep_record_t *record)
+{
+    if (!has_record || record == NULL) return false;
+    *record = last_record;
+    return true;
+}
@@ -0,0 +1,262 @@
+#include "rep_template.h"
+#include "rep_detect.h"
+#include "app_config.h"
+#include "stm32f1xx_hal.h"
+#include <math.h>
+#include <stddef.h>
+
+#define DECIM_FACTOR (IMU_SAMPLE_HZ / REP_TEMPLATE_HZ)
+#define DTW_INF      (INT32_MAX / 2)
+
+#if (IMU_SAMPLE_HZ % REP_TEMPLATE_HZ) != 0
+#error "IMU_SAMPLE_HZ must be a multiple of REP_TEMPLATE_HZ"
+#endif
+
+// Reference rep with its LB_Keogh envelope, all int16 in REP_SAMPLE_SCALE units
+typedef struct {
+    int16_t data[REP_TEMPLATE_MAX_LEN];
+    int16_t upper[REP_TEMPLATE_MAX_LEN];
+    int16_t lower[REP_TEMPLATE_MAX_LEN];
+    uint8_t len;
+    int32_t mass;  // Sum of |data|, normalizes distances into scores
+} rep_template_t;
+
+static rep_template_t templates[REP_TEMPLATE_COUNT];
+static uint8_t template_count = 0;
+static exercise_t template_ex = EX_COUNT;
+
+// Decimated history, written twice so the last n samples are always contiguous
+static int16_t history[2 * REP_TEMPLATE_MAX_LEN];
+static uint8_t history_pos = 0;
+static uint8_t history_len = 0;
+static int32_t decim_sum = 0;
+static uint8_t decim_phase = 0;
+
+// DTW rows (one band-limited cost matrix row each)
+static int32_t dtw_prev[REP_TEMPLATE_MAX_LEN];
+static int32_t dtw_cur[REP_TEMPLATE_MAX_LEN];
+
+// Best (lowest) score since the last arm, and the score of the last confirmed rep
+static float best_score = INFINITY;
+static float last_score = INFINITY;
+static uint32_t cycles_max = 0;
+
+/**
+ * Drops the templates when another exercise is selected.
+ */
+void rep_template_reset(exercise_t ex)
+{
+    template_ex = ex;
+    template_count = 0;
+    history_pos = 0;
+    history_len = 0;
+    decim_sum = 0;
+    decim_phase = 0;
+    best_score = INFINITY;
+    last_score = INFINITY;
+}
+
+/**
+ * Builds the upper/lower envelope of a template over the DTW band.
+ */
+static void build_envelope(rep_template_t *t)
+{
+    t->mass = 0;
+    for (int i = 0; i < t->len; i++) {
+        int lo = i - REP_TEMPLATE_BAND < 0 ? 0 : i - REP_TEMPLATE_BAND;
+        int hi = i + REP_TEMPLATE_BAND >= t->len ? t->len - 1 : i + REP_TEMPLATE_BAND;
+        int16_t u = t->data[lo];
+        int16_t l = t->data[lo];
+        for (int j = lo + 1; j <= hi; j++) {
+            if (t->data[j] > u) u = t->data[j];
+            if (t->data[j] < l) l = t->data[j];
+        }
+        t->upper[i] = u;
+        t->lower[i] = l;
+        t->mass += t->data[i] < 0 ? -t->data[i] : t->data[i];
+    }
+    if (t->mass < 1) t->mass = 1;
+}
+
+/**
+ * LB_Keogh lower bound of the banded L1 DTW distance, abandoned once it
+ * exceeds bound.
+ */
+static int32_t lb_keogh(const int16_t *q, const rep_template_t *t, int32_t bound)
+{
+    int32_t lb = 0;
+    for (int i = 0; i < t->len; i++) {
+        if (q[i] > t->upper[i]) lb += q[i] - t->upper[i];
+        else if (q[i] < t->lower[i]) lb += t->lower[i] - q[i];
+        if (lb > bound) break;
+    }
+    return lb;
+}
+
+/**
+ * L1 DTW with a Sakoe-Chiba band, rolled over two rows. Abandons as soon as a
+ * whole row exceeds bound (every warping path crosses every row).
+ */
+static int32_t dtw_banded(const int16_t *q, const int16_t *t, int n, int32_t bound)
+{
+    for (int j = 0; j < n; j++) dtw_prev[j] = DTW_INF;
+    
+    for (int i = 0; i < n; i++) {
+        int lo = i - REP_TEMPLATE_BAND < 0 ? 0 : i - REP_TEMPLATE_BAND;
+        int hi = i + REP_TEMPLATE_BAND >= n ? n - 1 : i + REP_TEMPLATE_BAND;
+        int32_t row_min = DTW_INF;
+        
+        for (int j = lo; j <= hi; j++) {
+            int32_t d = q[i] - t[j];
+            if (d < 0) d = -d;
+            
+            int32_t best;
+            if (i == 0 && j == 0) {
+                best = 0;
+            } else {
+                best = dtw_prev[j];
+                if (j > 0 && dtw_prev[j - 1] < best) best = dtw_prev[j - 1];
+                if (j > lo && dtw_cur[j - 1] < best) best = dtw_cur[j - 1];
+            }
+            
+            int32_t c = d + best;
+            if (c > DTW_INF) c = DTW_INF;
+            dtw_cur[j] = c;
+            if (c < row_min) row_min = c;
+        }
+        if (hi + 1 < n) dtw_cur[hi + 1] = DTW_INF;
+        
+        if (row_min > bound) return DTW_INF;
+        
+        for (int j = lo; j <= hi; j++) dtw_prev[j] = dtw_cur[j];
+        if (lo > 0) dtw_prev[lo - 1] = DTW_INF;
+        if (hi + 1 < n) dtw_prev[hi + 1] = DTW_INF;
+    }
+    return dtw_prev[n - 1] > bound ? DTW_INF : dtw_prev[n - 1];
+}
+
+/**
+ * Scores the most recent window against every template. Each template is
+ * pruned by LB_Keogh first and the DTW is abandoned early, both against the
+ * best score seen since the last arm, so most windows cost O(len).
+ */
+static void score_window(void)
+{
+    uint32_t t0 = DWT->CYCCNT;
+    float score = INFINITY;
+    float bound_score = best_score;
+    
+    for (int k = 0; k < template_count; k++) {
+        const rep_template_t *t = &templates[k];
+        if (t->len > history_len) continue;
+        
+        const int16_t *q = &history[history_pos + REP_TEMPLATE_MAX_LEN - t->len];
+        float limit = (score < bound_score ? score : bound_score) * (float)t->mass;
+        int32_t bound = limit < (float)DTW_INF ? (int32_t)limit : DTW_INF;
+        
+        if (lb_keogh(q, t, bound) > bound) continue;
+        int32_t dist = dtw_banded(q, t->data, t->len, bound);
+        if (dist >= DTW_INF) continue;
+        
+        float s = (float)dist / (float)t->mass;
+        if (s < score) score = s;
+    }
+    
+    if (score < best_score) best_score = score;
+    
+    uint32_t cycles = DWT->CYCCNT - t0;
+    if (cycles > cycles_max) cycles_max = cycles;
+}
+
+/**
+ * Feeds one rep signal sample (IMU_SAMPLE_HZ); matching runs at REP_TEMPLATE_HZ.
+ */
+void rep_template_update(float sample)
+{
+    float scaled = sample * REP_SAMPLE_SCALE;
+    if (scaled > 32767.0f) scaled = 32767.0f;
+    if (scaled < -32768.0f) scaled = -32768.0f;
+    decim_sum += (int32_t)scaled;
+    if (++decim_phase < DECIM_FACTOR) return;
+    
+    int16_t s = (int16_t)(decim_sum / DECIM_FACTOR);
+    decim_sum = 0;
+    decim_phase = 0;
+    
+    history[history_pos] = s;
+    history[history_pos + REP_TEMPLATE_MAX_LEN] = s;
+    if (++history_pos >= REP_TEMPLATE_MAX_LEN) history_pos = 0;
+    if (history_len < REP_TEMPLATE_MAX_LEN) history_len++;
+    
+    if (template_count > 0) score_window();
+}
+
+/**
+ * Starts a new candidate rep (called at the threshold crossing).
+ */
+void rep_template_arm(void)
+{
+    best_score = INFINITY;
+}
+
+/**
+ * Drops the candidate rep without judging it (the set was restarted
+ * mid-peak). Enrolled templates are kept.
+ */
+void rep_template_disarm(void)
+{
+    best_score = INFINITY;
+}
+
+/**
+ * Closes a threshold-detected rep. The first REP_TEMPLATE_COUNT reps are
+ * enrolled as templates and always accepted; later reps are accepted when
+ * their best score is within the exercise's template_gate (0 = score only).
+ */
+bool rep_template_confirm(uint32_t segment_ms, float *out_score)
+{
+    float score = best_score;
+    best_score = INFINITY;
+    last_score = score;
+    if (out_score) *out_score = score;
+    
+    if (template_count < REP_TEMPLATE_COUNT) {
+        uint32_t len = ((segment_ms + REP_TEMPLATE_PREROLL_MS) * REP_TEMPLATE_HZ) / 1000U;
+        if (len > REP_TEMPLATE_MAX_LEN) len = REP_TEMPLATE_MAX_LEN;
+        if (len > history_len) len = history_len;
+        if (len < REP_TEMPLATE_MIN_LEN) return true;
+        
+        rep_template_t *t = &templates[template_count];
+        const int16_t *src = &history[history_pos + REP_TEMPLATE_MAX_LEN - len];
+        for (uint32_t i = 0; i < len; i++) t->data[i] = src[i];
+        t->len = (uint8_t)len;
+        build_envelope(t);
+        template_count++;
+        return true;
+    }
+    
+    float gate = (template_ex < EX_COUNT) ? EX_CFG[template_ex].template_gate : 0.0f;
+    return gate <= 0.0f || score <= gate;
+}
+
+/**
+ * Score of the last confirmed rep: banded DTW distance over template mass,
+ * 0 for an identical shape, INFINITY while templates are being enrolled.
+ */
+float rep_template_get_score(void)
+{
+    return last_score;
+}
+
+uint8_t rep_template_get_count(void)
+{
+    return template_count;
+}
+
+/**
+ * Worst-case cycles spent scoring one decimated window (DWT measured).
+ */
+uint32_t rep_template_get_cycles_max(void)
+{
+    return cycles_max;
+}
@@ -65,7 +65,7 @@ void ui_show_select(const char* exercise_name)
     ssd1306_draw_text(exercise_x, 1, exercise_name);
     
     // Show instruction on third line
-    const char* instruction = "Auto-advance in 2s";
+    const char* instruction = "Tap:next Hold:start";
     uint8_t instruction_x = center_text_x(instruction);
     ssd1306_draw_text(instruction_x, 2, instruction);
     
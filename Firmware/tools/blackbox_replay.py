@@ -0,0 +1,124 @@
+"""Replay a black-box dump (src/app/blackbox.c): the detector timeline around
+the trigger, and the raw samples as a trace CSV.
+
+Read the dump over the host protocol, or straight from flash:
+    python tools/tune_params.py -p /dev/ttyUSB0 blackbox -o dump.bin
+    st-flash read dump.bin 0x08015800 0x2000
+    python tools/blackbox_replay.py dump.bin
+    python tools/blackbox_replay.py dump.bin -o miscount
+
+The timeline has one row per detector snapshot (every snapshot_every
+samples, and at the trigger), timed from the trigger. -o writes
+<prefix>.csv with the header
+    ax,ay,az,gx,gy,gz,exercise,rep_end
+(raw sensor units converted like tools/trace_decode.py, rep_end = 0, ready
+to be labeled) and <prefix>_detector.csv with the snapshots, indexed by
+sample. The layout mirrors include/blackbox.h.
+"""
+import argparse
+import struct
+import sys
+
+BLACKBOX_MAGIC = 0x58424242
+BLACKBOX_VERSION = 1
+HEADER = struct.Struct("<IBBBBHHHHIIII")
+SNAPSHOT = struct.Struct("<IffffHBB")
+SAMPLE = struct.Struct("<6h")
+
+REASONS = {1: "double press", 2: "retracted rep", 3: "host request"}
+FLAG_IN_PEAK, FLAG_EARLY = 0x01, 0x02
+EVENT_REP, EVENT_RETRACT, EVENT_TRIGGER = 0x01, 0x02, 0x04
+
+ACCEL_LSB_PER_G = 16384.0     # +/-2 g (mpu6050.c)
+GYRO_LSB_PER_DPS = 131.0      # +/-250 deg/s
+
+
+def parse_dump(data):
+    """Returns (header dict, samples, snapshots); samples are rows of 6 raw
+    ints, snapshots dicts with the sample index they were taken after."""
+    if len(data) < HEADER.size:
+        raise ValueError("dump too short")
+    (magic, version, reason, exercise, snapshot_every, sample_hz, sample_count, snapshot_count,
+     trigger_index, first_seq, last_us, uptime_ms, _) = HEADER.unpack_from(data, 0)
+    if magic != BLACKBOX_MAGIC or version != BLACKBOX_VERSION:
+        raise ValueError("no black-box dump (magic 0x%08x, version %d)" % (magic, version))
+    hdr = dict(reason=reason, exercise=exercise, snapshot_every=snapshot_every, sample_hz=sample_hz,
+               sample_count=sample_count, snapshot_count=snapshot_count, trigger_index=trigger_index,
+               first_seq=first_seq, last_us=last_us, uptime_ms=uptime_ms)
+
+    off = HEADER.size
+    size = off + sample_count * SAMPLE.size + snapshot_count * SNAPSHOT.size
+    if len(data) < size:
+        raise ValueError("dump truncated: %d of %d bytes" % (len(data), size))
+    samples = [list(SAMPLE.unpack_from(data, off + i * SAMPLE.size)) for i in range(sample_count)]
+    off += sample_count * SAMPLE.size
+
+    snapshots = []
+    for i in range(snapshot_count):
+        seq, signal, threshold, baseline, sigma, count, flags, events = SNAPSHOT.unpack_from(data, off)
+        snapshots.append(dict(index=seq - first_seq, rep_signal=signal, threshold=threshold,
+                              baseline_mu=baseline, rolling_sigma=sigma, rep_count=count,
+                              flags=flags, events=events))
+        off += SNAPSHOT.size
+    return hdr, samples, snapshots
+
+
+def describe(bits, names):
+    return ",".join(name for bit, name in names if bits & bit) or "-"
+
+
+def print_timeline(hdr, snapshots):
+    hz = float(hdr["sample_hz"] or 1)
+    print("%8s %6s %9s %9s %9s %8s %5s %-11s %s" % (
+        "t [s]", "sample", "signal", "threshold", "baseline", "sigma", "count", "state", "events"))
+    for snap in snapshots:
+        t = (snap["index"] - hdr["trigger_index"]) / hz
+        state = describe(snap["flags"], [(FLAG_IN_PEAK, "peak"), (FLAG_EARLY, "early")])
+        events = describe(snap["events"], [(EVENT_REP, "rep"), (EVENT_RETRACT, "retract"),
+                                           (EVENT_TRIGGER, "TRIGGER")])
+        above = "^" if snap["rep_signal"] > snap["threshold"] else " "
+        print("%+8.3f %6d %9.4f%s%9.4f %9.4f %8.4f %5d %-11s %s" % (
+            t, snap["index"], snap["rep_signal"], above, snap["threshold"], snap["baseline_mu"],
+            snap["rolling_sigma"], snap["rep_count"], state, events))
+
+
+def write_csv(prefix, hdr, samples, snapshots):
+    with open(prefix + ".csv", "w") as f:
+        f.write("ax,ay,az,gx,gy,gz,exercise,rep_end\n")
+        for r in samples:
+            f.write("%.6f,%.6f,%.6f,%.4f,%.4f,%.4f,%d,0\n" % (
+                r[0] / ACCEL_LSB_PER_G, r[1] / ACCEL_LSB_PER_G, r[2] / ACCEL_LSB_PER_G,
+                r[3] / GYRO_LSB_PER_DPS, r[4] / GYRO_LSB_PER_DPS, r[5] / GYRO_LSB_PER_DPS, hdr["exercise"]))
+    with open(prefix + "_detector.csv", "w") as f:
+        f.write("sample,rep_signal,threshold,baseline_mu,rolling_sigma,rep_count,flags,events\n")
+        for s in snapshots:
+            f.write("%d,%.6f,%.6f,%.6f,%.6f,%d,%d,%d\n" % (
+                s["index"], s["rep_signal"], s["threshold"], s["baseline_mu"], s["rolling_sigma"],
+                s["rep_count"], s["flags"], s["events"]))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("dump", help="black-box dump (tune_params.py blackbox, or FLASH_STORE_BLACKBOX_ADDR image)")
+    ap.add_argument("-o", "--out", help="write <prefix>.csv and <prefix>_detector.csv")
+    args = ap.parse_args()
+
+    with open(args.dump, "rb") as f:
+        data = f.read()
+    try:
+        hdr, samples, snapshots = parse_dump(data)
+    except ValueError as e:
+        sys.exit("blackbox_replay: %s" % e)
+
+    hz = float(hdr["sample_hz"] or 1)
+    print("%s at %.1f s uptime: exercise %d, %d samples (%.2f s), trigger at %+.2f s from the end" % (
+        REASONS.get(hdr["reason"], "reason %d" % hdr["reason"]), hdr["uptime_ms"] / 1000.0, hdr["exercise"],
+        hdr["sample_count"], hdr["sample_count"] / hz, (hdr["trigger_index"] - hdr["sample_count"]) / hz))
+    print_timeline(hdr, snapshots)
+    if args.out:
+        write_csv(args.out, hdr, samples, snapshots)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
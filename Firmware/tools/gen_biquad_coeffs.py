@@ -0,0 +1,160 @@
+"""Generate include/biquad_coeffs.h from include/filter_spec.def and include/exercises.def.
+
+Coefficients follow the RBJ audio-EQ cookbook for the IMU_SAMPLE_HZ defined in
+include/app_config.h and are quantized to Q29 for the integer Direct-Form-I
+kernel in src/sensing/biquad.c. The feedback terms are stored negated so the
+kernel only ever accumulates (SMLAL on the Cortex-M3).
+
+Runs as a PlatformIO pre-build script (extra_scripts = pre:...) or standalone:
+    python tools/gen_biquad_coeffs.py
+"""
+import math
+import os
+import re
+
+COEFF_Q = 29
+
+
+def project_dir():
+    try:
+        Import("env")  # noqa: F821 - provided by PlatformIO/SCons
+        return env.subst("$PROJECT_DIR")  # noqa: F821
+    except NameError:
+        return os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def read_sample_hz(root):
+    with open(os.path.join(root, "include", "app_config.h")) as f:
+        m = re.search(r"#define\s+IMU_SAMPLE_HZ\s+(\d+)", f.read())
+    if not m:
+        raise SystemExit("gen_biquad_coeffs: IMU_SAMPLE_HZ not found in app_config.h")
+    return int(m.group(1))
+
+
+STAGE_ARGS = r"\(\s*(\w+)\s*,\s*(\w+)\s*,\s*([\d.]+)\s*,\s*([\d.]+)\s*\)"
+
+
+def read_spec(root):
+    banks = {}
+    pattern = re.compile(r"^\s*FILTER_STAGE" + STAGE_ARGS)
+    with open(os.path.join(root, "include", "filter_spec.def")) as f:
+        for line in f:
+            m = pattern.match(line)
+            if m:
+                bank, kind, f0, q = m.group(1), m.group(2), float(m.group(3)), float(m.group(4))
+                banks.setdefault(bank, []).append((kind, f0, q))
+    return banks
+
+
+def read_exercises(root):
+    """Returns [(exercise id, [stages])] in registry order."""
+    exercises = {}
+    entry = re.compile(r"^\s*EXERCISE\(\s*(\w+)\s*,")
+    stage = re.compile(r"^\s*REP_FILTER" + STAGE_ARGS)
+    with open(os.path.join(root, "include", "exercises.def")) as f:
+        for line in f:
+            m = entry.match(line)
+            if m:
+                exercises.setdefault(m.group(1), [])
+            m = stage.match(line)
+            if m:
+                if m.group(1) not in exercises:
+                    raise SystemExit("gen_biquad_coeffs: REP_FILTER before EXERCISE(%s)" % m.group(1))
+                exercises[m.group(1)].append((m.group(2), float(m.group(3)), float(m.group(4))))
+    for name, stages in exercises.items():
+        if not stages:
+            raise SystemExit("gen_biquad_coeffs: exercise %s has no REP_FILTER stages" % name)
+    return list(exercises.items())
+
+
+def design(kind, f0, q, fs):
+    if not 0.0 < f0 < fs / 2.0:
+        raise SystemExit("gen_biquad_coeffs: f0 %.3f Hz outside (0, %d) Hz" % (f0, fs // 2))
+    w0 = 2.0 * math.pi * f0 / fs
+    cw, sw = math.cos(w0), math.sin(w0)
+    alpha = sw / (2.0 * q)
+    if kind == "LOWPASS":
+        b = [(1.0 - cw) / 2.0, 1.0 - cw, (1.0 - cw) / 2.0]
+    elif kind == "HIGHPASS":
+        b = [(1.0 + cw) / 2.0, -(1.0 + cw), (1.0 + cw) / 2.0]
+    elif kind == "BANDPASS":
+        b = [alpha, 0.0, -alpha]  # 0 dB peak gain
+    else:
+        raise SystemExit("gen_biquad_coeffs: unknown filter type %s" % kind)
+    a0 = 1.0 + alpha
+    a = [-2.0 * cw, 1.0 - alpha]
+    return [x / a0 for x in b], [x / a0 for x in a]
+
+
+def quantize(b, a):
+    scale = float(1 << COEFF_Q)
+    q = [int(round(x * scale)) for x in b] + [int(round(-x * scale)) for x in a]
+    for v in q:
+        if not -(1 << 31) <= v < (1 << 31):
+            raise SystemExit("gen_biquad_coeffs: coefficient overflows Q%d" % COEFF_Q)
+    return q
+
+
+def stage_init(kind, f0, q, fs):
+    b0, b1, b2, na1, na2 = quantize(*design(kind, f0, q, fs))
+    return "{%d, %d, %d, %d, %d}, // %s %.2f Hz Q %.4f" % (b0, b1, b2, na1, na2, kind, f0, q)
+
+
+def render(fs, banks, rep_banks):
+    if "SMOOTH" not in banks:
+        raise SystemExit("gen_biquad_coeffs: SMOOTH bank missing")
+    max_stages = max([len(v) for _, v in rep_banks] + [1])
+
+    out = []
+    out.append("// Generated by tools/gen_biquad_coeffs.py from include/filter_spec.def and")
+    out.append("// include/exercises.def. Do not edit.")
+    out.append("#ifndef BIQUAD_COEFFS_H")
+    out.append("#define BIQUAD_COEFFS_H")
+    out.append("")
+    out.append('#include "biquad.h"')
+    out.append('#include "exercise_config.h"')
+    out.append("")
+    out.append("#define BIQUAD_SAMPLE_HZ %d" % fs)
+    out.append("#define BIQUAD_SMOOTH_STAGES %d" % len(banks["SMOOTH"]))
+    out.append("#define BIQUAD_BANK_MAX_STAGES %d" % max_stages)
+    out.append("")
+    out.append("// 3-axis gyro smoothing")
+    out.append("static const biquad_coeffs_t BIQUAD_SMOOTH_COEFFS[BIQUAD_SMOOTH_STAGES] = {")
+    for st in banks["SMOOTH"]:
+        out.append("    " + stage_init(st[0], st[1], st[2], fs))
+    out.append("};")
+    out.append("")
+    out.append("// Per-exercise rep signal banks (only the built exercises take flash)")
+    out.append("static const biquad_coeffs_t BIQUAD_BANK_COEFFS[EX_COUNT][BIQUAD_BANK_MAX_STAGES] = {")
+    for name, stages in rep_banks:
+        out.append("#if EX_ENABLE_%s" % name)
+        out.append("    [EX_%s] = {" % name)
+        for st in stages:
+            out.append("        " + stage_init(st[0], st[1], st[2], fs))
+        out.append("    },")
+        out.append("#endif")
+    out.append("};")
+    out.append("")
+    out.append("static const uint8_t BIQUAD_BANK_STAGES[EX_COUNT] = {")
+    for name, stages in rep_banks:
+        out.append("#if EX_ENABLE_%s" % name)
+        out.append("    [EX_%s] = %d," % (name, len(stages)))
+        out.append("#endif")
+    out.append("};")
+    out.append("")
+    out.append("#endif // BIQUAD_COEFFS_H")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    root = project_dir()
+    text = render(read_sample_hz(root), read_spec(root), read_exercises(root))
+    path = os.path.join(root, "include", "biquad_coeffs.h")
+    old = open(path).read() if os.path.exists(path) else None
+    if text != old:
+        with open(path, "w") as f:
+            f.write(text)
+        print("gen_biquad_coeffs: wrote %s" % path)
+
+
+main()
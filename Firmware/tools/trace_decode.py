@@ -0,0 +1,192 @@
+"""Decode the raw IMU trace log (src/app/trace_store.c) into CSV traces.
+
+The input is an image of the trace log pages, e.g. read with an ST-Link:
+    st-flash read traces.bin 0x08017800 0x8000
+    python tools/trace_decode.py traces.bin -o traces/
+    python tools/trace_decode.py traces.bin --list
+
+Each session becomes session_<seq>.csv with the header
+    ax,ay,az,gx,gy,gz,exercise,rep_end
+accel in g and gyro in deg/s of the raw sensor (the gyro bias is not removed)
+and rep_end = 0, ready to be labeled for tools/train_rep_classifier.py.
+The block layout mirrors include/trace_codec.h.
+"""
+import argparse
+import os
+import struct
+import sys
+
+TRACE_STORE_MAGIC = 0x54524353
+TRACE_STORE_VERSION = 1
+TRACE_STORE_VOID = 0x00000000
+PAGE_SIZE = 1024
+SESSION = struct.Struct("<IBBHBBHIII")
+ERASED_WORD = 0xFFFFFFFF
+RECORD_BYTES_MASK = 0x03FF
+RECORD_SAMPLES_SHIFT = 10
+
+CHANNELS = 6
+RICE_ESCAPE = 20
+ESCAPE_BITS = 18
+MODE_DELTA, MODE_LINEAR, MODE_VERBATIM = 0, 1, 2
+
+ACCEL_LSB_PER_G = 16384.0     # +/-2 g (mpu6050.c)
+GYRO_LSB_PER_DPS = 131.0      # +/-250 deg/s
+
+
+class BitReader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0  # bit position
+
+    def bit(self):
+        byte = self.data[self.pos >> 3]
+        b = (byte >> (7 - (self.pos & 7))) & 1
+        self.pos += 1
+        return b
+
+    def bits(self, count):
+        v = 0
+        for _ in range(count):
+            v = (v << 1) | self.bit()
+        return v
+
+
+def unzigzag(u):
+    return (u >> 1) if (u & 1) == 0 else -((u + 1) >> 1)
+
+
+def to_int16(v):
+    v &= 0xFFFF
+    return v - 0x10000 if v & 0x8000 else v
+
+
+def decode_block(data, n, prev):
+    """Decodes n samples of one block; prev holds [x[n-1], x[n-2]] per channel
+    and is advanced. Returns n rows of CHANNELS ints."""
+    r = BitReader(data)
+    cols = []
+    for ch in range(CHANNELS):
+        mode = r.bits(2)
+        a, b = prev[ch]
+        out = []
+        if mode == MODE_VERBATIM:
+            out = [to_int16(r.bits(16)) for _ in range(n)]
+        elif mode in (MODE_DELTA, MODE_LINEAR):
+            k = r.bits(4)
+            for _ in range(n):
+                q = 0
+                while q < RICE_ESCAPE and r.bit():
+                    q += 1
+                if q == RICE_ESCAPE:
+                    u = r.bits(ESCAPE_BITS)
+                else:
+                    u = (q << k) | r.bits(k)
+                pred = a if mode == MODE_DELTA else 2 * a - b
+                x = to_int16(pred + unzigzag(u))
+                out.append(x)
+                b, a = a, x
+        else:
+            raise ValueError("channel %d: unknown mode %d" % (ch, mode))
+        if n > 1:
+            prev[ch] = [out[-1], out[-2]]
+        else:
+            prev[ch] = [out[-1], prev[ch][0]]
+        cols.append(out)
+    return [list(row) for row in zip(*cols)]
+
+
+def parse_sessions(image):
+    """Walks the log like trace_store_init(). Yields (offset, header dict)."""
+    off = 0
+    while off + SESSION.size <= len(image):
+        magic, version, exercise, sample_hz, accel_shift, gyro_shift, flags, seq, data_bytes, samples = \
+            SESSION.unpack_from(image, off)
+        if magic == TRACE_STORE_VOID:
+            # Rest of the page left behind an interrupted write
+            off = (off // PAGE_SIZE + 1) * PAGE_SIZE
+            continue
+        if magic != TRACE_STORE_MAGIC or version != TRACE_STORE_VERSION:
+            break
+        hdr = dict(exercise=exercise, sample_hz=sample_hz, accel_shift=accel_shift, gyro_shift=gyro_shift,
+                   flags=flags, seq=seq, data_bytes=data_bytes, sample_count=samples)
+        if data_bytes == ERASED_WORD:
+            # Still open (image taken while recording): walk the records
+            hdr["data_bytes"], hdr["sample_count"] = walk_records(image, off + SESSION.size)
+        if hdr["data_bytes"] > len(image) - off - SESSION.size:
+            break
+        yield off, hdr
+        off += SESSION.size + ((hdr["data_bytes"] + 3) & ~3)
+
+
+def walk_records(image, off):
+    total = samples = 0
+    while off + 2 <= len(image):
+        (header,) = struct.unpack_from("<H", image, off)
+        size = 2 + (((header & RECORD_BYTES_MASK) + 1) & ~1)
+        if header == 0xFFFF or off + size > len(image):
+            break
+        total += size
+        samples += (header >> RECORD_SAMPLES_SHIFT) + 1
+        off += size
+    return total, samples
+
+
+def decode_session(image, off, hdr):
+    """Returns the raw samples (LSB, drop bits restored) of one session."""
+    prev = [[0, 0] for _ in range(CHANNELS)]
+    rows = []
+    pos = off + SESSION.size
+    end = pos + hdr["data_bytes"]
+    while pos + 2 <= end:
+        (header,) = struct.unpack_from("<H", image, pos)
+        if header == 0xFFFF:
+            break
+        length = header & RECORD_BYTES_MASK
+        n = (header >> RECORD_SAMPLES_SHIFT) + 1
+        rows.extend(decode_block(image[pos + 2:pos + 2 + length], n, prev))
+        pos += 2 + ((length + 1) & ~1)
+    shifts = [hdr["accel_shift"]] * 3 + [hdr["gyro_shift"]] * 3
+    return [[v << s for v, s in zip(row, shifts)] for row in rows]
+
+
+def write_csv(path, rows, exercise):
+    with open(path, "w") as f:
+        f.write("ax,ay,az,gx,gy,gz,exercise,rep_end\n")
+        for r in rows:
+            f.write("%.6f,%.6f,%.6f,%.4f,%.4f,%.4f,%d,0\n" % (
+                r[0] / ACCEL_LSB_PER_G, r[1] / ACCEL_LSB_PER_G, r[2] / ACCEL_LSB_PER_G,
+                r[3] / GYRO_LSB_PER_DPS, r[4] / GYRO_LSB_PER_DPS, r[5] / GYRO_LSB_PER_DPS, exercise))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("image", help="trace log image (FLASH_STORE_TRACE_ADDR..END)")
+    ap.add_argument("-o", "--out", default=".", help="output directory")
+    ap.add_argument("--list", action="store_true", help="only list the sessions")
+    args = ap.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+
+    sessions = list(parse_sessions(image))
+    if not sessions:
+        sys.exit("trace_decode: no sessions in %s" % args.image)
+
+    for off, hdr in sessions:
+        seconds = hdr["sample_count"] / float(hdr["sample_hz"] or 1)
+        raw_bytes = hdr["sample_count"] * CHANNELS * 2
+        ratio = raw_bytes / float(hdr["data_bytes"] or 1)
+        print("session %u: exercise %u, %u samples (%.1f s), %u bytes, %.2fx" % (
+            hdr["seq"], hdr["exercise"], hdr["sample_count"], seconds, hdr["data_bytes"], ratio))
+        if args.list:
+            continue
+        rows = decode_session(image, off, hdr)
+        if len(rows) != hdr["sample_count"]:
+            print("  warning: decoded %d samples" % len(rows))
+        os.makedirs(args.out, exist_ok=True)
+        write_csv(os.path.join(args.out, "session_%u.csv" % hdr["seq"]), rows, hdr["exercise"])
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,450 @@
+"""Download the raw IMU trace sessions (src/app/trace_store.c) over USART2.
+
+Uses the session commands of include/host_proto.h: the device streams a
+session in CRC-16 framed chunks of 88 bytes, at most --window chunks ahead of
+the last acknowledged offset, so the link stays busy without flooding the
+receiver. A lost or corrupted chunk is requested again from its offset; an
+interrupted download is kept as session_<seq>.part and resumed from its
+length by the next pull.
+
+    python tools/trace_sync.py -p /dev/ttyUSB0 list
+    python tools/trace_sync.py -p /dev/ttyUSB0 pull -o traces/ [--csv]
+    python tools/trace_sync.py -p /dev/ttyUSB0 pull 12 13 --all --no-mark
+    python tools/trace_sync.py -p /dev/ttyUSB0 mark 12
+    python tools/trace_sync.py selftest
+
+'pull' fetches every session not marked as synced (--all: also the synced
+ones, or only the listed ones), saves it as session_<seq>.trc (a one-session
+trace log image, which tools/trace_decode.py reads) and marks it synced.
+--csv also writes session_<seq>.csv. 'selftest' runs the client against a
+device emulator on a pseudo-terminal, with dropped and corrupted frames, an
+interrupted download and a link paced at 115200 baud.
+
+Linux only (termios); no dependencies.
+"""
+import argparse
+import os
+import random
+import select
+import struct
+import sys
+import tempfile
+import termios
+import threading
+import time
+import tty
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from tune_params import REPLY, STATUS, FrameParser, encode_frame  # noqa: E402
+import trace_decode  # noqa: E402
+
+CMD_SESSIONS = 0x08
+CMD_SESSION_READ = 0x09
+CMD_SESSION_DATA = 0x0A
+CMD_SESSION_ACK = 0x0B
+CMD_SESSION_SYNCED = 0x0C
+
+CHUNK = 88                    # HOST_PROTO_CHUNK
+SESSIONS_PER_REPLY = 6
+SESSION_ENTRY = struct.Struct("<IIIBB")
+LINK_BYTES_PER_S = 115200 / 10.0
+WINDOW = 24                   # Chunks in flight (~190 ms of link time)
+ACK_EVERY = 4                 # Chunks between acknowledgements
+STALL_S = 0.5                 # No progress for this long: request again
+RETRIES = 8
+
+
+class ProtocolError(Exception):
+    pass
+
+
+class SerialPort:
+    """Raw termios serial port (also a pty slave)."""
+
+    BAUDS = {9600: termios.B9600, 57600: termios.B57600, 115200: termios.B115200,
+             230400: termios.B230400, 460800: termios.B460800, 921600: termios.B921600}
+
+    def __init__(self, path, baud=115200):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        attrs = termios.tcgetattr(self.fd)
+        attrs[4] = attrs[5] = self.BAUDS[baud]
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+
+    def write(self, data):
+        while data:
+            data = data[os.write(self.fd, data):]
+
+    def read(self, timeout):
+        ready, _, _ = select.select([self.fd], [], [], timeout)
+        return os.read(self.fd, 4096) if ready else b""
+
+    def close(self):
+        os.close(self.fd)
+
+
+class Client:
+    def __init__(self, port):
+        self.port = port
+        self.parser = FrameParser()
+        self.log_full = False     # From the last session list
+
+    def send(self, cmd, payload=b""):
+        self.port.write(encode_frame(cmd, payload))
+
+    def request(self, cmd, payload=b"", timeout=1.0):
+        """Sends a command and returns the data of its reply; chunks of an
+        earlier stream still in flight are dropped."""
+        for _ in range(RETRIES):
+            self.send(cmd, payload)
+            deadline = time.monotonic() + timeout
+            while time.monotonic() < deadline:
+                for rcmd, rpayload in self.parser.feed(self.port.read(0.05)):
+                    if rcmd == (cmd | REPLY) and rpayload:
+                        check(rpayload[0], "command 0x%02x" % cmd)
+                        return bytes(rpayload[1:])
+        raise ProtocolError("no reply to command 0x%02x" % cmd)
+
+    def sessions(self):
+        """Returns the stored sessions as dicts, oldest first, and notes in
+        log_full whether the device refuses new sessions until they are synced."""
+        out = []
+        total = None
+        while total is None or len(out) < total:
+            data = self.request(CMD_SESSIONS, struct.pack("<H", len(out)))
+            total, full = struct.unpack_from("<HB", data)
+            self.log_full = bool(full)
+            entries = (len(data) - 3) // SESSION_ENTRY.size
+            if entries == 0 and len(out) < total:
+                raise ProtocolError("session list changed while reading")
+            for i in range(entries):
+                seq, size, samples, exercise, synced = SESSION_ENTRY.unpack_from(data, 3 + i * SESSION_ENTRY.size)
+                out.append(dict(seq=seq, size=size, sample_count=samples, exercise=exercise, synced=bool(synced)))
+        return out
+
+    def mark_synced(self, seq):
+        self.request(CMD_SESSION_SYNCED, struct.pack("<I", seq))
+
+    def download(self, seq, f, offset=0, window=WINDOW, stop_after=None):
+        """Streams session seq from offset into the open file f (appended).
+        stop_after bytes simulate a broken link (selftest). Returns the
+        session size."""
+        size = None
+        expected = offset
+        acked = offset
+        resync = False       # Waiting for the chunk at expected after a gap
+        stalls = 0
+        last_progress = time.monotonic()
+        self.send(CMD_SESSION_READ, struct.pack("<IIB", seq, offset, window))
+
+        while size is None or expected < size:
+            for cmd, payload in self.parser.feed(self.port.read(0.02)):
+                if not payload:
+                    continue
+                if cmd == (CMD_SESSION_READ | REPLY):
+                    check(payload[0], "session %d" % seq)
+                    rseq, rsize = struct.unpack_from("<II", payload, 1)
+                    if rseq == seq:
+                        size = rsize    # Others are late replies that stopped an earlier stream
+                elif cmd == (CMD_SESSION_DATA | REPLY):
+                    check(payload[0], "session %d" % seq)
+                    (chunk_offset,) = struct.unpack_from("<I", payload, 1)
+                    if chunk_offset != expected:
+                        # Lost or corrupted chunk: go back once, then skip the rest in flight
+                        if chunk_offset > expected and not resync:
+                            self.send(CMD_SESSION_READ, struct.pack("<IIB", seq, expected, window))
+                            resync = True
+                        continue
+                    f.write(payload[5:])
+                    expected += len(payload) - 5
+                    resync = False
+                    stalls = 0
+                    last_progress = time.monotonic()
+                    if stop_after is not None and expected - offset >= stop_after:
+                        self.send(CMD_SESSION_READ, struct.pack("<IIB", seq, expected, 0))
+                        return size
+
+            if expected - acked >= ACK_EVERY * CHUNK:
+                self.send(CMD_SESSION_ACK, struct.pack("<I", expected))
+                acked = expected
+            if time.monotonic() - last_progress > STALL_S:
+                stalls += 1
+                if stalls > RETRIES:
+                    raise ProtocolError("session %d stalled at %d" % (seq, expected))
+                self.send(CMD_SESSION_READ, struct.pack("<IIB", seq, expected, window))
+                acked = expected
+                resync = False
+                last_progress = time.monotonic()
+
+        self.send(CMD_SESSION_READ, struct.pack("<IIB", seq, expected, 0))
+        return size
+
+
+def check(status, what):
+    if status != 0:
+        text = STATUS[status] if status < len(STATUS) else "status %d" % status
+        raise ProtocolError("%s: %s" % (what, text))
+
+
+def describe(s):
+    if s["size"] == 0:
+        return "session %d: exercise %d, recording" % (s["seq"], s["exercise"])
+    return "session %d: exercise %d, %d samples, %d bytes%s" % (
+        s["seq"], s["exercise"], s["sample_count"], s["size"], ", synced" if s["synced"] else "")
+
+
+def pull(client, out_dir, seqs=None, include_synced=False, mark=True, csv=False, stop_after=None):
+    """Downloads sessions into out_dir; returns the paths written."""
+    os.makedirs(out_dir, exist_ok=True)
+    written = []
+    for s in client.sessions():
+        if s["size"] == 0:
+            continue    # Still being recorded
+        if seqs is not None:
+            if s["seq"] not in seqs:
+                continue
+        elif s["synced"] and not include_synced:
+            continue
+
+        path = os.path.join(out_dir, "session_%d.trc" % s["seq"])
+        part = path[:-4] + ".part"
+        offset = os.path.getsize(part) if os.path.exists(part) else 0
+        if offset > s["size"]:
+            offset = 0
+        t0 = time.monotonic()
+        with open(part, "ab" if offset else "wb") as f:
+            client.download(s["seq"], f, offset, stop_after=stop_after)
+        got = os.path.getsize(part)
+        if got < s["size"]:
+            print("session %d: interrupted at %d of %d bytes" % (s["seq"], got, s["size"]))
+            continue
+        rate = (got - offset) / max(time.monotonic() - t0, 1e-6)
+        print("session %d: %d bytes%s, %.0f B/s (%.0f%% of the link)" % (
+            s["seq"], got, " (resumed at %d)" % offset if offset else "", rate, 100.0 * rate / LINK_BYTES_PER_S))
+        os.replace(part, path)
+        written.append(path)
+
+        if csv:
+            with open(path, "rb") as f:
+                image = f.read()
+            for off, hdr in trace_decode.parse_sessions(image):
+                rows = trace_decode.decode_session(image, off, hdr)
+                trace_decode.write_csv(path[:-4] + ".csv", rows, hdr["exercise"])
+        if mark:
+            client.mark_synced(s["seq"])
+    return written
+
+
+# --- Selftest: device emulator on a pseudo-terminal ---------------------------
+
+def verbatim_block(rows):
+    """Codes rows in trace_codec's verbatim mode (2-bit mode, 16-bit samples)."""
+    bits = []
+    for ch in range(trace_decode.CHANNELS):
+        bits += [1, 0]
+        for r in rows:
+            v = r[ch] & 0xFFFF
+            bits += [(v >> (15 - i)) & 1 for i in range(16)]
+    bits += [0] * (-len(bits) % 8)
+    return bytes(int("".join(map(str, bits[i:i + 8])), 2) for i in range(0, len(bits), 8))
+
+
+def make_session(seq, exercise, rows):
+    """Builds a closed session as trace_store.c lays it out."""
+    data = bytearray()
+    for i in range(0, len(rows), 32):
+        block = verbatim_block(rows[i:i + 32])
+        header = len(block) | ((len(rows[i:i + 32]) - 1) << trace_decode.RECORD_SAMPLES_SHIFT)
+        data += struct.pack("<H", header) + block + (b"\xff" if len(block) & 1 else b"")
+    head = trace_decode.SESSION.pack(trace_decode.TRACE_STORE_MAGIC, trace_decode.TRACE_STORE_VERSION, exercise,
+                                     200, 0, 0, 0xFFFF, seq, len(data), len(rows))
+    return bytearray(head + data)
+
+
+class FakeDevice(threading.Thread):
+    """Serves the session commands like src/app/host_proto.c, on a pty master,
+    paced at the link rate and with faults injected into the chunks."""
+
+    def __init__(self, fd, sessions, seed=1, drop=0.02, corrupt=0.02, drop_ack=0.1):
+        super().__init__(daemon=True)
+        self.fd = fd
+        self.sessions = sessions      # seq -> bytearray (header + records)
+        self.rng = random.Random(seed)
+        self.drop, self.corrupt, self.drop_ack = drop, corrupt, drop_ack
+        self.parser = FrameParser()
+        self.stream = None            # [seq, next, limit, window]
+        self.reads = []               # (seq, offset) of every SESSION_READ
+        self.running = True
+        self.sent = 0
+
+    def reply(self, cmd, status, data=b""):
+        frame = encode_frame(cmd | REPLY, bytes([status]) + data)
+        time.sleep(len(frame) / LINK_BYTES_PER_S)
+        os.write(self.fd, frame)
+        self.sent += len(frame)
+
+    def handle(self, cmd, p):
+        order = sorted(self.sessions)
+        if cmd == CMD_SESSIONS:
+            (first,) = struct.unpack_from("<H", p)
+            # The emulated log has no room left: full until every session is synced
+            synced = all(trace_decode.SESSION.unpack_from(s)[6] == 0 for s in self.sessions.values())
+            data = struct.pack("<HB", len(order), 0 if synced else 1)
+            for seq in order[first:first + SESSIONS_PER_REPLY]:
+                s = self.sessions[seq]
+                hdr = trace_decode.SESSION.unpack_from(s)
+                data += SESSION_ENTRY.pack(seq, len(s), hdr[9], hdr[2], 1 if hdr[6] == 0 else 0)
+            self.reply(cmd, 0, data)
+        elif cmd == CMD_SESSION_READ:
+            seq, offset, window = struct.unpack("<IIB", p)
+            self.reads.append((seq, offset))
+            self.stream = None
+            if seq not in self.sessions:
+                return self.reply(cmd, 3)
+            if offset > len(self.sessions[seq]):
+                return self.reply(cmd, 4)
+            self.reply(cmd, 0, struct.pack("<II", seq, len(self.sessions[seq])))
+            if window:
+                self.stream = [seq, offset, offset + window * CHUNK, window * CHUNK]
+        elif cmd == CMD_SESSION_ACK:
+            (offset,) = struct.unpack("<I", p)
+            if self.stream and self.rng.random() >= self.drop_ack:
+                self.stream[2] = max(self.stream[2], offset + self.stream[3])
+        elif cmd == CMD_SESSION_SYNCED:
+            (seq,) = struct.unpack("<I", p)
+            if seq not in self.sessions:
+                return self.reply(cmd, 3)
+            struct.pack_into("<H", self.sessions[seq], 10, 0)
+            self.reply(cmd, 0)
+        else:
+            self.reply(cmd, 1)
+
+    def streaming(self):
+        return self.stream is not None and self.stream[1] < min(self.stream[2], len(self.sessions[self.stream[0]]))
+
+    def run(self):
+        while self.running:
+            ready, _, _ = select.select([self.fd], [], [], 0 if self.streaming() else 0.02)
+            if ready:
+                try:
+                    data = os.read(self.fd, 4096)
+                except OSError:
+                    return
+                for cmd, payload in self.parser.feed(data):
+                    self.handle(cmd, payload)
+            if not self.streaming():
+                continue
+            seq, offset = self.stream[0], self.stream[1]
+            chunk = bytes(self.sessions[seq][offset:offset + CHUNK])
+            frame = bytearray(encode_frame(CMD_SESSION_DATA | REPLY, b"\x00" + struct.pack("<I", offset) + chunk))
+            self.stream[1] += len(chunk)
+            time.sleep(len(frame) / LINK_BYTES_PER_S)
+            self.sent += len(frame)
+            roll = self.rng.random()
+            if roll < self.drop:
+                continue
+            if roll < self.drop + self.corrupt:
+                frame[self.rng.randrange(3, len(frame))] ^= 0x5A
+            os.write(self.fd, bytes(frame))
+
+
+def selftest():
+    rng = random.Random(7)
+    sessions = {}
+    expected_rows = {}
+    for seq, n in ((3, 150), (4, 700), (5, 400)):
+        rows = [[rng.randint(-32768, 32767) for _ in range(6)] for _ in range(n)]
+        sessions[seq] = make_session(seq, seq % 3, rows)
+        expected_rows[seq] = rows
+    originals = {seq: bytes(s) for seq, s in sessions.items()}
+
+    master, slave = os.openpty()
+    device = FakeDevice(master, sessions)
+    device.start()
+    port = SerialPort(os.ttyname(slave))
+    client = Client(port)
+    ok = True
+    try:
+        with tempfile.TemporaryDirectory() as out:
+            listed = client.sessions()
+            print("listed: %s" % ", ".join(str(s["seq"]) for s in listed))
+            ok &= [s["seq"] for s in listed] == [3, 4, 5] and client.log_full
+
+            # Broken link half way through session 4, then resumed
+            pull(client, out, seqs={4}, mark=False, stop_after=len(originals[4]) // 2)
+            part = os.path.getsize(os.path.join(out, "session_4.part"))
+            t0, sent0 = time.monotonic(), device.sent
+            written = pull(client, out, csv=True)
+            elapsed = time.monotonic() - t0
+            ok &= any(seq == 4 and offset == part for seq, offset in device.reads)
+
+            for path in written:
+                seq = int(os.path.basename(path)[8:-4])
+                with open(path, "rb") as f:
+                    image = f.read()
+                same = image == originals[seq]
+                (off, hdr), = trace_decode.parse_sessions(image)
+                decoded = trace_decode.decode_session(image, off, hdr) == expected_rows[seq]
+                print("session %d: bytes %s, decoded samples %s, csv %s" % (
+                    seq, "match" if same else "DIFFER", "match" if decoded else "DIFFER",
+                    "written" if os.path.exists(path[:-4] + ".csv") else "MISSING"))
+                ok &= same and decoded and os.path.exists(path[:-4] + ".csv")
+            ok &= len(written) == 3
+            ok &= all(s["synced"] for s in client.sessions()) and not client.log_full
+            ok &= pull(client, out) == []
+
+            goodput = sum(len(s) for s in originals.values()) - part
+            print("link %.0f B/s, goodput %.0f B/s, %.0f%% of the bytes sent were new session data" % (
+                (device.sent - sent0) / elapsed, goodput / elapsed, 100.0 * goodput / (device.sent - sent0)))
+    finally:
+        device.running = False
+        port.close()
+        device.join(1.0)
+        os.close(master)
+    print("selftest %s" % ("passed" if ok else "FAILED"))
+    return 0 if ok else 1
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("-p", "--port", help="serial port of the USART2 adapter")
+    ap.add_argument("-b", "--baud", type=int, default=115200)
+    sub = ap.add_subparsers(dest="command", required=True)
+    sub.add_parser("list", help="list the stored sessions")
+    p = sub.add_parser("pull", help="download sessions")
+    p.add_argument("seqs", nargs="*", type=int, help="only these sessions")
+    p.add_argument("-o", "--out", default=".", help="output directory")
+    p.add_argument("--all", action="store_true", help="also sessions already synced")
+    p.add_argument("--no-mark", action="store_true", help="do not mark downloaded sessions as synced")
+    p.add_argument("--csv", action="store_true", help="also decode each session to CSV")
+    p = sub.add_parser("mark", help="mark sessions as synced")
+    p.add_argument("seqs", nargs="+", type=int)
+    sub.add_parser("selftest", help="run against an emulated device on a pseudo-terminal")
+    args = ap.parse_args()
+
+    if args.command == "selftest":
+        return selftest()
+    if not args.port:
+        ap.error("-p/--port is required")
+
+    client = Client(SerialPort(args.port, args.baud))
+    try:
+        if args.command == "list":
+            for s in client.sessions():
+                print(describe(s))
+            if client.log_full:
+                print("log full: no new session is recorded until these are pulled and marked")
+        elif args.command == "pull":
+            pull(client, args.out, set(args.seqs) if args.seqs else None, args.all or bool(args.seqs),
+                 not args.no_mark, args.csv)
+        elif args.command == "mark":
+            for seq in args.seqs:
+                client.mark_synced(seq)
+    except ProtocolError as e:
+        raise SystemExit("trace_sync: %s" % e)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
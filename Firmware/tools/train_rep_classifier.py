@@ -0,0 +1,259 @@
+"""Train the optional int8 rep classifier and emit include/rep_classifier_weights.h.
+
+Input traces are CSV files logged at IMU_SAMPLE_HZ with the header
+    ax,ay,az,gx,gy,gz,exercise,rep_end
+accel in g and gyro in deg/s as produced by mpu6050_convert_to_scaled(),
+exercise as the exercise_t index and rep_end = 1 on the sample where a rep
+finished (0 elsewhere).
+
+The model is a 3-layer MLP over a window of block-averaged six-axis frames.
+It has two heads in one output layer: rep / no-rep (a rep ended in the last
+LABEL_MS of the window) and exercise type. After float training it is
+quantized to int8 with symmetric per-layer scales, and the int8 inference of
+src/sensing/nn_kernels.c is replayed in numpy to report the accuracy that
+will actually run on the device.
+
+    python tools/train_rep_classifier.py traces/*.csv
+    python tools/train_rep_classifier.py --placeholder   # untrained header
+
+Training needs numpy; --placeholder does not.
+"""
+import argparse
+import csv
+import os
+import re
+import sys
+
+CLASSIFIER_HZ = 20
+STEPS = 48          # 2.4 s window
+AXES = 6
+H1 = 32
+H2 = 16
+LABEL_MS = 500
+ACCEL_Q = 32.0      # int8 LSB per g (+/-4 g)
+GYRO_Q = 0.5        # int8 LSB per deg/s (+/-254 deg/s)
+IN_SCALE = 1.0 / 128.0
+
+
+def project_dir():
+    return os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def read_define(root, header, name):
+    with open(os.path.join(root, "include", header)) as f:
+        m = re.search(r"#define\s+%s\s+(\d+)" % name, f.read())
+    if not m:
+        raise SystemExit("train_rep_classifier: %s not found in %s" % (name, header))
+    return int(m.group(1))
+
+
+def read_ex_count(root):
+    """Counts the exercises.def entries not disabled in app_config.h."""
+    with open(os.path.join(root, "include", "exercises.def")) as f:
+        ids = re.findall(r"^\s*EXERCISE\(\s*(\w+)\s*,", f.read(), re.M)
+    with open(os.path.join(root, "include", "app_config.h")) as f:
+        disabled = set(re.findall(r"^\s*#define\s+EX_ENABLE_(\w+)\s+0\b", f.read(), re.M))
+    return len([i for i in ids if i not in disabled])
+
+
+def load_windows(np, paths, sample_hz):
+    decim = sample_hz // CLASSIFIER_HZ
+    label_frames = max(1, LABEL_MS * CLASSIFIER_HZ // 1000)
+    xs, reps, exs = [], [], []
+    for path in paths:
+        with open(path) as f:
+            rows = list(csv.DictReader(f))
+        data = np.array([[float(r[k]) for k in ("ax", "ay", "az", "gx", "gy", "gz")] for r in rows])
+        ex = np.array([int(r["exercise"]) for r in rows])
+        rep_end = np.array([int(r["rep_end"]) for r in rows])
+
+        # Every decimation phase is a valid device alignment
+        for phase in range(decim):
+            n = (len(data) - phase) // decim
+            if n < STEPS:
+                continue
+            blocks = data[phase:phase + n * decim].reshape(n, decim, AXES).mean(axis=1)
+            q = np.empty_like(blocks)
+            q[:, :3] = np.rint(blocks[:, :3] * ACCEL_Q)
+            q[:, 3:] = np.rint(blocks[:, 3:] * GYRO_Q)
+            q = np.clip(q, -128, 127)
+            ends = rep_end[phase:phase + n * decim].reshape(n, decim).max(axis=1)
+            frame_ex = ex[phase:phase + n * decim].reshape(n, decim)[:, -1]
+            for t in range(STEPS, n + 1):
+                xs.append(q[t - STEPS:t].reshape(-1))
+                reps.append(int(ends[t - label_frames:t].max()))
+                exs.append(int(frame_ex[t - 1]))
+    if not xs:
+        raise SystemExit("train_rep_classifier: traces too short for a %d-step window" % STEPS)
+    return np.array(xs), np.array(reps), np.array(exs)
+
+
+def train(np, x, rep, ex, ex_count, epochs, seed):
+    rng = np.random.default_rng(seed)
+    sizes = [STEPS * AXES, H1, H2, 2 + ex_count]
+    params = []
+    for a, b in zip(sizes[:-1], sizes[1:]):
+        params.append([rng.normal(0.0, np.sqrt(2.0 / a), (b, a)), np.zeros(b)])
+    m = [[np.zeros_like(p) for p in layer] for layer in params]
+    v = [[np.zeros_like(p) for p in layer] for layer in params]
+    xf = x * IN_SCALE
+    step = 0
+
+    def softmax_grad(z, y):
+        z = z - z.max(axis=1, keepdims=True)
+        p = np.exp(z)
+        p /= p.sum(axis=1, keepdims=True)
+        p[np.arange(len(y)), y] -= 1.0
+        return p / len(y)
+
+    for _ in range(epochs):
+        order = rng.permutation(len(xf))
+        for i in range(0, len(order), 64):
+            idx = order[i:i + 64]
+            acts = [xf[idx]]
+            for k, (w, b) in enumerate(params):
+                z = acts[-1] @ w.T + b
+                acts.append(np.maximum(z, 0.0) if k < len(params) - 1 else z)
+            out = acts[-1]
+            grad = np.zeros_like(out)
+            grad[:, :2] = softmax_grad(out[:, :2], rep[idx])
+            grad[:, 2:] = softmax_grad(out[:, 2:], ex[idx])
+            step += 1
+            for k in reversed(range(len(params))):
+                w, b = params[k]
+                gw = grad.T @ acts[k]
+                gb = grad.sum(axis=0)
+                if k > 0:
+                    grad = (grad @ w) * (acts[k] > 0)
+                for j, g in enumerate((gw, gb)):
+                    m[k][j] = 0.9 * m[k][j] + 0.1 * g
+                    v[k][j] = 0.999 * v[k][j] + 0.001 * g * g
+                    mh = m[k][j] / (1 - 0.9 ** step)
+                    vh = v[k][j] / (1 - 0.999 ** step)
+                    params[k][j] -= 1e-3 * mh / (np.sqrt(vh) + 1e-8)
+    return params
+
+
+def quantize(np, params, x):
+    layers = []
+    s_in = IN_SCALE
+    a = x * IN_SCALE
+    for k, (w, b) in enumerate(params):
+        last = k == len(params) - 1
+        z = a @ w.T + b
+        a = z if last else np.maximum(z, 0.0)
+        s_w = max(np.abs(w).max(), 1e-8) / 127.0
+        s_out = max(np.abs(a).max(), 1e-8) / 127.0
+        scale = s_in * s_w / s_out
+        shift = min(62, max(1, 29 - int(np.floor(np.log2(scale)))))
+        layers.append({
+            "w": np.clip(np.rint(w / s_w), -127, 127).astype(int),  # [out][in]
+            "b": np.rint(b / (s_in * s_w)).astype(int),
+            "mult": int(round(scale * (1 << shift))),
+            "shift": shift,
+            "relu": not last,
+        })
+        s_in = s_out
+    return layers
+
+
+def infer_int8(np, layers, xq):
+    a = xq.astype(np.int64)
+    for L in layers:
+        acc = a @ L["w"].T.astype(np.int64) + L["b"]
+        y = (acc * L["mult"] + (1 << (L["shift"] - 1))) >> L["shift"]
+        if L["relu"]:
+            y = np.maximum(y, 0)
+        a = np.clip(y, -128, 127)
+    return a
+
+
+def c_array(ctype, name, values, placeholder):
+    if placeholder:
+        return ["static const %s %s[%d] = {0};" % (ctype, name, len(values))]
+    out = ["static const %s %s[%d] = {" % (ctype, name, len(values))]
+    for i in range(0, len(values), 16):
+        out.append("    " + ", ".join(str(int(v)) for v in values[i:i + 16]) + ",")
+    out.append("};")
+    return out
+
+
+def render(layers, ex_count, trained):
+    out = []
+    out.append("// Generated by tools/train_rep_classifier.py. Do not edit.")
+    out.append("#ifndef REP_CLASSIFIER_WEIGHTS_H")
+    out.append("#define REP_CLASSIFIER_WEIGHTS_H")
+    out.append("")
+    out.append("#include <stdint.h>")
+    out.append("")
+    out.append("#define REP_CLASSIFIER_TRAINED %d" % (1 if trained else 0))
+    out.append("#define REP_CLASSIFIER_HZ %d" % CLASSIFIER_HZ)
+    out.append("#define REP_CLASSIFIER_STEPS %d" % STEPS)
+    out.append("#define REP_CLASSIFIER_IN %d" % (STEPS * AXES))
+    out.append("#define REP_CLASSIFIER_H1 %d" % H1)
+    out.append("#define REP_CLASSIFIER_H2 %d" % H2)
+    out.append("#define REP_CLASSIFIER_OUT %d  // rep head (2) + exercise head" % (2 + ex_count))
+    out.append("#define REP_CLASSIFIER_EX_COUNT %d" % ex_count)
+    out.append("#define REP_CLASSIFIER_ACCEL_Q %.1ff  // int8 LSB per g" % ACCEL_Q)
+    out.append("#define REP_CLASSIFIER_GYRO_Q %.1ff   // int8 LSB per deg/s" % GYRO_Q)
+    for k, L in enumerate(layers, start=1):
+        out.append("")
+        out.append("#define REP_CLASSIFIER_L%d_MULT %d" % (k, L["mult"]))
+        out.append("#define REP_CLASSIFIER_L%d_SHIFT %d" % (k, L["shift"]))
+        out += c_array("int8_t", "REP_CLASSIFIER_W%d" % k, list(L["w"].reshape(-1)) if trained else L["w"], not trained)
+        out += c_array("int32_t", "REP_CLASSIFIER_B%d" % k, L["b"], not trained)
+    out.append("")
+    out.append("#endif // REP_CLASSIFIER_WEIGHTS_H")
+    return "\n".join(out) + "\n"
+
+
+def placeholder_layers(ex_count):
+    sizes = [STEPS * AXES, H1, H2, 2 + ex_count]
+    layers = []
+    for k, (a, b) in enumerate(zip(sizes[:-1], sizes[1:])):
+        layers.append({"w": [0] * (a * b), "b": [0] * b, "mult": 1 << 30, "shift": 30,
+                       "relu": k < len(sizes) - 2})
+    return layers
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("traces", nargs="*", help="labeled CSV traces")
+    ap.add_argument("--placeholder", action="store_true", help="emit an untrained header")
+    ap.add_argument("--epochs", type=int, default=30)
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--out", default=None, help="output header path")
+    args = ap.parse_args()
+
+    root = project_dir()
+    ex_count = read_ex_count(root)
+    out_path = args.out or os.path.join(root, "include", "rep_classifier_weights.h")
+
+    if args.placeholder:
+        text = render(placeholder_layers(ex_count), ex_count, trained=False)
+    else:
+        if not args.traces:
+            ap.error("no traces given (use --placeholder for an untrained header)")
+        import numpy as np
+        sample_hz = read_define(root, "app_config.h", "IMU_SAMPLE_HZ")
+        if sample_hz % CLASSIFIER_HZ:
+            raise SystemExit("train_rep_classifier: IMU_SAMPLE_HZ must be a multiple of %d" % CLASSIFIER_HZ)
+        x, rep, ex = load_windows(np, args.traces, sample_hz)
+        if ex.max() >= ex_count:
+            raise SystemExit("train_rep_classifier: exercise index out of range")
+        params = train(np, x, rep, ex, ex_count, args.epochs, args.seed)
+        layers = quantize(np, params, x)
+        logits = infer_int8(np, layers, x)
+        rep_acc = (logits[:, :2].argmax(axis=1) == rep).mean()
+        ex_acc = (logits[:, 2:].argmax(axis=1) == ex).mean()
+        print("train_rep_classifier: %d windows, int8 rep accuracy %.3f, exercise accuracy %.3f"
+              % (len(x), rep_acc, ex_acc), file=sys.stderr)
+        text = render(layers, ex_count, trained=True)
+
+    with open(out_path, "w") as f:
+        f.write(text)
+    print("train_rep_classifier: wrote %s" % out_path, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,399 @@
+"""Read and tune the live exercise parameters over the USART2 host protocol.
+
+The firmware keeps EX_CFG in RAM (src/sensing/exercise_config.c); this tool
+talks to it through the framed protocol of include/host_proto.h, so a
+threshold change takes effect on the next sample without a rebuild.
+
+    python tools/tune_params.py -p /dev/ttyUSB0 info
+    python tools/tune_params.py -p /dev/ttyUSB0 get "Bicep Curl"
+    python tools/tune_params.py -p /dev/ttyUSB0 set 0 thresh_k=2.4 min_prominence_g=0.45
+    python tools/tune_params.py -p /dev/ttyUSB0 push params.json --commit
+    python tools/tune_params.py -p /dev/ttyUSB0 defaults all
+    python tools/tune_params.py -p /dev/ttyUSB0 commit
+    python tools/tune_params.py -p /dev/ttyUSB0 latency [--reset]
+    python tools/tune_params.py -p /dev/ttyUSB0 blackbox [--trigger] [-o dump.bin]
+    python tools/tune_params.py -p /dev/ttyUSB0 clock
+
+A set is checked completely on the device before anything changes; a value
+outside a parameter's range rejects the whole set. 'commit' writes the live
+table to the config flash page, which is applied at every boot.
+
+push reads JSON keyed by exercise name or index:
+    {"Bicep Curl": {"thresh_k": 2.4, "refractory_ms": 700}}
+
+'latency' prints the rep-to-pixel latency distribution (ENABLE_LATENCY_TRACE):
+peak -> confirm -> UI enqueue -> display flush, and peak -> flush end to end.
+
+'blackbox' saves the stored black-box dump (ENABLE_BLACKBOX) for
+tools/blackbox_replay.py; --trigger freezes the recorder first and waits
+for the new dump.
+
+'clock' shows the clock profile (src/drivers/clock_ctrl.c): the CPU load
+and the I2C/flash wait share of the last window, and the time spent at
+8 MHz and 72 MHz since the current set started.
+
+Needs pyserial.
+"""
+import argparse
+import json
+import struct
+import sys
+import time
+
+SYNC = 0xA5
+REPLY = 0x80
+PROTO_VERSION = 1
+MAX_PAYLOAD = 96
+
+CMD_INFO = 0x01
+CMD_GET_EXERCISE = 0x02
+CMD_SET_PARAMS = 0x03
+CMD_COMMIT = 0x04
+CMD_DEFAULTS = 0x05
+CMD_LATENCY = 0x06
+CMD_BLACKBOX = 0x07
+BLACKBOX_CHUNK = 64
+
+STATUS = ["ok", "unknown command", "bad length", "unknown exercise or parameter",
+          "value out of range", "flash write failed"]
+
+# Order of exercise_param_t in include/exercise_config.h
+PARAMS = [
+    "thresh_k",
+    "min_prominence_g",
+    "refractory_ms",
+    "detect_warmup_ms",
+    "window_len",
+    "thresh_mode",
+    "projection",
+    "proj_weight_x",
+    "proj_weight_y",
+    "proj_weight_z",
+    "template_gate",
+]
+# Spans of latency_span_t in include/latency_trace.h
+LATENCY_SPANS = ["peak -> confirm", "confirm -> enqueue", "enqueue -> flush", "peak -> flush"]
+LATENCY_BINS = 24
+
+# Enum-valued parameters can be given by name
+ENUMS = {
+    "thresh_mode": ["sigma", "mad"],
+    "projection": ["accel_axes", "gravity_dir", "gyro_axes"],
+}
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as crc16_update() in src/app/host_proto.c."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def encode_frame(cmd, payload=b""):
+    if len(payload) > MAX_PAYLOAD:
+        raise ValueError("payload too long")
+    body = bytes([cmd, len(payload)]) + payload
+    return bytes([SYNC]) + body + struct.pack("<H", crc16(body))
+
+
+class FrameParser:
+    """Byte-wise frame parser; log text and corrupted frames are skipped."""
+
+    def __init__(self):
+        self.buf = bytearray()
+
+    def feed(self, data):
+        self.buf += data
+        frames = []
+        while True:
+            start = self.buf.find(bytes([SYNC]))
+            if start < 0:
+                self.buf.clear()
+                return frames
+            del self.buf[:start]
+            if len(self.buf) < 3:
+                return frames
+            length = self.buf[2]
+            if length > MAX_PAYLOAD:
+                del self.buf[:1]
+                continue
+            end = 3 + length + 2
+            if len(self.buf) < end:
+                return frames
+            body = bytes(self.buf[1:3 + length])
+            (crc,) = struct.unpack_from("<H", self.buf, 3 + length)
+            if crc == crc16(body):
+                frames.append((body[0], body[2:]))
+                del self.buf[:end]
+            else:
+                del self.buf[:1]
+
+
+class Link:
+    def __init__(self, port, baud=115200, timeout=1.0, retries=3):
+        import serial
+        self.ser = serial.Serial(port, baud, timeout=0.05)
+        self.timeout = timeout
+        self.retries = retries
+        self.parser = FrameParser()
+
+    def request(self, cmd, payload=b""):
+        """Sends a command and returns (status, data) of its reply."""
+        for _ in range(self.retries):
+            self.ser.write(encode_frame(cmd, payload))
+            deadline = time.monotonic() + self.timeout
+            while time.monotonic() < deadline:
+                for rcmd, rpayload in self.parser.feed(self.ser.read(256)):
+                    if rcmd == (cmd | REPLY) and rpayload:
+                        return rpayload[0], bytes(rpayload[1:])
+        raise TimeoutError("no reply to command 0x%02x" % cmd)
+
+
+def check(status, data, what):
+    if status != 0:
+        text = STATUS[status] if status < len(STATUS) else "status %d" % status
+        if data:
+            text += " (pair %d)" % data[0]
+        raise SystemExit("%s: %s" % (what, text))
+
+
+def info(link):
+    status, data = link.request(CMD_INFO)
+    check(status, data, "info")
+    version, ex_count, param_count = data[:3]
+    if version != PROTO_VERSION or param_count != len(PARAMS):
+        raise SystemExit("firmware protocol %d with %d parameters, tool expects %d with %d"
+                         % (version, param_count, PROTO_VERSION, len(PARAMS)))
+    return ex_count
+
+
+def print_clock(link):
+    status, data = link.request(CMD_INFO)
+    check(status, data, "info")
+    if len(data) < 14:
+        raise SystemExit("clock: firmware does not report its clock profile")
+    profile, load, wait = data[3:6]
+    low_ms, full_ms = struct.unpack_from("<II", data, 6)
+    total = float(low_ms + full_ms) or 1.0
+    print("profile %s, CPU load %d %%, I2C/flash wait %d %%" % (("8 MHz", "72 MHz")[profile & 1], load, wait))
+    print("since the set started (%.1f s): 8 MHz %.1f %%, 72 MHz %.1f %%" % (
+        total / 1000.0, 100.0 * low_ms / total, 100.0 * full_ms / total))
+
+
+def get_exercise(link, ex):
+    status, data = link.request(CMD_GET_EXERCISE, bytes([ex]))
+    check(status, data, "get")
+    values = struct.unpack_from("<%df" % len(PARAMS), data, 1)
+    name = data[1 + 4 * len(PARAMS):].decode("ascii", "replace")
+    return name, dict(zip(PARAMS, values))
+
+
+def exercise_names(link):
+    return [get_exercise(link, ex)[0] for ex in range(info(link))]
+
+
+def resolve_exercise(link, key):
+    if key.isdigit():
+        return int(key)
+    names = [n.lower() for n in exercise_names(link)]
+    if key.lower() not in names:
+        raise SystemExit("unknown exercise %r" % key)
+    return names.index(key.lower())
+
+
+def parse_value(name, text):
+    if name in ENUMS and not isinstance(text, (int, float)) and text in ENUMS[name]:
+        return float(ENUMS[name].index(text))
+    return float(text)
+
+
+def set_params(link, ex, params):
+    payload = bytes([ex])
+    for name, value in params.items():
+        if name not in PARAMS:
+            raise SystemExit("unknown parameter %r (one of: %s)" % (name, ", ".join(PARAMS)))
+        payload += struct.pack("<Bf", PARAMS.index(name), parse_value(name, value))
+    status, data = link.request(CMD_SET_PARAMS, payload)
+    check(status, data, "set")
+
+
+def latency_bin_floor_ms(b):
+    """Lower edge of a histogram bin, as bin_of() in src/app/latency_trace.c."""
+    if b == 0:
+        return 0
+    half = 0 if b & 1 else 1
+    j = (b + 1 - half) // 2
+    return (1 << j) + half * (1 << (j - 1))
+
+
+def latency_percentile(bins, q):
+    """Upper edge of the bin holding the q-quantile (ms); None past the last edge."""
+    total = sum(bins)
+    seen = 0
+    for b, n in enumerate(bins):
+        seen += n
+        if seen >= q * total:
+            return latency_bin_floor_ms(b + 1) if b + 1 < len(bins) else None
+    return None
+
+
+def print_latency(link):
+    for span, label in enumerate(LATENCY_SPANS):
+        status, data = link.request(CMD_LATENCY, bytes([span]))
+        check(status, data, "latency")
+        count, lo, hi, mean = struct.unpack_from("<4I", data, 1)
+        bins = struct.unpack_from("<%dH" % LATENCY_BINS, data, 17)
+        print("%-20s n=%d" % (label, count))
+        if count == 0:
+            continue
+        quantiles = []
+        for q in (0.5, 0.9, 0.99):
+            edge = latency_percentile(bins, q)
+            quantiles.append("p%d<%s" % (q * 100, "%d ms" % edge if edge is not None else "inf"))
+        print("    min %.1f ms  mean %.1f ms  max %.1f ms  %s"
+              % (lo / 1000.0, mean / 1000.0, hi / 1000.0, "  ".join(quantiles)))
+        peak = max(bins)
+        for b, n in enumerate(bins):
+            if n == 0:
+                continue
+            upper = "%d" % latency_bin_floor_ms(b + 1) if b + 1 < LATENCY_BINS else ""
+            bar = "#" * max(1, n * 40 // peak)
+            print("    %5d-%-5s ms %6d %s" % (latency_bin_floor_ms(b), upper, n, bar))
+
+
+def read_blackbox(link):
+    """Reads the stored black-box dump; empty if there is none."""
+    dump = bytearray()
+    size = None
+    while size is None or len(dump) < size:
+        status, data = link.request(CMD_BLACKBOX, struct.pack("<BH", 0, len(dump)))
+        check(status, data, "blackbox")
+        offset, total = struct.unpack_from("<HH", data)
+        if size is not None and total != size:
+            raise SystemExit("blackbox: dump replaced while reading")
+        size = total
+        if offset != len(dump) or (size and len(data) <= 4):
+            raise SystemExit("blackbox: short read at %d" % len(dump))
+        dump += data[4:]
+    return bytes(dump)
+
+
+def blackbox_header(link):
+    """First bytes of the stored dump (its header), empty if there is none."""
+    status, data = link.request(CMD_BLACKBOX, struct.pack("<BH", 0, 0))
+    check(status, data, "blackbox")
+    return data[4:] if struct.unpack_from("<H", data, 2)[0] else b""
+
+
+def trigger_blackbox(link, timeout=10.0):
+    """Freezes the recorder and waits for the new dump. It is written after
+    the post-trigger samples, so only while a set is running."""
+    old = blackbox_header(link)
+    status, data = link.request(CMD_BLACKBOX, b"\x01")
+    check(status, data, "blackbox")
+    if not data[0]:
+        raise SystemExit("blackbox: recorder busy with an earlier trigger")
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        time.sleep(0.2)
+        header = blackbox_header(link)
+        if header and header != old:
+            return
+    raise SystemExit("blackbox: no dump after %.0f s (is a set running?)" % timeout)
+
+
+def print_exercise(ex, name, values):
+    print("[%d] %s" % (ex, name))
+    for key in PARAMS:
+        value = values[key]
+        if key in ENUMS and 0 <= int(value) < len(ENUMS[key]):
+            shown = ENUMS[key][int(value)]
+        elif value == int(value):
+            shown = "%d" % value
+        else:
+            shown = "%g" % value
+        print("    %-18s %s" % (key, shown))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("-p", "--port", required=True, help="serial port of the USART2 adapter")
+    ap.add_argument("-b", "--baud", type=int, default=115200)
+    sub = ap.add_subparsers(dest="command", required=True)
+    sub.add_parser("info", help="list exercises and their parameters")
+    p = sub.add_parser("get", help="show one exercise")
+    p.add_argument("exercise")
+    p = sub.add_parser("set", help="apply name=value pairs to one exercise")
+    p.add_argument("exercise")
+    p.add_argument("pairs", nargs="+")
+    p.add_argument("--commit", action="store_true", help="also write to flash")
+    p = sub.add_parser("push", help="apply a JSON parameter file")
+    p.add_argument("file")
+    p.add_argument("--commit", action="store_true", help="also write to flash")
+    p = sub.add_parser("defaults", help="restore built-in parameters (RAM)")
+    p.add_argument("exercise", help="exercise name/index or 'all'")
+    sub.add_parser("commit", help="write the live parameters to flash")
+    p = sub.add_parser("latency", help="show the rep-to-pixel latency distribution")
+    p.add_argument("--reset", action="store_true", help="clear the histograms after reading")
+    p = sub.add_parser("blackbox", help="save the black-box dump")
+    p.add_argument("--trigger", action="store_true", help="freeze the recorder now and wait for its dump")
+    p.add_argument("-o", "--out", default="blackbox.bin", help="dump file (default: blackbox.bin)")
+    sub.add_parser("clock", help="show the clock profile and its residency")
+    args = ap.parse_args()
+
+    link = Link(args.port, args.baud)
+
+    if args.command == "info":
+        for ex in range(info(link)):
+            print_exercise(ex, *get_exercise(link, ex))
+    elif args.command == "get":
+        ex = resolve_exercise(link, args.exercise)
+        print_exercise(ex, *get_exercise(link, ex))
+    elif args.command == "set":
+        ex = resolve_exercise(link, args.exercise)
+        params = {}
+        for pair in args.pairs:
+            name, _, value = pair.partition("=")
+            params[name] = value
+        set_params(link, ex, params)
+        print_exercise(ex, *get_exercise(link, ex))
+    elif args.command == "push":
+        with open(args.file) as f:
+            table = json.load(f)
+        for key, params in table.items():
+            ex = resolve_exercise(link, str(key))
+            set_params(link, ex, params)
+            print_exercise(ex, *get_exercise(link, ex))
+    elif args.command == "defaults":
+        ex = 0xFF if args.exercise == "all" else resolve_exercise(link, args.exercise)
+        status, data = link.request(CMD_DEFAULTS, bytes([ex]))
+        check(status, data, "defaults")
+    elif args.command == "latency":
+        print_latency(link)
+        if args.reset:
+            status, data = link.request(CMD_LATENCY, b"\xff")
+            check(status, data, "latency")
+    elif args.command == "clock":
+        print_clock(link)
+    elif args.command == "blackbox":
+        if args.trigger:
+            trigger_blackbox(link)
+        dump = read_blackbox(link)
+        if not dump:
+            raise SystemExit("blackbox: no dump stored")
+        with open(args.out, "wb") as f:
+            f.write(dump)
+        print("%d bytes -> %s" % (len(dump), args.out))
+
+    if args.command == "commit" or getattr(args, "commit", False):
+        status, data = link.request(CMD_COMMIT)
+        check(status, data, "commit")
+        print("committed to flash")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())